@@ -0,0 +1,37 @@
+﻿#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <unordered_map>
+
+namespace OctaCubic
+{
+    // First-fit free-list sub-allocator over a linear range [0, capacity).
+    // Pure bookkeeping: units are whatever the owner decides (bytes, vertices, ...), no GPU calls.
+    class ArenaAllocator {
+    public:
+        static constexpr size_t invalidOffset = SIZE_MAX;
+
+        explicit ArenaAllocator(size_t capacity = 0);
+
+        // Returns the offset of a free range of the given size, or invalidOffset if none fits
+        size_t allocate(size_t size);
+        // Returns a range obtained from allocate(); neighbouring free ranges are merged
+        void free(size_t offset);
+        // Extends the range; existing allocations keep their offsets
+        void grow(size_t newCapacity);
+
+        size_t getCapacity() const { return capacity_; }
+        size_t getUsed() const { return used_; }
+        size_t getNumAllocations() const { return allocations_.size(); }
+        size_t getLargestFreeBlock() const;
+
+    private:
+        size_t capacity_ = 0;
+        size_t used_ = 0;
+        std::map<size_t, size_t> freeBlocks_; // offset -> size, sorted so neighbours can be merged
+        std::unordered_map<size_t, size_t> allocations_; // offset -> size
+
+        void insertFreeBlock(size_t offset, size_t size);
+    };
+}
@@ -0,0 +1,69 @@
+﻿#pragma once
+#include <cstdint>
+#include <random>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "ServerWorld.h"
+
+namespace OctaCubic
+{
+    // Synthetic players for load tests. Each bot owns a player of a ServerWorld and switches between behaviours
+    // every few seconds: walking and sprinting over the terrain, flying, and standing still to break and place
+    // blocks. Every tick of every bot traces a ray for its aim and collides with the world. Bots scatter over a
+    // square area and turn back at its edge, so they keep generating chunks without wandering off for good.
+    //
+    // All choices come from generators seeded by the driver's seed and the bot's index. With the same seed,
+    // bots and number of ticks, two runs end with the same world, whatever the thread count.
+    class BotDriver {
+    public:
+        enum Behaviour {
+            walking,
+            sprinting,
+            flying,
+            building,
+            numBehaviours
+        };
+        struct Stats {
+            uint64_t behaviourTicks[numBehaviours] = {};
+            uint64_t numBreaks = 0; // Asked for; there may have been nothing in reach
+            uint64_t numPlacements = 0;
+        };
+
+        // areaRadius in blocks around the origin
+        BotDriver(ServerWorld& world, const uint32_t seed, const float areaRadius);
+        BotDriver(const BotDriver&) = delete;
+        BotDriver& operator=(const BotDriver&) = delete;
+
+        void addBots(const size_t count);
+        // Once before every tick of the world
+        void submitInputs();
+
+        size_t getNumBots() const { return bots_.size(); }
+        const Stats& getStats() const { return stats_; }
+        // FNV-1a over the locations of all bots: equal for runs that went the same way
+        uint32_t getLocationHash() const;
+        static const char* getBehaviourName(const Behaviour behaviour);
+
+    private:
+        struct Bot {
+            ServerWorld::PlayerId id;
+            std::mt19937 rng;
+            Behaviour behaviour = walking;
+            int ticksLeft = 0; // In the current behaviour
+            float yaw = 0;
+            float pitch = 0;
+            float flyHeight = 0;
+            glm::vec3 lastLocation{0};
+        };
+
+        ServerWorld& world_;
+        uint32_t seed_;
+        float areaRadius_;
+        std::vector<Bot> bots_;
+        Stats stats_;
+
+        void chooseBehaviour(Bot& bot);
+        PlayerInput steer(Bot& bot, const Player& player);
+    };
+}
@@ -0,0 +1,115 @@
+﻿#pragma once
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace OctaCubic
+{
+    // Little endian binary encoding shared by input recordings, chunk data and the network protocol
+
+    inline void putU8(std::vector<uint8_t>& out, const uint8_t value) {
+        out.push_back(value);
+    }
+
+    inline void putU16(std::vector<uint8_t>& out, const uint16_t value) {
+        out.push_back(static_cast<uint8_t>(value));
+        out.push_back(static_cast<uint8_t>(value >> 8));
+    }
+
+    inline void putU32(std::vector<uint8_t>& out, const uint32_t value) {
+        for (int i = 0; i < 4; ++i) out.push_back(static_cast<uint8_t>(value >> (8 * i)));
+    }
+
+    inline void putI32(std::vector<uint8_t>& out, const int32_t value) {
+        putU32(out, static_cast<uint32_t>(value));
+    }
+
+    inline void putF32(std::vector<uint8_t>& out, const float value) {
+        uint32_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        putU32(out, bits);
+    }
+
+    inline void putF64(std::vector<uint8_t>& out, const double value) {
+        uint64_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        putU32(out, static_cast<uint32_t>(bits));
+        putU32(out, static_cast<uint32_t>(bits >> 32));
+    }
+
+    // 7 bits per byte, high bit set on all but the last
+    inline void putVarint(std::vector<uint8_t>& out, uint32_t value) {
+        while (value >= 0x80) {
+            out.push_back(static_cast<uint8_t>(value | 0x80));
+            value >>= 7;
+        }
+        out.push_back(static_cast<uint8_t>(value));
+    }
+
+    // Reading past the end, or a malformed varint, yields zeros and leaves the reader invalid; check isValid()
+    // once after a whole record instead of after every field.
+    class ByteReader {
+    public:
+        ByteReader(const uint8_t* data, const size_t size): data_(data), size_(size) {}
+        explicit ByteReader(const std::vector<uint8_t>& data): data_(data.data()), size_(data.size()) {}
+
+        bool isAtEnd() const { return position_ == size_; }
+        bool isValid() const { return isValid_; }
+        size_t getRemaining() const { return size_ - position_; }
+
+        uint8_t getU8() {
+            if (position_ >= size_) {
+                isValid_ = false;
+                return 0;
+            }
+            return data_[position_++];
+        }
+        uint16_t getU16() {
+            const uint16_t low = getU8();
+            return static_cast<uint16_t>(low | getU8() << 8);
+        }
+        uint32_t getU32() {
+            uint32_t value = 0;
+            for (int i = 0; i < 4; ++i) value |= static_cast<uint32_t>(getU8()) << (8 * i);
+            return value;
+        }
+        int32_t getI32() { return static_cast<int32_t>(getU32()); }
+        float getF32() {
+            const uint32_t bits = getU32();
+            float value;
+            memcpy(&value, &bits, sizeof(value));
+            return value;
+        }
+        double getF64() {
+            const uint64_t low = getU32();
+            const uint64_t bits = low | static_cast<uint64_t>(getU32()) << 32;
+            double value;
+            memcpy(&value, &bits, sizeof(value));
+            return value;
+        }
+        void skip(const size_t numBytes) {
+            if (numBytes > size_ - position_) {
+                isValid_ = false;
+                position_ = size_;
+                return;
+            }
+            position_ += numBytes;
+        }
+        uint32_t getVarint() {
+            uint32_t value = 0;
+            for (int shift = 0; shift < 35; shift += 7) {
+                const uint8_t byte = getU8();
+                value |= static_cast<uint32_t>(byte & 0x7F) << shift;
+                if (!(byte & 0x80)) return value;
+            }
+            isValid_ = false;
+            return 0;
+        }
+
+    private:
+        const uint8_t* data_;
+        size_t size_;
+        size_t position_ = 0;
+        bool isValid_ = true;
+    };
+}
@@ -1,13 +1,18 @@
 ﻿#pragma once
+#include <atomic>
 #include <cstdint>
-#include <unordered_set>
+#include <memory>
 #include <vector>
 #include <glm/fwd.hpp>
 #include <glm/vec3.hpp>
 
+#include "ChunkBufferArena.h"
+#include "SectionVisibility.h"
+
 namespace OctaCubic
 {
     using chunk_coord = glm::ivec3;
+    using section_mask = uint16_t; // Bit i set: section i of a chunk is selected
 
     struct ChunkCoordHash {
         std::size_t operator()(const chunk_coord& c) const {
@@ -21,19 +26,42 @@ namespace OctaCubic
     public:
         static constexpr int width = 16;
         static constexpr int height = 256;
-        static std::unordered_set<chunk_coord, ChunkCoordHash> chunkInGPUSet;
+        static constexpr int sectionHeight = SectionVisibility::size;
+        static constexpr int numSections = height / sectionHeight;
+        static constexpr section_mask allSections = 0xFFFF;
+        static constexpr size_t blockBytes = width * height * width; // One byte per block
 
         Chunk();
         Chunk(int cX, int cZ);
         ~Chunk();
+        // A copy would free the same GPU ranges twice
+        Chunk(const Chunk&) = delete;
+        Chunk& operator=(const Chunk&) = delete;
+
+        // Chunks are shared by two threads. The simulation thread owns the blocks and builds meshes; the render
+        // (GL) thread owns everything about the mesh on the GPU, including the culling data below, and picks up
+        // new meshes through sendToGPU(). Neither touches the other's side.
 
+        // Simulation thread: generates the mesh and stages it in the arena's upload ring
         void buildMesh();
+        // Render thread: a mesh newer than the one on the GPU is waiting
+        bool needsUpload() const;
+        // Render thread: moves the latest staged mesh into the arena (uploads directly if staging failed)
         void sendToGPU();
-        void renderOpaque() const;
-        void renderWater() const;
+        // Render thread: a mesh that will not be sent soon gives its upload ring space back; a later sendToGPU()
+        // uploads it directly. Staged uploads are retired in order, so one left waiting holds up the whole ring.
+        void dropStagedMesh();
+        // Append one indirect draw per run of consecutive selected sections, addressing the shared GPU arena
+        void appendDrawOpaque(std::vector<DrawArraysIndirectCommand>& commands,
+                              const section_mask sections = allSections) const;
+        void appendDrawWater(std::vector<DrawArraysIndirectCommand>& commands,
+                             const section_mask sections = allSections) const;
+        // Same ranges as appendDrawOpaque, addressing the position-only depth arena
+        void appendDrawDepth(std::vector<DrawArraysIndirectCommand>& commands,
+                             const section_mask sections = allSections) const;
         void freeGPU();
 
-        bool isDirty = true;
+        bool isDirty = true; // Simulation thread
         bool isInGPU() const;
 
         static bool isCoordValid(const glm::ivec3& c);
@@ -41,23 +69,59 @@ namespace OctaCubic
         int16_t setBlockId(const glm::ivec3& c, const uint8_t blockId);
 
         void genTerrain(const int seed);
-
-        static size_t getNumOfChunksInGPU();
+        // Blocks as runs of one id in column order (x, z, then y up), for sending over the network: a generated
+        // chunk takes a few KB instead of blockBytes. Appends to out.
+        void serializeBlocks(std::vector<uint8_t>& out) const;
+        // Replaces every block and marks the chunk dirty; false, changing nothing, unless data holds exactly
+        // one serialized chunk
+        bool deserializeBlocks(const uint8_t* data, const size_t size);
+
+        // Blocks addressed by one number for block deltas: z fastest, then x, then y, so each section is a
+        // contiguous range (index >> 12)
+        static uint16_t getBlockIndex(const glm::ivec3& c) { return static_cast<uint16_t>(c.y << 8 | c.x << 4 | c.z); }
+        // Bits of changedBorders: the neighbour on that side has to mesh again
+        enum Border : uint8_t { borderXNeg = 1, borderXPos = 2, borderZNeg = 4, borderZPos = 8 };
+        // The current ids at indices (sorted, no duplicates), appended to out for applyDelta. Each section takes
+        // the smallest encoding of three: a list of blocks, runs of consecutive blocks with one id, or the whole
+        // section as in serializeBlocks.
+        void serializeDelta(const std::vector<uint16_t>& indices, std::vector<uint8_t>& out) const;
+        // Marks the chunk dirty if any block changed. False on corrupt data, which may be partly applied.
+        bool applyDelta(const uint8_t* data, const size_t size, uint8_t& changedBorders);
+
+        // All chunk meshes (opaque and water) live in this one vertex buffer
+        static ChunkBufferArena& getGPUArena();
+        // Positions of the opaque meshes only, for depth passes (shadow maps)
+        static ChunkBufferArena& getDepthArena();
+        // Render thread, of the mesh on the GPU
         size_t getNumVertices() const;
+        // Any thread, of the latest built mesh (opaque and water); 0 before the first build
+        size_t getNumBuiltVertices() const;
+        // Changes every time a new mesh is sent to the GPU; unique across all chunks
+        uint64_t getMeshVersion() const;
 
         World* getWorld() const;
         void bindWorld(World* ptr_world);
 
         glm::ivec3 getCoordWorld(const glm::ivec3 coordLocal) const;
+        const chunk_coord& getChunkCoord() const;
+
+        // Render thread: world space AABB of the mesh on the GPU (tight in Y), used for frustum culling
+        glm::vec3 getBoundsMin() const;
+        glm::vec3 getBoundsMax() const;
+
+        // Render thread: per-section data of the mesh on the GPU; sections are stacked along Y
+        const SectionVisibility& getSectionVisibility(const int section) const;
+        bool isSectionEmpty(const int section) const;
 
     private:
         uint8_t blocks_[width][height][width]{};
+        static_assert(sizeof(blocks_) == blockBytes, "blockBytes must match the block array");
         chunk_coord chunkCoord_;
-        glm::uint vaoOpaque_ = 0;
-        glm::uint vboOpaque_ = 0;
-        glm::uint vaoWater_ = 0;
-        glm::uint vboWater_ = 0;
-        size_t numVertices_ = 0;
+        size_t arenaFirstOpaque_ = ChunkBufferArena::invalidOffset; // First vertex in the GPU arena
+        size_t arenaFirstWater_ = ChunkBufferArena::invalidOffset;
+        size_t arenaFirstDepth_ = ChunkBufferArena::invalidOffset; // In the depth arena
+        static std::atomic<uint64_t> nextMeshVersion_; // Meshing jobs
+        enum DeltaKind : uint8_t { deltaList, deltaRuns, deltaSection };
         World* ptr_world_ = nullptr;
 
         struct Vertex {
@@ -70,16 +134,55 @@ namespace OctaCubic
                 : x(x), y(y), z(z), nx(nx), ny(ny), nz(nz), u(u), v(v), id(id) {}
         };
 
-        std::vector<Vertex> meshDataOpaque_;
-        std::vector<Vertex> meshDataWater_;
+        // 12 bytes instead of 36: all a depth-only pass fetches
+        struct DepthVertex {
+            float x, y, z;
+        };
+
+        // Everything one buildMesh() produces. Never changed after it is published, except that the render
+        // thread commits the staged uploads; one still staged when the mesh is dropped is cancelled.
+        struct Mesh {
+            std::vector<Vertex> opaque;
+            std::vector<Vertex> water;
+            std::vector<DepthVertex> depth; // Positions of opaque, vertex for vertex
+            ChunkBufferArena::StagedUpload stagedOpaque;
+            ChunkBufferArena::StagedUpload stagedWater;
+            ChunkBufferArena::StagedUpload stagedDepth;
+            uint64_t version = 0;
+            int minY = 0;
+            int maxY = 0;
+            SectionVisibility sectionVisibility[numSections];
+            // Vertices of section i are [sectionOffset[i], sectionOffset[i + 1]) in the mesh data
+            size_t sectionOffsetOpaque[numSections + 1]{};
+            size_t sectionOffsetWater[numSections + 1]{};
+            size_t numBytes = 0; // Of the vertex vectors, as accounted in MemoryStats
+
+            ~Mesh();
+        };
+
+        std::shared_ptr<Mesh> latestMesh_; // Handed over with std::atomic_load / std::atomic_store
+        std::shared_ptr<Mesh> gpuMesh_; // Render thread: the mesh in the arenas
 
         // Helper functions
-        void genMeshData();
-        void genQuadData(std::vector<Vertex>& meshData, const float* vertices, const uint8_t blockId, const int x,
-                         const int y, const int z);
+        uint8_t getBlockByIndex(const uint32_t index) const { return blocks_[index >> 4 & 15][index >> 8][index & 15]; }
+        // The blocks of layers [yBegin, yEnd), run-length encoded in column order
+        void serializeLayers(const int yBegin, const int yEnd, std::vector<uint8_t>& out) const;
+        // changedBorders: nullptr overwrites; otherwise only changed blocks are written and their borders noted
+        bool deserializeLayers(const int yBegin, const int yEnd, const uint8_t* data, const size_t size,
+                               uint8_t* changedBorders);
+        void genMeshData(Mesh& mesh) const;
+        void genQuadData(Mesh& mesh, std::vector<Vertex>& meshData, const float* vertices, const uint8_t blockId,
+                         const int x, const int y, const int z) const;
         static bool isBlockOpaque(const int blockId);
         bool isBlockOpaque(const int x, const int y, const int z) const;
-        void sendToGPUHelper(glm::uint* vao, glm::uint* vbo, const std::vector<Vertex>& meshData);
-        void freeGPUHelper(glm::uint* vao, glm::uint* vbo);
+        SectionVisibility computeSectionVisibility(const int section) const;
+        static void appendDrawSections(std::vector<DrawArraysIndirectCommand>& commands, const size_t arenaFirst,
+                                       const size_t* sectionOffsets, const section_mask sections);
+        static void setupVertexAttributes();
+        static void setupDepthVertexAttributes();
+        static void sendToGPUHelper(ChunkBufferArena& arena, size_t* arenaFirst, ChunkBufferArena::StagedUpload* staged,
+                                    const void* meshData, const size_t numVertices,
+                                    const size_t numVerticesReplaced);
+        static void freeGPUHelper(ChunkBufferArena& arena, size_t* arenaFirst, const size_t numVertices);
     };
 }
@@ -0,0 +1,77 @@
+﻿#pragma once
+#include <cstdint>
+#include <vector>
+#include <glm/fwd.hpp>
+
+#include "ArenaAllocator.h"
+#include "UploadRing.h"
+
+namespace OctaCubic
+{
+    // Layout of GL's DrawArraysIndirectCommand
+    struct DrawArraysIndirectCommand {
+        uint32_t count;
+        uint32_t instanceCount;
+        uint32_t first;
+        uint32_t baseInstance;
+    };
+
+    // One big vertex buffer (and VAO) shared by all chunk meshes.
+    // Meshes are placed by an ArenaAllocator in units of vertices; each pass is drawn with one glMultiDrawArraysIndirect.
+    // Vertex data reaches the buffer through a persistently mapped UploadRing and a GPU side copy.
+    class ChunkBufferArena {
+    public:
+        using AttributeSetup = void (*)(); // Sets vertex attribute pointers for the bound VAO and GL_ARRAY_BUFFER
+
+        // Vertices written into the upload ring but not placed in the arena yet
+        struct StagedUpload {
+            UploadRing::Allocation allocation;
+            size_t numVertices = 0;
+            bool isValid() const { return allocation.isValid(); }
+        };
+
+        ChunkBufferArena(size_t vertexStride, size_t initialCapacity, AttributeSetup setupAttributes,
+                         size_t uploadRingBytes);
+
+        // Any thread: copies the vertices into the upload ring. Invalid if the ring is full or not created yet.
+        StagedUpload stage(const void* vertices, size_t numVertices);
+        // GL thread: places staged vertices in the arena and returns the index of the first one
+        size_t commit(StagedUpload& staged);
+        // Any thread: drops staged vertices that will not be committed
+        void cancel(StagedUpload& staged);
+        // GL thread: copies the vertices into the arena and returns the index of the first one, or invalidOffset if empty
+        size_t upload(const void* vertices, size_t numVertices);
+        void release(size_t first);
+        // GL thread, once per frame after the uploads: fences this frame's copies and recycles ring space
+        void flushUploads();
+        const UploadRing& getUploadRing() const { return uploadRing_; }
+        void drawIndirect(const std::vector<DrawArraysIndirectCommand>& commands);
+
+        size_t getCapacity() const { return allocator_.getCapacity(); }
+        size_t getUsed() const { return allocator_.getUsed(); }
+        size_t getVertexStride() const { return vertexStride_; }
+        size_t getNumDrawCalls() const { return numDrawCalls_; }
+        size_t getNumDrawCommands() const { return numDrawCommands_; }
+        // Draw statistics accumulate until reset, typically once per frame
+        void resetDrawStats();
+
+        static constexpr size_t invalidOffset = ArenaAllocator::invalidOffset;
+
+    private:
+        size_t vertexStride_;
+        AttributeSetup setupAttributes_;
+        ArenaAllocator allocator_;
+        UploadRing uploadRing_;
+        glm::uint vao_ = 0;
+        glm::uint vbo_ = 0;
+        glm::uint indirectBuffer_ = 0;
+        size_t indirectCapacity_ = 0; // In commands
+        size_t numDrawCalls_ = 0;
+        size_t numDrawCommands_ = 0;
+
+        void initGPU(); // Lazily, since the GL context does not exist yet when the arena is constructed
+        void grow(size_t minCapacity);
+        size_t allocate(size_t numVertices); // Grows the buffer when the allocator is full
+        void bindVertexBuffer() const;
+    };
+}
@@ -0,0 +1,52 @@
+﻿#pragma once
+#include <cstdint>
+#include <unordered_set>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "NetProtocol.h"
+#include "World.h"
+
+namespace OctaCubic
+{
+    // The client end of ChunkServer. Chunks and block deltas received are applied to the world, which should not
+    // generate terrain of its own (World::setTerrainGenerated(false)); the player's position and the block edits
+    // made locally go back to the server, which has the last word on them.
+    class ChunkClient {
+    public:
+        // Blocks until the server welcomed us, or timeoutSeconds passed
+        bool connect(const char* host, const uint16_t port, const int viewDistance, const double timeoutSeconds = 5);
+        // Simulation thread: loads the chunks received, then sends the position if the player changed chunks and
+        // the edits logged since the last call. False once disconnected.
+        bool update(World& world, const glm::vec3 position);
+        // For World::setEditLog, so local edits reach the server
+        std::vector<BlockEdit>& getEditLog() { return editLog_; }
+
+        bool isConnected() const { return connection_.isOpen(); }
+        // The chunk's blocks came from the server; until then the world holds blank air there
+        bool hasChunk(const chunk_coord c) const { return chunksReceived_.count(c) != 0; }
+        // From the welcome
+        int getSeed() const { return seed_; }
+        int getViewDistance() const { return viewDistance_; }
+        // Whether they applied or not
+        uint64_t getNumChunksReceived() const { return numChunksReceived_; }
+        uint64_t getNumDeltasReceived() const { return numDeltasReceived_; }
+        // Chunks and deltas that were corrupt or did not fit the world
+        uint64_t getNumRejected() const { return numRejected_; }
+        uint64_t getNumBytesReceived() const { return connection_.getNumBytesReceived(); }
+
+    private:
+        NetConnection connection_;
+        NetMessage message_; // Scratch for update
+        std::vector<BlockEdit> editLog_;
+        std::unordered_set<chunk_coord, ChunkCoordHash> chunksReceived_;
+        int seed_ = 0;
+        int viewDistance_ = 0;
+        chunk_coord lastCenter_{0, 0, 0};
+        bool hasSentPosition_ = false;
+        bool isDisconnectLogged_ = false;
+        uint64_t numChunksReceived_ = 0;
+        uint64_t numDeltasReceived_ = 0;
+        uint64_t numRejected_ = 0;
+    };
+}
@@ -0,0 +1,84 @@
+﻿#pragma once
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "NetProtocol.h"
+#include "World.h"
+
+namespace OctaCubic
+{
+    // Owns the authoritative copy of a world for remote clients: streams them the chunks around the position
+    // each reports, nearest first, and applies the block edits they send.
+    //
+    // Every block changed in the world, by clients or by anything else calling World::setBlockId, is collected
+    // through the world's edit log and sent once per update as one delta per chunk (Chunk::serializeDelta), to
+    // the clients that have that chunk and only them. A client has the chunks inside its view; leaving it drops
+    // the chunk, and coming back sends it whole again. Clients are found per chunk, so an update costs in the
+    // number of changes and deliveries, not clients times chunks.
+    //
+    // Runs on the thread that updates the world, once per update; never blocks.
+    class ChunkServer {
+    public:
+        // Bandwidth, over every client there has been
+        struct Stats {
+            uint64_t numChunksSent = 0;
+            uint64_t numChunkBytes = 0; // Serialized blocks only
+            uint64_t numDeltasSent = 0;
+            uint64_t numDeltaBytes = 0; // Encoded changes only
+            uint64_t numBlocksChanged = 0; // Counted once however many clients get them
+            uint64_t numBytesSent = 0; // Everything, framing included
+            uint64_t numBytesReceived = 0;
+            uint64_t numEdits = 0; // Received from clients and applied
+        };
+
+        ChunkServer(World& world, const int maxViewDistance);
+        ~ChunkServer();
+        ChunkServer(const ChunkServer&) = delete;
+        ChunkServer& operator=(const ChunkServer&) = delete;
+
+        // Port 0 picks a free one, see getPort
+        bool listen(const char* address, const uint16_t port);
+        uint16_t getPort() const { return listener_.getLocalPort(); }
+
+        void update();
+
+        size_t getNumClients() const { return clients_.size(); }
+        Stats getStats() const;
+
+    private:
+        // Chunks are only serialized for a client while less than this is waiting in its send buffer, so the
+        // nearest chunks go first once the client moves
+        static constexpr size_t maxPendingBytes = 256 * 1024;
+
+        struct Client {
+            NetConnection connection;
+            bool isWelcomed = false;
+            int viewDistance = 0;
+            chunk_coord center{0, 0, 0};
+            bool hasCenter = false;
+            std::unordered_set<chunk_coord, ChunkCoordHash> chunksSent; // Kept current by deltas
+            std::vector<chunk_coord> chunksToSend; // Farthest first, sent from the back
+        };
+
+        World& world_;
+        int maxViewDistance_;
+        Socket listener_;
+        std::vector<std::unique_ptr<Client>> clients_;
+        // For each chunk some client has, who has it
+        std::unordered_map<chunk_coord, std::vector<Client*>, ChunkCoordHash> subscribers_;
+        std::vector<BlockEdit> editLog_; // Filled by the world between updates
+        std::unordered_map<chunk_coord, std::vector<uint16_t>, ChunkCoordHash> changedBlocks_; // Scratch for update
+        std::vector<uint8_t> delta_; // Scratch for update
+        NetMessage message_; // Scratch for update
+        Stats stats_;
+
+        void receive(Client& client);
+        void sendDeltas();
+        void setCenter(Client& client, const chunk_coord center);
+        void sendChunk(Client& client, const chunk_coord c);
+        void unsubscribe(Client& client, const chunk_coord c);
+    };
+}
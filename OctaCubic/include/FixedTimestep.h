@@ -0,0 +1,35 @@
+﻿#pragma once
+#include <cstdint>
+
+namespace OctaCubic
+{
+    // Fixed-rate simulation clock. Each frame feeds the wall clock in and runs the returned number of ticks;
+    // rendering then blends the last two tick states by getAlpha(). A frame owing more than maxTicksPerFrame
+    // ticks drops the rest, so one long frame cannot snowball into ever longer ones.
+    class FixedTimestep {
+    public:
+        explicit FixedTimestep(const double tickRate, const int maxTicksPerFrame = 8);
+
+        // Ticks to run for the time passed since the previous call; the first call only starts the clock
+        int advance(const double now);
+        // How far (0..1) the rendered moment lies between the last tick and the next one
+        float getAlpha() const;
+        // Clock time the state after the last tick belongs to
+        double getLastTickTime() const { return lastTime_ - accumulator_; }
+        double getTimeToNextTick() const { return tickSeconds_ - accumulator_; }
+
+        double getTickSeconds() const { return tickSeconds_; }
+        double getTickRate() const { return 1.0 / tickSeconds_; }
+        uint64_t getTickCount() const { return tickCount_; }
+        uint64_t getDroppedTicks() const { return droppedTicks_; }
+
+    private:
+        double tickSeconds_;
+        int maxTicksPerFrame_;
+        double lastTime_ = 0;
+        bool isStarted_ = false;
+        double accumulator_ = 0;
+        uint64_t tickCount_ = 0;
+        uint64_t droppedTicks_ = 0;
+    };
+}
@@ -0,0 +1,71 @@
+﻿#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "FrameStats.h"
+#include "Player.h"
+#include "World.h"
+
+namespace OctaCubic
+{
+    // A scripted run for reproducible end-to-end numbers: a fixed seed, a camera path and block edits at given
+    // ticks. The game runs it in lockstep, one simulation tick per frame on the render thread, so every run
+    // generates, meshes and draws the same chunks whatever the frame rate.
+    //
+    // Script lines, '#' starts a comment:
+    //   seed <seed>
+    //   key <tick> <x> <y> <z> <yaw> <pitch>   path keyframe; the player is moved linearly between them
+    //   set <tick> <x> <y> <z> <blockId>       block edit, applied before the tick
+    class Flythrough {
+    public:
+        struct Keyframe {
+            uint64_t tick;
+            glm::vec3 location;
+            float yaw;
+            float pitch;
+        };
+        struct Edit {
+            uint64_t tick;
+            glm::ivec3 coord;
+            uint8_t blockId;
+        };
+        // What one frame cost and drew
+        struct Sample {
+            float seriesMs[FrameStats::numSeries]; // As FrameStats: the whole frame, then the phases
+            double simulationMs;
+            size_t numDrawCalls;
+            size_t numDrawCommands;
+            size_t numVertices;
+            uint64_t numChunksGenerated; // During the frame
+            uint64_t numChunksMeshed;
+            int numShadowFullUpdates; // Cascades re-rendered whole; the sun stands still, so mostly 0
+        };
+
+        int seed = 20231024;
+
+        bool load(const std::string& path);
+        // A loop around the spawn, low over the terrain then high above it, digging a shaft every second
+        void makeDefault();
+        const std::string& getName() const { return name_; }
+
+        // Frames in the run: one past the last keyframe
+        uint64_t getNumTicks() const;
+        // Moves the player onto the path and returns the input for the tick; the player floats so the ticks
+        // do not move it further
+        PlayerInput prepareTick(const uint64_t tick, Player& player) const;
+        // Only while the simulation is not running on its own thread
+        void applyEdits(const uint64_t tick, World& world) const;
+
+        void addSample(const Sample& sample) { samples_.push_back(sample); }
+        // The whole run summarised, then every frame
+        bool writeReport(const std::string& path, const std::string& renderer) const;
+
+    private:
+        std::string name_;
+        std::vector<Keyframe> keyframes_; // By tick
+        std::vector<Edit> edits_; // By tick
+        std::vector<Sample> samples_;
+    };
+}
@@ -0,0 +1,46 @@
+﻿#pragma once
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "Chunk.h"
+#include "Quad.h"
+
+namespace OctaCubic
+{
+    // Everything the render thread takes from one simulation update. Copied out of the game state, so it stays
+    // valid while the simulation moves on; the chunks are only used for their render thread side.
+    struct FrameSnapshot {
+        uint64_t tick = 0;
+        double tickTime = 0; // Simulation::getClockSeconds() the tick's state belongs to
+        double tickSeconds = 0;
+        uint64_t droppedTicks = 0;
+        double updateMs = 0; // Spent by the simulation thread on the update that made this snapshot
+
+        glm::vec3 playerPreviousLocation{0}; // At the tick before, for interpolation
+        glm::vec3 playerLocation{0};
+        float playerEyeHeight = 0;
+        float playerYaw = 0;
+        float playerPitch = 0;
+        glm::vec3 playerDirectionLooking{0};
+        bool isAimingAtSomeBlock = false;
+        glm::ivec3 aimingAtBlockCoord{0};
+        face aimingAtBlockFace = xPos;
+
+        float lightPosRotZ = 0;
+
+        // With a ChunkClient: the player is held for chunks still on their way, or the server is gone
+        bool isWaitingForChunks = false;
+        bool isServerLost = false;
+
+        // Chunks within viewDistance of viewCenter, meshed, as World::setRenderQueue takes them
+        glm::ivec3 viewCenter{0};
+        int viewDistance = 0;
+        std::vector<Chunk*> chunksInView;
+
+        // alpha: how far between the previous tick and this one
+        glm::vec3 getPlayerLocation(const float alpha) const {
+            return playerPreviousLocation + (playerLocation - playerPreviousLocation) * alpha;
+        }
+    };
+}
@@ -0,0 +1,95 @@
+﻿#pragma once
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+namespace OctaCubic
+{
+    // Frame times and the time of each render phase over the last windowFrames frames. Percentiles come from a
+    // rolling histogram of 0.1 ms buckets, so reading them costs the same whatever the window. Each frame can
+    // also be appended to a CSV file for comparing runs.
+    class FrameStats {
+    public:
+        enum Phase { preprocess, shadow, main, water, gui, numPhases };
+        // The whole frame, then the phases
+        static constexpr int numSeries = numPhases + 1;
+        static constexpr int frameSeries = 0;
+
+        static constexpr size_t windowFrames = 600;
+        static constexpr double bucketMs = 0.1;
+        static constexpr int numBuckets = 1000; // The last one also takes everything longer
+
+        struct Summary {
+            double p50 = 0;
+            double p95 = 0;
+            double p99 = 0;
+            double max = 0;
+            size_t numOverBudget = 0; // Frames in the window longer than the budget
+        };
+
+        // Adds the time until it goes out of scope to a phase of the current frame
+        class Scope {
+        public:
+            Scope(FrameStats& stats, const Phase phase)
+                : stats_(stats), phase_(phase), start_(std::chrono::steady_clock::now()) {}
+            ~Scope() {
+                stats_.addPhaseMs(phase_, std::chrono::duration<double, std::milli>(
+                                      std::chrono::steady_clock::now() - start_).count());
+            }
+            Scope(const Scope&) = delete;
+            Scope& operator=(const Scope&) = delete;
+
+        private:
+            FrameStats& stats_;
+            Phase phase_;
+            std::chrono::steady_clock::time_point start_;
+        };
+
+        explicit FrameStats(const double budgetMs = 1000.0 / 60);
+        ~FrameStats();
+        FrameStats(const FrameStats&) = delete;
+        FrameStats& operator=(const FrameStats&) = delete;
+
+        // Ends the previous frame, its time being the time since the previous call
+        void beginFrame();
+        void addPhaseMs(const Phase phase, const double ms);
+
+        Summary getSummary(const int series) const;
+        size_t getNumFrames() const { return numFrames_; } // In the window
+        uint64_t getFrameIndex() const { return frameIndex_; }
+        double getBudgetMs() const { return budgetMs_; }
+        void setBudgetMs(const double budgetMs);
+        // For ImGui::PlotLines: windowFrames values starting at getHistoryOffset(), oldest first
+        const float* getHistory(const int series) const { return history_[series]; }
+        size_t getHistoryOffset() const { return next_; }
+        static const char* getSeriesName(const int series);
+        // Of the frame the last beginFrame() ended
+        float getLastFrameMs(const int series) const {
+            return history_[series][(next_ + windowFrames - 1) % windowFrames];
+        }
+
+        // One line per frame: index, seconds since the first frame, then the series in ms
+        bool startCsv(const std::string& path);
+        void stopCsv();
+        bool isWritingCsv() const { return csv_ != nullptr; }
+        const std::string& getCsvPath() const { return csvPath_; }
+
+    private:
+        double budgetMs_;
+        float history_[numSeries][windowFrames] = {};
+        uint32_t histogram_[numSeries][numBuckets] = {};
+        size_t next_ = 0; // Slot the next frame goes to
+        size_t numFrames_ = 0;
+        uint64_t frameIndex_ = 0;
+        double currentPhaseMs_[numPhases] = {};
+        bool isFrameStarted_ = false;
+        std::chrono::steady_clock::time_point frameStart_;
+        std::chrono::steady_clock::time_point firstFrameStart_;
+        FILE* csv_ = nullptr;
+        std::string csvPath_;
+
+        void pushFrame(const double frameMs);
+        static int getBucket(const double ms);
+    };
+}
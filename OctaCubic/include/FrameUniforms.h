@@ -0,0 +1,36 @@
+﻿#pragma once
+#include <glm/glm.hpp>
+
+namespace OctaCubic
+{
+    // Per-frame values shared by every program, std140 layout.
+    // Must match the FrameData uniform block declared in the shaders.
+    struct FrameUniforms {
+        glm::mat4 view;
+        glm::mat4 projection;
+        glm::mat4 normalMatrix; // transpose(inverse(view)), for model = identity; shaders use its mat3 part
+        glm::mat4 lightSpaceMatrices[4];
+        glm::vec4 cascadeSplits; // Far edge of each shadow cascade in view space
+        glm::vec4 lightPosView; // Light position in view space
+        glm::vec4 lightColor;
+        float ambient;
+        float time;
+        int numCascades;
+        float padding_;
+    };
+
+    // Uniform buffer holding FrameUniforms, bound once to a fixed binding point for all programs
+    class FrameUniformBuffer {
+    public:
+        static constexpr unsigned int bindingPoint = 0;
+        static constexpr const char* blockName = "FrameData";
+
+        // GL thread; creates the buffer and binds it to bindingPoint
+        void initGPU();
+        // Uploads the values; call once per frame before the first pass
+        void update(const FrameUniforms& uniforms) const;
+
+    private:
+        glm::uint buffer_ = 0;
+    };
+}
@@ -0,0 +1,25 @@
+﻿#pragma once
+#include <glm/glm.hpp>
+
+namespace OctaCubic
+{
+    // View frustum extracted from a (view) projection matrix.
+    // Planes are stored as structure-of-arrays and padded to 8, so the AABB test runs 4 planes per SSE op.
+    class Frustum {
+    public:
+        Frustum();
+        explicit Frustum(const glm::mat4& viewProjection);
+
+        void update(const glm::mat4& viewProjection);
+        bool isBoxVisible(const glm::vec3& boxMin, const glm::vec3& boxMax) const;
+
+    private:
+        static constexpr int numPlanes = 8; // 6 real planes + 2 always-pass padding planes
+
+        // Plane i: planeX_[i] * x + planeY_[i] * y + planeZ_[i] * z + planeW_[i] >= 0 means inside
+        alignas(16) float planeX_[numPlanes]{};
+        alignas(16) float planeY_[numPlanes]{};
+        alignas(16) float planeZ_[numPlanes]{};
+        alignas(16) float planeW_[numPlanes]{};
+    };
+}
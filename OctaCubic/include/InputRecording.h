@@ -0,0 +1,65 @@
+﻿#pragma once
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "Player.h"
+
+namespace OctaCubic
+{
+    // What a session depends on besides its input
+    struct InputRecordingHeader {
+        int32_t seed = 0; // World seed
+        double tickRate = 60;
+        glm::vec3 spawn{0};
+    };
+
+    // Writes the input of every simulation tick to a compact binary file, so a session can be replayed tick for
+    // tick with InputReplay: the same movement, collisions and block edits. Consecutive ticks with the same
+    // input are stored once with a repeat count; idle or held keys cost a few bytes per run.
+    class InputRecorder {
+    public:
+        InputRecorder() = default;
+        ~InputRecorder();
+        InputRecorder(const InputRecorder&) = delete;
+        InputRecorder& operator=(const InputRecorder&) = delete;
+
+        bool open(const std::string& path, const InputRecordingHeader& header);
+        // Simulation thread, once per tick, with the input the tick ran
+        void record(const PlayerInput& input);
+        // After the simulation stopped
+        void close();
+        bool isOpen() const { return file_ != nullptr; }
+        uint64_t getNumTicks() const { return numTicks_; }
+
+    private:
+        FILE* file_ = nullptr;
+        PlayerInput run_; // Not written yet
+        uint32_t runLength_ = 0;
+        uint64_t numTicks_ = 0;
+
+        void writeRun();
+    };
+
+    class InputReplay {
+    public:
+        bool load(const std::string& path);
+        const InputRecordingHeader& getHeader() const { return header_; }
+        // Simulation thread: the input of the next tick; false once every recorded tick has been replayed
+        bool next(PlayerInput& input);
+        uint64_t getNumTicks() const { return numTicks_; }
+
+    private:
+        struct Run {
+            PlayerInput input;
+            uint32_t length;
+        };
+        InputRecordingHeader header_;
+        std::vector<Run> runs_;
+        uint64_t numTicks_ = 0;
+        size_t nextRun_ = 0;
+        uint32_t nextInRun_ = 0; // Ticks of runs_[nextRun_] already replayed
+    };
+}
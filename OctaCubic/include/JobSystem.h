@@ -0,0 +1,102 @@
+﻿#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace OctaCubic
+{
+    // Worker threads shared by the engine's subsystems. Every worker owns a deque per priority: it pushes and
+    // pops its own jobs at the back and, when out of work, steals from the front of the others'. Threads that
+    // are not workers (main, simulation) get a slot each too; while they wait on a Counter they only run their
+    // own jobs, so the render thread waiting on culling never ends up meshing for the simulation.
+    class JobSystem {
+    public:
+        enum Priority { high, normal, low, numPriorities };
+        // Threads past this many share the last external slot
+        static constexpr int maxExternalThreads = 4;
+
+        // Number of jobs still to finish; jobs can be held back until one reaches zero
+        class Counter {
+        public:
+            bool isDone() const { return pending_.load(std::memory_order_acquire) == 0; }
+
+        private:
+            friend class JobSystem;
+            struct Continuation {
+                std::function<void()> job;
+                Counter* counter;
+                Priority priority;
+            };
+            std::atomic<int> pending_{0};
+            std::mutex mutex_; // Guards continuations_ and the last decrement of pending_
+            std::vector<Continuation> continuations_;
+        };
+
+        // numWorkers 0 runs every job on the thread that waits for it
+        explicit JobSystem(const int numWorkers = getDefaultNumWorkers());
+        ~JobSystem();
+        JobSystem(const JobSystem&) = delete;
+        JobSystem& operator=(const JobSystem&) = delete;
+
+        // counter, if any, counts the job until it has run
+        void submit(std::function<void()> job, Counter* counter = nullptr, const Priority priority = normal);
+        // Held back until dependency is done
+        void submitAfter(Counter& dependency, std::function<void()> job, Counter* counter = nullptr,
+                         const Priority priority = normal);
+        // Runs queued jobs until counter is done: any job on a worker, only the thread's own jobs elsewhere
+        void wait(Counter& counter);
+        // body(begin, end) over [0, count) in ranges of grainSize, returns when all of them have run
+        void parallelFor(const size_t count, const size_t grainSize,
+                         const std::function<void(size_t begin, size_t end)>& body,
+                         const Priority priority = normal);
+
+        // Any thread: a job for the GL thread, run by its next drainGLJobs()
+        void submitGL(std::function<void()> job);
+        // GL thread: runs the GL jobs submitted so far, returns how many
+        size_t drainGLJobs();
+
+        int getNumWorkers() const { return numWorkers_; }
+        uint64_t getNumJobsRun() const { return numJobsRun_; }
+        uint64_t getNumSteals() const { return numSteals_; }
+        // One worker per hardware thread, leaving one for the thread that submits
+        static int getDefaultNumWorkers();
+
+    private:
+        struct Job {
+            std::function<void()> job;
+            Counter* counter = nullptr;
+        };
+        struct Slot {
+            std::mutex mutex;
+            std::deque<Job> queues[numPriorities];
+        };
+
+        uint64_t id_; // Tells systems apart in the threads' slot cache, even at a reused address
+        int numWorkers_;
+        std::vector<std::unique_ptr<Slot>> slots_; // One per worker, then maxExternalThreads for other threads
+        std::atomic<int> numExternalThreads_{0};
+        std::vector<std::thread> threads_;
+        std::atomic<int> numQueued_{0};
+        std::atomic<bool> isStopping_{false};
+        std::mutex sleepMutex_;
+        std::condition_variable wakeCondition_;
+        std::atomic<uint64_t> numJobsRun_{0};
+        std::atomic<uint64_t> numSteals_{0};
+
+        std::mutex glMutex_;
+        std::vector<std::function<void()>> glJobs_;
+
+        int getCurrentSlot();
+        void push(Job&& job, const Priority priority);
+        // isOwnOnly: no stealing
+        bool tryRunOne(const bool isOwnOnly = false);
+        void finish(Counter* counter);
+        void workerLoop(const int slot);
+    };
+}
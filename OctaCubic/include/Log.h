@@ -0,0 +1,170 @@
+﻿#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <type_traits>
+
+namespace OctaCubic
+{
+    struct LogQueue;
+
+    // Leveled logger. A LOG_* call only copies its format pointer and arguments into a slot of a lock-free
+    // queue; a background thread formats the lines and writes them to stdout. When the queue is full the
+    // message is dropped and counted instead of blocking. Every call site logs at most maxPerSecond lines a
+    // second, the rest are counted and reported with the next line that gets through.
+    class Log {
+    public:
+        enum Level { debug, info, warning, error, numLevels };
+
+        static constexpr size_t maxArgs = 8;
+        static constexpr size_t stringCapacity = 512; // For the string arguments of one message together
+        static constexpr size_t queueCapacity = 2048; // Messages; a power of two
+        static constexpr uint32_t maxPerSecond = 20;
+
+        // Rate limit state of one call site, a static next to it
+        class Site {
+        public:
+            explicit Site(const char* category): category_(category) {}
+            // Whether a message may go out now; numSuppressed: how many were held back before it
+            bool admit(uint64_t nowNs, uint32_t& numSuppressed);
+            const char* getCategory() const { return category_; }
+
+        private:
+            const char* category_;
+            std::atomic<uint64_t> second_{0};
+            std::atomic<uint32_t> count_{0};
+            std::atomic<uint32_t> numSuppressed_{0};
+        };
+
+        // Lower levels are skipped at run time; OCTACUBIC_LOG_MIN_LEVEL removes them at compile time
+        static void setLevel(const Level level) { level_.store(level, std::memory_order_relaxed); }
+        static bool isEnabled(const Level level) { return level >= level_.load(std::memory_order_relaxed); }
+
+        // format: printf style, a literal; strings are copied, so they need not outlive the call
+        template <typename... Args>
+        static void write(const Level level, Site& site, const char* format, const Args&... args) {
+            uint32_t numSuppressed = 0;
+            if (!site.admit(getNowNs(), numSuppressed)) return;
+            Record* record = beginRecord();
+            if (!record) return;
+            record->level = level;
+            record->category = site.getCategory();
+            record->format = format;
+            record->numSuppressed = numSuppressed;
+            record->numArgs = 0;
+            record->stringsUsed = 0;
+            captureAll(*record, args...);
+            commitRecord(record);
+        }
+
+        // Writes out everything logged so far; also runs at exit
+        static void flush();
+        static uint64_t getNumDropped() { return numDropped_.load(std::memory_order_relaxed); }
+        static uint64_t getNowNs();
+
+    private:
+        friend struct LogQueue;
+
+        struct Arg {
+            enum Type : uint8_t { integer, unsignedInteger, floating, string, pointer } type;
+            union {
+                long long i;
+                unsigned long long u;
+                double f;
+                size_t s; // Offset in Record::strings
+                const void* p;
+            };
+        };
+
+        struct Record {
+            std::atomic<size_t> sequence; // Vyukov bounded queue: tells whose turn the slot is
+            Level level;
+            uint32_t threadId;
+            uint64_t timeNs;
+            const char* category;
+            const char* format;
+            uint32_t numSuppressed;
+            uint32_t numArgs;
+            size_t stringsUsed;
+            Arg args[maxArgs];
+            char strings[stringCapacity];
+        };
+
+        static std::atomic<int> level_;
+        static std::atomic<uint64_t> numDropped_;
+
+        static Record* beginRecord();
+        static void commitRecord(Record* record);
+
+        static void captureAll(Record&) {}
+        template <typename T, typename... Rest>
+        static void captureAll(Record& record, const T& arg, const Rest&... rest) {
+            if (record.numArgs < maxArgs) capture(record, record.args[record.numArgs++], arg);
+            captureAll(record, rest...);
+        }
+
+        template <typename T>
+        static typename std::enable_if<std::is_integral<T>::value || std::is_enum<T>::value>::type
+        capture(Record&, Arg& arg, const T& value) {
+            if (std::is_signed<T>::value || std::is_enum<T>::value) {
+                arg.type = Arg::integer;
+                arg.i = static_cast<long long>(value);
+            }
+            else {
+                arg.type = Arg::unsignedInteger;
+                arg.u = static_cast<unsigned long long>(value);
+            }
+        }
+        template <typename T>
+        static typename std::enable_if<std::is_floating_point<T>::value>::type
+        capture(Record&, Arg& arg, const T& value) {
+            arg.type = Arg::floating;
+            arg.f = static_cast<double>(value);
+        }
+        template <typename T>
+        static void capture(Record&, Arg& arg, T* const& value) {
+            arg.type = Arg::pointer;
+            arg.p = value;
+        }
+        static void capture(Record& record, Arg& arg, const char* value);
+        static void capture(Record& record, Arg& arg, char* value) { capture(record, arg, (const char*)value); }
+        static void capture(Record& record, Arg& arg, const std::string& value) {
+            capture(record, arg, value.c_str());
+        }
+        template <size_t N>
+        static void capture(Record& record, Arg& arg, const char (&value)[N]) {
+            capture(record, arg, (const char*)value);
+        }
+    };
+}
+
+#ifndef OCTACUBIC_LOG_MIN_LEVEL
+#ifdef NDEBUG
+#define OCTACUBIC_LOG_MIN_LEVEL 1 // info
+#else
+#define OCTACUBIC_LOG_MIN_LEVEL 0 // debug
+#endif
+#endif
+
+#define OCTACUBIC_LOG(level, category, ...)                                         \
+    do {                                                                            \
+        if (::OctaCubic::Log::isEnabled(level)) {                                   \
+            static ::OctaCubic::Log::Site octaCubicLogSite(category);               \
+            ::OctaCubic::Log::write(level, octaCubicLogSite, __VA_ARGS__);          \
+        }                                                                           \
+    } while (0)
+
+// LOG_INFO("Chunk", "%d %d: Building Mesh", x, z)
+#if OCTACUBIC_LOG_MIN_LEVEL <= 0
+#define LOG_DEBUG(category, ...) OCTACUBIC_LOG(::OctaCubic::Log::debug, category, __VA_ARGS__)
+#else
+#define LOG_DEBUG(category, ...) ((void)0)
+#endif
+#if OCTACUBIC_LOG_MIN_LEVEL <= 1
+#define LOG_INFO(category, ...) OCTACUBIC_LOG(::OctaCubic::Log::info, category, __VA_ARGS__)
+#else
+#define LOG_INFO(category, ...) ((void)0)
+#endif
+#define LOG_WARNING(category, ...) OCTACUBIC_LOG(::OctaCubic::Log::warning, category, __VA_ARGS__)
+#define LOG_ERROR(category, ...) OCTACUBIC_LOG(::OctaCubic::Log::error, category, __VA_ARGS__)
@@ -0,0 +1,38 @@
+﻿#pragma once
+#include <atomic>
+#include <cstdint>
+
+namespace OctaCubic
+{
+    // Bytes held per subsystem, counted where the memory is created and released rather than estimated from
+    // RSS. Counters are lock-free and may be updated from any thread.
+    class MemoryStats {
+    public:
+        enum Tag {
+            chunkBlocks, // Block arrays of every chunk
+            chunkMap, // Hash map nodes and buckets, without the block arrays
+            meshData, // CPU copies of built meshes (opaque, water and depth vertices)
+            gpuChunkMeshes, // Mesh vertices resident in the GPU arenas; part of gpuChunkArenas, not totalled
+            gpuChunkArenas, // Vertex buffers of the arenas, including free space
+            gpuUploadRings,
+            gpuShadowMaps,
+            gpuTextures,
+            numTags
+        };
+        struct Counter {
+            int64_t bytes;
+            int64_t peakBytes;
+            int64_t numAllocations; // Live, not total
+        };
+
+        static void add(const Tag tag, const int64_t bytes);
+        static void sub(const Tag tag, const int64_t bytes);
+        // For resources that are resized in place: the allocation count stays the same
+        static void resize(const Tag tag, const int64_t oldBytes, const int64_t newBytes);
+
+        static Counter get(const Tag tag);
+        static const char* getTagName(const Tag tag);
+        static bool isGPU(const Tag tag);
+        static int64_t getTotalBytes(const bool gpu);
+    };
+}
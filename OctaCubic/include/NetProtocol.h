@@ -0,0 +1,65 @@
+﻿#pragma once
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "Socket.h"
+
+namespace OctaCubic
+{
+    // Chunk streaming protocol. Every message is a u32 payload size, a u8 type and the payload, encoded as in
+    // ByteStream.h.
+    struct NetMessage {
+        static constexpr uint32_t protocolVersion = 2;
+        static constexpr uint16_t defaultPort = 27960;
+        static constexpr uint32_t maxPayloadBytes = 1 << 20;
+
+        enum Type : uint8_t {
+            hello, // Client: u32 protocol version, u8 view distance (chunks)
+            welcome, // Server: i32 seed, u8 view distance granted
+            position, // Client: f32 x, y, z of the player; chunks are streamed around it
+            chunkData, // Server: i32 chunk x, i32 chunk z, Chunk::serializeBlocks
+            blockEdit, // Client: i32 x, y, z, u8 block id
+            blockDelta, // Server: i32 chunk x, i32 chunk z, Chunk::serializeDelta of the blocks changed in an update
+            numTypes
+        };
+
+        Type type = hello;
+        std::vector<uint8_t> payload;
+    };
+
+    // One end of a connection. Sent messages are framed into a buffer that flush() hands to the socket as far as
+    // it takes them; received bytes are reassembled into whole messages by poll(). Neither ever blocks.
+    class NetConnection {
+    public:
+        NetConnection() = default;
+        explicit NetConnection(Socket&& socket): socket_(std::move(socket)) {}
+
+        // The payload is appended to the returned buffer until endMessage()
+        std::vector<uint8_t>& beginMessage(const NetMessage::Type type);
+        void endMessage();
+        // False once the connection is closed or broken
+        bool flush();
+        // The next whole message received, if there is one. A malformed stream closes the connection.
+        bool poll(NetMessage& message);
+
+        bool isOpen() const { return socket_.isValid(); }
+        void close() { socket_.close(); }
+        // Framed but not taken by the socket yet
+        size_t getNumPendingBytes() const { return sendBuffer_.size() - sendOffset_; }
+        uint64_t getNumBytesSent() const { return numBytesSent_; }
+        uint64_t getNumBytesReceived() const { return numBytesReceived_; }
+
+    private:
+        static constexpr size_t headerBytes = 5;
+
+        Socket socket_;
+        std::vector<uint8_t> sendBuffer_;
+        size_t sendOffset_ = 0; // Bytes of sendBuffer_ already sent
+        size_t messageStart_ = 0; // Of the message between beginMessage and endMessage
+        std::vector<uint8_t> receiveBuffer_;
+        size_t receiveOffset_ = 0; // Bytes of receiveBuffer_ already returned by poll
+        uint64_t numBytesSent_ = 0;
+        uint64_t numBytesReceived_ = 0;
+    };
+}
@@ -7,7 +7,8 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
-#include "Player.h"
+#include "FrameSnapshot.h"
+#include "ShadowCascades.h"
 
 
 static const std::string window_title = "OctaCubic";
@@ -17,11 +18,9 @@ static int windowPosX = 0;
 static int windowPosY = 0;
 
 // Game Logic Variables
-static double timePrev = 0.0;
-static double timeCurr = 0.0;
-static double timeDiff;
-static double second = 0.0;
-static unsigned int frameCounter = 0;
+static double simulationTickRate = 60.0; // Fixed simulation ticks per second, independent of the frame rate
+static int viewDistance = 10; // In chunks
+static double frameBudgetMs = 1000.0 / 60; // Longer frames count as over budget in the frame stats
 
 static glm::vec3 lightColor = {1.0f, 1.0f, .95f};
 static float ambient = 0.15f;
@@ -30,7 +29,8 @@ static float ambient = 0.15f;
 static glm::mat4 camView;
 
 // light Position Transform
-static glm::vec3 lightPosition = {0.0f, 3.0f, 1.0f};
+static const glm::vec3 sunOffset = {0.0f, 3.0f, 1.0f}; // From the spawn, in world sizes, before lightPosRotZ
+static glm::vec3 lightPosition = sunOffset;
 
 // Transform Inputs
 static bool isFullScreen = false;
@@ -44,12 +44,11 @@ static float lightPosRotZ = 0.0f;
 size_t worldVertCount = 0;
 
 // render
-void drawVertices(OctaCubic::Player& player);
-void setShaderUniforms(bool isWater,
-                       const glm::mat4* camView,
-                       const glm::mat4* projection,
-                       const glm::mat4* lightPosMat,
-                       const glm::mat4* lightSpaceMat);
+// yaw, pitch: the first person look, newer than the snapshot's
+// alpha: how far the frame lies between the snapshot's tick and the one before
+void drawVertices(const OctaCubic::FrameSnapshot& snapshot, float yaw, float pitch, float alpha);
+// Per-pass uniforms of the active shader; per-frame ones live in the FrameUniforms buffer
+void setShaderUniforms(bool isWater);
 // Update Sky color based on the rotation of lightPosition
 void updateSkyColor();
 
@@ -59,18 +58,21 @@ unsigned char* texBlocks_data;
 unsigned int texBlocks;
 void setupTextures();
 
-// depth map
-unsigned int fboDepthMap;
-constexpr unsigned int shadow_width = 16384, shadow_height = 16384;
-unsigned int texDepthMap;
-void setupDepthMap();
+// Cascaded shadow maps
+static int shadowCascadeCount = 4;
+static int shadowResolution = 2048; // Per cascade
+static float shadowDistance = 320.0f; // Beyond this view distance nothing receives shadows
 bool showLightSpaceDepth = false;
+static int debugShadowCascade = 0; // Layer shown when showLightSpaceDepth
 
 // inputs
 static bool isFirstPersonView = false;
 static int playerMoveForward = 0;
 static int playerMoveRight = 0;
 static int playerMoveUp = 0;
+static bool playerSprinting = false;
+static bool playerJumpPressed = false; // Handed to the simulation with the next frame's input
+static bool playerToggleFloatingPressed = false;
 static bool cursorControlCam = false;
 static float cursorDeltaX = 0;
 static float cursorDeltaY = 0;
@@ -83,6 +85,15 @@ static bool mouseButtonRightPressedPrev = false; // true if last frame is presse
 static bool mouseButtonRightPressDown = false;
 
 // Debugging
-void updateDebuggingGUI(const OctaCubic::Player* player_ptr_local);
+void updateDebuggingGUI(const OctaCubic::FrameSnapshot& snapshot);
+// Profiler timeline of the last profilerWindowMs, every thread a lane, zones nested by depth
+void updateProfilerGUI();
+static bool showProfiler = false;
+static float profilerWindowMs = 50.0f;
+static bool isTraceDumpRequested = false;
+static const std::string traceDumpPath = "trace.json"; // Open in chrome://tracing or ui.perfetto.dev
+static double traceDumpSeconds = 5.0;
+static bool isFrameCsvToggleRequested = false;
+static const std::string frameCsvPath = "frames.csv"; // F8; OCTACUBIC_FRAME_CSV sets the path from the start
 
 #endif
@@ -2,18 +2,37 @@
 #include <glm/glm.hpp>
 #include <glm/ext/matrix_transform.hpp>
 
+#include "Log.h"
 #include "utils.h"
+#include "VoxelCollider.h"
 #include "World.h"
 
 #define PI 3.14159265
 
 namespace OctaCubic
 {
+    // Controls read by one simulation tick of the player. Tick code reads nothing else from the input devices,
+    // so a recorded stream of these replays the same movement.
+    struct PlayerInput {
+        int moveForward = 0;
+        int moveRight = 0;
+        int moveUp = 0; // Floating only
+        bool isSprinting = false;
+        bool isJumping = false;
+        bool isBreakingBlock = false;
+        bool isPlacingBlock = false;
+        bool isTogglingFloating = false;
+        float yaw = 0;
+        float pitch = 0;
+        int sunRotation = 0; // Q/E: +1, -1 or 0
+    };
+
     class Player {
     public:
         glm::vec3 dimensions{.6f, 1.8f, .6f};
         float eyeHeight = 1.62f;
         glm::vec3 location{0, 72, 0};
+        glm::vec3 previousLocation{0, 72, 0}; // Before the last tick, for render interpolation
         glm::vec3 aimingAtBlockCoord{0, 0, 0};
         face aimingAtBlockFace = xPos;
         bool isAimingAtSomeBlock = false;
@@ -26,6 +45,7 @@ namespace OctaCubic
         float speedSprint = 5.612f * 10;
         float speedJump = 10.0f;
         float gravityAc = -32.0f;
+        float stepHeight = 0.6f; // Walks up ledges lower than this; full blocks still need a jump
         float currSpeedUp = 0;
         float lastSpeedUp = 0;
         float tickSecond = 0; // updated in updateLocation();
@@ -34,14 +54,20 @@ namespace OctaCubic
         Player() = default;
 
         bool blockHasCollision(int x, int y, int z) const {
-            const int blockId = world_ptr->getBlockId({x, y, z});
-            return blockId > 0 && blockId != 10;
+            return World::isBlockSolid(world_ptr->getBlockId({x, y, z}));
         }
 
         bool isInAir() const {
             return currSpeedUp == 0.0f && lastSpeedUp == 0.0f;
         }
 
+        Aabb getBoundingBox() const {
+            return Aabb{
+                location - glm::vec3{dimensions.x / 2, 0, dimensions.z / 2},
+                location + glm::vec3{dimensions.x / 2, dimensions.y, dimensions.z / 2}
+            };
+        }
+
         void applyNewLocation(glm::vec3 deltaLocation) {
             if (!world_ptr) {
                 location.x += deltaLocation.x;
@@ -49,138 +75,26 @@ namespace OctaCubic
                 location.z += deltaLocation.z;
                 return;
             }
-            const int locXI = static_cast<int>(floor(location.x));
-            const int locYI = static_cast<int>(floor(location.y));
-            const int locZI = static_cast<int>(floor(location.z));
-            const float newLocX = location.x + deltaLocation.x;
-            const float newLocY = location.y + deltaLocation.y;
-            const float newLocZ = location.z + deltaLocation.z;
-
-            const float bias = 0.01f;
-            // ^ if not use it, player will stuck in an edge of a block if walking closely along a wall
-
-            ////// Update location X //////
-            location.x = clamp(newLocX,
-                               blockHasCollision(locXI - 1, locYI, locZI)
-                                   ? static_cast<float>(locXI) + dimensions.x / 2
-                                   : newLocX,
-                               blockHasCollision(locXI + 1, locYI, locZI)
-                                   ? static_cast<float>(locXI) - dimensions.x / 2 + 1
-                                   : newLocX
-            );
-            if (location.z - locZI < dimensions.z / 2 - bias) {
-                // player's z- side is out of current square
-                location.x = clamp(location.x,
-                                   blockHasCollision(locXI - 1, locYI, locZI - 1)
-                                       ? static_cast<float>(locXI) + dimensions.x / 2
-                                       : location.x,
-                                   blockHasCollision(locXI + 1, locYI, locZI - 1)
-                                       ? static_cast<float>(locXI) - dimensions.x / 2 + 1
-                                       : location.x
-                );
-            }
-            if (location.z - locZI > 1 - dimensions.z / 2 + bias) {
-                // player's z+ side is out of current square
-                location.x = clamp(location.x,
-                                   blockHasCollision(locXI - 1, locYI, locZI + 1)
-                                       ? static_cast<float>(locXI) + dimensions.x / 2
-                                       : location.x,
-                                   blockHasCollision(locXI + 1, locYI, locZI + 1)
-                                       ? static_cast<float>(locXI) - dimensions.x / 2 + 1
-                                       : location.x
-                );
-            }
+            const SweepResult sweep = collider_.move(*world_ptr, getBoundingBox(), deltaLocation, stepHeight);
+            location += sweep.delta;
+            currSpeedUp = sweep.delta.y / tickSecond; // Actual Speed Y
+        }
 
-            ////// Update Location Z //////
-            location.z = clamp(newLocZ,
-                               blockHasCollision(locXI, locYI, locZI - 1)
-                                   ? static_cast<float>(locZI) + dimensions.z / 2
-                                   : newLocZ,
-                               blockHasCollision(locXI, locYI, locZI + 1)
-                                   ? static_cast<float>(locZI) - dimensions.z / 2 + 1
-                                   : newLocZ
-            );
-            if (location.x - locXI < dimensions.x / 2 - bias) {
-                // player's x- side is out of current square
-                location.z = clamp(location.z,
-                                   blockHasCollision(locXI - 1, locYI, locZI - 1)
-                                       ? static_cast<float>(locZI) + dimensions.z / 2
-                                       : location.z,
-                                   blockHasCollision(locXI - 1, locYI, locZI + 1)
-                                       ? static_cast<float>(locZI) - dimensions.z / 2 + 1
-                                       : location.z
-                );
-            }
-            if (location.x - locXI > 1 - dimensions.x / 2 + bias) {
-                // player's x+ side is out of current square
-                location.z = clamp(location.z,
-                                   blockHasCollision(locXI + 1, locYI, locZI - 1)
-                                       ? static_cast<float>(locZI) + dimensions.z / 2
-                                       : location.z,
-                                   blockHasCollision(locXI + 1, locYI, locZI + 1)
-                                       ? static_cast<float>(locZI) - dimensions.z / 2 + 1
-                                       : location.z
-                );
-            }
+        // One fixed simulation step
+        void tick(const PlayerInput& input, const float tickSeconds) {
+            setRotation(input.yaw, input.pitch);
+            isSprinting = input.isSprinting;
+            if (input.isTogglingFloating) isFloating = !isFloating;
+            if (input.isJumping && !isFloating) jump();
+            updateLocation(tickSeconds, input.moveForward, input.moveRight, input.moveUp);
+        }
 
-            ////// Update Location Y //////
-            const float locYOld = location.y;
-            location.y = clamp(newLocY,
-                               blockHasCollision(locXI, locYI - 1, locZI)
-                                   ? static_cast<float>(locYI)
-                                   : newLocY,
-                               blockHasCollision(locXI, locYI + 2, locZI)
-                                   ? static_cast<float>(locYI) - dimensions.y + 2
-                                   : newLocY
-            );
-            if (location.x - locXI < dimensions.x / 2 - bias) {
-                // player's x- side is out of current square
-                location.y = clamp(location.y,
-                                   blockHasCollision(locXI - 1, locYI - 1, locZI)
-                                       ? static_cast<float>(locYI)
-                                       : location.y,
-                                   blockHasCollision(locXI - 1, locYI + 2, locZI)
-                                       ? static_cast<float>(locYI) - dimensions.y + 2
-                                       : location.y
-                );
-            }
-            if (location.x - locXI > 1 - dimensions.x / 2 + bias) {
-                // player's x+ side is out of current square
-                location.y = clamp(location.y,
-                                   blockHasCollision(locXI + 1, locYI - 1, locZI)
-                                       ? static_cast<float>(locYI)
-                                       : location.y,
-                                   blockHasCollision(locXI + 1, locYI + 2, locZI)
-                                       ? static_cast<float>(locYI) - dimensions.y + 2
-                                       : location.y
-                );
-            }
-            if (location.z - locZI < dimensions.z / 2 - bias) {
-                // player's z- side is out of current square
-                location.y = clamp(location.y,
-                                   blockHasCollision(locXI, locYI - 1, locZI - 1)
-                                       ? static_cast<float>(locYI)
-                                       : location.y,
-                                   blockHasCollision(locXI, locYI + 2, locZI - 1)
-                                       ? static_cast<float>(locYI) - dimensions.y + 2
-                                       : location.y
-                );
-            }
-            if (location.z - locZI > 1 - dimensions.z / 2 + bias) {
-                // player's z+ side is out of current square
-                location.y = clamp(location.y,
-                                   blockHasCollision(locXI, locYI - 1, locZI + 1)
-                                       ? static_cast<float>(locYI)
-                                       : location.y,
-                                   blockHasCollision(locXI, locYI + 2, locZI + 1)
-                                       ? static_cast<float>(locYI) - dimensions.y + 2
-                                       : location.y
-                );
-            }
-            currSpeedUp = (location.y - locYOld) / tickSecond; // Actual Speed Y
+        glm::vec3 getInterpolatedLocation(const float alpha) const {
+            return previousLocation + (location - previousLocation) * alpha;
         }
 
         void updateLocation(float interval, int inputForward, int inputRight, int inputUp) {
+            previousLocation = location;
             tickSecond = interval;
             lastSpeedUp = currSpeedUp;
             // Calculate horizontal movement
@@ -220,20 +134,37 @@ namespace OctaCubic
         }
 
         void updateRotation(const float deltaX, const float deltaY, const float sensitivity) {
+            applyLookDelta(yaw, pitch, deltaX, deltaY, sensitivity);
+            setRotation(yaw, pitch);
+        }
+
+        // Mouse look, for code that keeps the rotation apart from a Player
+        static void applyLookDelta(float& yaw, float& pitch, const float deltaX, const float deltaY,
+                                   const float sensitivity) {
             pitch = glm::clamp<float>(pitch - deltaY * sensitivity * .5f, -90, 90);
             yaw += deltaX * sensitivity * .5f;
             if (yaw >= 180) yaw -= 360;
             if (yaw < -180) yaw += 360;
+        }
+
+        void setRotation(const float newYaw, const float newPitch) {
+            yaw = newYaw;
+            pitch = newPitch;
             directionLooking.x = sin(glm::radians(yaw)) * cos(glm::radians(pitch));
             directionLooking.y = sin(glm::radians(pitch));
             directionLooking.z = -cos(glm::radians(yaw)) * cos(glm::radians(pitch));
         }
 
-        glm::mat4 getCameraViewMat4() const {
+        // alpha: see getInterpolatedLocation. The rotation is always the latest, so looking around is not delayed.
+        glm::mat4 getCameraViewMat4(const float alpha = 1.0f) const {
+            return getCameraViewMat4(getInterpolatedLocation(alpha) + glm::vec3{0, eyeHeight, 0}, yaw, pitch);
+        }
+
+        static glm::mat4 getCameraViewMat4(const glm::vec3& eyePosition, const float yaw, const float pitch) {
             glm::mat4 camView(1.0f);
             camView = glm::rotate(camView, glm::radians(pitch), glm::vec3(-1.0f, 0.0f, 0.0f));
             camView = glm::rotate(camView, glm::radians(yaw), glm::vec3(0.0f, 1.0f, 0.0f));
-            camView = glm::translate(camView, -location - glm::vec3{0, eyeHeight, 0});
+            camView = glm::translate(camView, -eyePosition);
             return camView;
         }
 
@@ -241,8 +172,8 @@ namespace OctaCubic
             location.x = 0.5;
             location.y = 256;
             location.z = 0.5;
-            printf("Generating player spawn at (%f, %f, %f)\n",
-                   location.x, location.y, location.z);
+            previousLocation = location;
+            LOG_INFO("Player", "Generating player spawn at (%f, %f, %f)", location.x, location.y, location.z);
             return true;
         }
 
@@ -253,5 +184,8 @@ namespace OctaCubic
                 static_cast<int>(floor(location.z))
             };
         }
+
+    private:
+        VoxelCollider collider_;
     };
 }
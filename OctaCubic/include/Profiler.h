@@ -0,0 +1,73 @@
+﻿#pragma once
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace OctaCubic
+{
+    // Scoped timing zones. Each thread records into a ring buffer of its own without locking; the last few
+    // seconds can be read back from any thread for a timeline or written out as a Chrome trace
+    // (chrome://tracing, Perfetto). Off until setEnabled(true); disabled, a zone costs one relaxed load, and
+    // OCTACUBIC_NO_PROFILER compiles them out.
+    class Profiler {
+    public:
+        struct Event {
+            const char* name; // Must outlive the profiler, usually a literal
+            uint64_t beginNs;
+            uint64_t endNs;
+            uint32_t depth; // Zones open around it on the same thread
+        };
+        struct ThreadEvents {
+            int threadId;
+            std::string threadName;
+            std::vector<Event> events; // In the order they ended
+        };
+
+        static constexpr size_t eventsPerThread = 1 << 15;
+
+        static bool isEnabled() { return isEnabled_.load(std::memory_order_relaxed); }
+        static void setEnabled(const bool isEnabled);
+        // Shown in traces and the timeline, instead of a number
+        static void setThreadName(const std::string& name);
+
+        // Nanoseconds since the profiler started
+        static uint64_t getNowNs();
+        static void record(const char* name, const uint64_t beginNs, const uint64_t endNs);
+
+        // Events of every thread that ended within the last seconds
+        static void collect(const double lastSeconds, std::vector<ThreadEvents>& threads);
+        static bool writeChromeTrace(const std::string& path, const double lastSeconds);
+
+    private:
+        static std::atomic<bool> isEnabled_;
+    };
+
+    class ProfileZone {
+    public:
+        explicit ProfileZone(const char* name): name_(Profiler::isEnabled() ? name : nullptr) {
+            if (name_) begin();
+        }
+        ~ProfileZone() {
+            if (name_) end();
+        }
+        ProfileZone(const ProfileZone&) = delete;
+        ProfileZone& operator=(const ProfileZone&) = delete;
+
+    private:
+        const char* name_;
+        uint64_t beginNs_ = 0;
+
+        void begin();
+        void end();
+    };
+}
+
+#define OCTACUBIC_PROFILE_CONCAT_(a, b) a##b
+#define OCTACUBIC_PROFILE_CONCAT(a, b) OCTACUBIC_PROFILE_CONCAT_(a, b)
+#ifdef OCTACUBIC_NO_PROFILER
+#define PROFILE_ZONE(name)
+#else
+// Times the rest of the enclosing scope
+#define PROFILE_ZONE(name) ::OctaCubic::ProfileZone OCTACUBIC_PROFILE_CONCAT(profileZone, __LINE__)(name)
+#endif
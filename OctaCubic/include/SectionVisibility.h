@@ -0,0 +1,32 @@
+﻿#pragma once
+#include <cstdint>
+#include <glm/vec3.hpp>
+
+#include "Quad.h"
+
+namespace OctaCubic
+{
+    // 6x6 face connectivity of a cubic chunk section: whether you can walk from one face to another
+    // through non-opaque voxels. Built at mesh time, consumed by the occlusion culling BFS.
+    class SectionVisibility {
+    public:
+        static constexpr int size = 16; // Section edge length in voxels
+        static constexpr int numVoxels = size * size * size;
+
+        SectionVisibility() = default;
+
+        void setConnected(const face a, const face b);
+        bool isConnected(const face a, const face b) const;
+        void setAllConnected();
+        uint64_t getBits() const { return bits_; }
+
+        // opaque[(y * size + z) * size + x] != 0 when the voxel blocks sight
+        static SectionVisibility compute(const uint8_t* opaque);
+
+        static face opposite(const face f);
+        static glm::ivec3 faceDirection(const face f);
+
+    private:
+        uint64_t bits_ = 0; // Bit (a * 6 + b) set when faces a and b are connected
+    };
+}
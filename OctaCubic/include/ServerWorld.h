@@ -0,0 +1,64 @@
+﻿#pragma once
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "FixedTimestep.h"
+#include "Player.h"
+#include "World.h"
+
+namespace OctaCubic
+{
+    // A world simulated without a window or GL context, for any number of players: the ticks of the game's
+    // Simulation, run for each player, and chunk generation around every one of them. Nothing is meshed unless
+    // asked for, and nothing calls setRenderQueue, so sendToGPU never runs and freeGPU finds nothing to free.
+    // Worlds share no state but the job system; one process can host many.
+    //
+    // Not thread safe: one thread at a time submits input and updates, usually a job per world.
+    class ServerWorld {
+    public:
+        using PlayerId = uint32_t;
+        static constexpr PlayerId invalidPlayer = ~0u;
+
+        ServerWorld(const int seed, const double tickRate, const int viewDistance, JobSystem* jobSystem = nullptr);
+        ServerWorld(const ServerWorld&) = delete;
+        ServerWorld& operator=(const ServerWorld&) = delete;
+
+        PlayerId addPlayer(const glm::vec3 spawn);
+        void removePlayer(const PlayerId id);
+        // As Simulation::submitInput: held controls are replaced, one-shot actions kept until a tick ran them
+        void submitInput(const PlayerId id, const PlayerInput& input);
+        // The ticks due by now for every player, then chunk loading; returns the number of ticks
+        int update(const double now);
+
+        // Meshes the chunks in view of every player too, as the game would (a client's share of the work)
+        void setMeshingEnabled(const bool isEnabled) { isMeshingEnabled_ = isEnabled; }
+
+        World& getWorld() { return world_; }
+        // nullptr once removed
+        const Player* getPlayer(const PlayerId id) const;
+        size_t getNumPlayers() const { return numPlayers_; }
+        const FixedTimestep& getClock() const { return clock_; }
+        double getLastUpdateMs() const { return lastUpdateMs_; }
+
+    private:
+        struct Slot {
+            std::unique_ptr<Player> player; // nullptr: free
+            PlayerInput pendingInput;
+            glm::ivec3 loadedCenter{0}; // Chunk the chunks around the player were last loaded for
+            bool isLoaded = false;
+        };
+
+        World world_;
+        FixedTimestep clock_;
+        int viewDistance_;
+        bool isMeshingEnabled_ = false;
+        std::vector<Slot> slots_; // Indexed by PlayerId
+        size_t numPlayers_ = 0;
+        std::vector<Chunk*> chunksInView_; // Scratch for updateChunks
+        double lastUpdateMs_ = 0;
+
+        void loadChunks(Slot& slot);
+    };
+}
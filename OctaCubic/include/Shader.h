@@ -10,6 +10,7 @@
 
 #include <fstream>
 #include <string>
+#include <unordered_map>
 
 typedef uint64_t uint64;
 typedef uint32_t uint32;
@@ -23,6 +24,8 @@ typedef int8_t int8;
 
 namespace OctaCubic
 {
+    class JobSystem;
+
     class Shader {
     public:
         static Shader* activeShader;
@@ -30,15 +33,45 @@ namespace OctaCubic
         Shader() = default;
         Shader(const char* vertexShaderPath, const char* fragmentShaderPath);
         void compile(const char* vertexShaderPath, const char* fragmentShaderPath);
+        // compile() in two halves: begin every program first, then finish them, so the driver can compile
+        // them in parallel. Programs whose binary is in the on-disk cache skip compilation entirely.
+        void beginCompile(const char* vertexShaderPath, const char* fragmentShaderPath);
+        void finishCompile();
         void use();
         const std::string readFile(const char* path);
 
-        // Link Uniforms
+        // Uses GL_KHR_parallel_shader_compile if available; returns whether it is
+        static bool enableParallelCompile(void* (*loadProc)(const char* name));
+        // Set before compiling: new program binaries are then read back by the next drainGLJobs() and written to
+        // the cache by a worker, instead of during finishCompile(). nullptr saves them right away.
+        static void setJobSystem(JobSystem* jobSystem) { jobSystem_ = jobSystem; }
+        static int numCacheHits;
+        static int numCacheMisses;
+
+        // Resolved once after linking; -1 if the program has no such active uniform
+        int getUniformLocation(const char* uniformName) const;
+
+        // Link Uniforms (into this program, no need to use() it first)
         void setBool(const char* uniformName, bool val);
         void setInt(const char* uniformName, int val);
         void setFloat(const char* uniformName, float val);
         void setVec3(const char* uniformName, const glm::vec3 &vec);
         void setVec4(const char* uniformName, const glm::vec4 &vec);
         void setMat4(const char* uniformName, const glm::mat4 &mat);
+
+    private:
+        static JobSystem* jobSystem_;
+        std::unordered_map<std::string, int> uniformLocations_;
+        std::string name_;
+        uint64 cacheKey_ = 0;
+        bool isLoadedFromCache_ = false;
+        uint32 pendingVertexShader_ = 0;
+        uint32 pendingFragmentShader_ = 0;
+
+        void cacheUniformLocations();
+        static uint64 computeCacheKey(const std::string& vertexSource, const std::string& fragmentSource);
+        std::string getCachePath() const;
+        bool loadProgramBinary();
+        void saveProgramBinary() const;
     };
 }
\ No newline at end of file
@@ -0,0 +1,98 @@
+﻿#pragma once
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+
+namespace OctaCubic
+{
+    // Something drawn into a shadow map; version must change whenever what it draws changes
+    struct ShadowCaster {
+        uint64_t id;
+        uint64_t version;
+        glm::vec3 boundsMin;
+        glm::vec3 boundsMax;
+    };
+
+    // Cascaded shadow maps: the camera frustum is cut into slices along view depth, each slice gets its own
+    // orthographic light projection and a layer of one depth texture array.
+    // A cascade is only re-rendered when its light matrix or its casters change, and only the changed region
+    // when a few casters changed. The light matrices are anchored to the world rather than the camera: each
+    // cascade covers its slice with some slack and keeps its matrix until the slice moves out of it.
+    class ShadowCascades {
+    public:
+        static constexpr int maxCascades = 4;
+
+        enum UpdateKind { cached, partial, full };
+
+        struct CascadeUpdate {
+            UpdateKind kind = cached;
+            int x = 0, y = 0, width = 0, height = 0; // Scissor rectangle in texels for partial updates
+            glm::mat4 regionMatrix{1.0f}; // Light space matrix of just the scissor rectangle, to cull casters with
+        };
+
+        ShadowCascades(int numCascades, int resolution);
+
+        // GL thread; (re)creates the depth texture array and framebuffer
+        void initGPU();
+        void setResolution(int resolution);
+        void setNumCascades(int numCascades);
+
+        // Fit the cascades to [nearZ, farZ] of the camera (view space distances, positive).
+        // lightDir points from the light towards the scene and should only change with the sun, since any change
+        // refits every cascade; casterDepth extends each cascade towards the light so that occluders outside the
+        // camera slice still cast shadows into it.
+        void update(const glm::mat4& camView, float fovY, float aspect, float nearZ, float farZ,
+                    const glm::vec3& lightDir, float casterDepth);
+
+        // Compares the cascade's light matrix and casters with the ones it was last rendered with and remembers
+        // the new ones; casters is sorted by id in place
+        CascadeUpdate planUpdate(int cascade, std::vector<ShadowCaster>& casters);
+        // Forget the cached contents; every cascade is fully rendered next frame
+        void invalidate();
+        // Binds the framebuffer to the cascade's layer, sets the viewport and clears the region to update
+        void beginCascade(int cascade, const CascadeUpdate& update) const;
+        void endCascade(const CascadeUpdate& update) const;
+
+        int getNumCascades() const { return numCascades_; }
+        int getResolution() const { return resolution_; }
+        glm::uint getTexture() const { return texture_; }
+        const glm::mat4& getLightSpaceMatrix(const int cascade) const { return lightSpaceMatrices_[cascade]; }
+        // Far edge of each cascade as view space distance
+        const float* getSplitDistances() const { return splitDistances_; }
+        size_t getMemoryBytes() const;
+        UpdateKind getLastUpdateKind(const int cascade) const { return lastUpdateKinds_[cascade]; }
+        // Frames planned with each kind since the cascades were created
+        uint64_t getUpdateCount(const int cascade, const UpdateKind kind) const { return updateCounts_[cascade][kind]; }
+
+        // Blend between logarithmic (1) and uniform (0) split placement
+        float splitLambda = 0.8f;
+        // A partial update larger than this fraction of the map becomes a full one
+        float maxPartialArea = 0.5f;
+        // Extent added around each slice, as a fraction of its radius: how far the camera can move before the
+        // cascade is refitted and fully re-rendered, paid for in texels per meter
+        float fitSlack = 0.25f;
+
+    private:
+        int numCascades_;
+        int resolution_;
+        glm::uint texture_ = 0;
+        glm::uint fbo_ = 0;
+        size_t accountedBytes_ = 0; // Reported to MemoryStats for the texture as allocated
+        glm::mat4 lightSpaceMatrices_[maxCascades];
+        float splitDistances_[maxCascades]{};
+
+        // Light space box each cascade covers, as center and half extent in the unmoved light space;
+        // 0 extent: refit next update
+        glm::vec3 fitCenters_[maxCascades];
+        float fitExtents_[maxCascades]{};
+        glm::vec3 fitLightDir_{0.0f};
+        float fitCasterDepth_ = 0;
+
+        // What each layer currently holds
+        bool isCacheValid_[maxCascades]{};
+        glm::mat4 renderedMatrices_[maxCascades];
+        std::vector<ShadowCaster> renderedCasters_[maxCascades];
+        UpdateKind lastUpdateKinds_[maxCascades]{};
+        uint64_t updateCounts_[maxCascades][3]{};
+    };
+}
@@ -0,0 +1,75 @@
+﻿#pragma once
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+#include "ChunkClient.h"
+#include "FixedTimestep.h"
+#include "FrameSnapshot.h"
+#include "InputRecording.h"
+#include "Player.h"
+#include "TripleBuffer.h"
+#include "World.h"
+
+namespace OctaCubic
+{
+    // The game state advanced at a fixed tick rate: the player, the blocks, and which chunks are generated and
+    // meshed. It runs on its own thread and publishes a FrameSnapshot after every update, so the render thread
+    // never reads the player or the blocks and CPU work overlaps with GPU submission.
+    class Simulation {
+    public:
+        Simulation(World& world, Player& player, const double tickRate, const int viewDistance);
+        ~Simulation();
+
+        // Runs update() on a thread of its own until stop(). Keep away from world and player in between.
+        void start();
+        void stop();
+        // One pass: the ticks due by now, chunk generation and meshing, then a snapshot. The thread loops on this.
+        void update(const double now);
+
+        // Any thread. The held controls replace the previous ones; one-shot actions (jump, break, place,
+        // toggle floating) are kept until a tick has run them.
+        void submitInput(const PlayerInput& input);
+        // Set before start(). Every tick's input goes to the recorder; while a replay lasts, ticks take their
+        // input from it and submitInput() is ignored. After the replay the ticks stop.
+        void setInputRecorder(InputRecorder* recorder) { recorder_ = recorder; }
+        void setInputReplay(InputReplay* replay) { replay_ = replay; }
+        // Set before start(). The world's chunks come from a server: every update loads what arrived and sends
+        // the position and the edits of its ticks, before meshing. The player is held in place until every chunk
+        // its box can move into during the tick has arrived, unless the connection is gone.
+        void setChunkClient(ChunkClient* client) { chunkClient_ = client; }
+        // Any thread: every tick of the replay has run
+        bool isReplayFinished() const { return isReplayFinished_; }
+        // The render thread acquires from here
+        TripleBuffer<FrameSnapshot>& getSnapshots() { return snapshots_; }
+
+        // Seconds on the steady clock the simulation runs by; what FrameSnapshot::tickTime is measured in
+        static double getClockSeconds();
+        // One tick of one player: movement and collision, the aiming raycast and block edits. The headless
+        // server runs the same for each of its players.
+        static void tickPlayer(World& world, Player& player, const PlayerInput& input, const float tickSeconds);
+
+    private:
+        World& world_;
+        Player& player_;
+        FixedTimestep clock_;
+        int viewDistance_;
+        float lightPosRotZ_ = 0;
+        std::mutex inputMutex_;
+        PlayerInput pendingInput_;
+        TripleBuffer<FrameSnapshot> snapshots_;
+        std::thread thread_;
+        std::atomic<bool> isRunning_{false};
+        InputRecorder* recorder_ = nullptr;
+        InputReplay* replay_ = nullptr;
+        ChunkClient* chunkClient_ = nullptr;
+        std::atomic<bool> isReplayFinished_{false};
+        bool isWaitingForChunks_ = false;
+        bool isDisconnectReported_ = false;
+
+        void run();
+        void tick(const PlayerInput& input);
+        bool hasChunksInReach(const float tickSeconds) const;
+        void publishSnapshot(const double updateMs);
+    };
+}
@@ -0,0 +1,44 @@
+﻿#pragma once
+#include <cstddef>
+#include <cstdint>
+
+namespace OctaCubic
+{
+    // Non-blocking TCP socket over Winsock or BSD sockets, with Nagle disabled: messages are batched by the
+    // caller already.
+    class Socket {
+    public:
+        Socket() = default;
+        ~Socket();
+        Socket(Socket&& other) noexcept;
+        Socket& operator=(Socket&& other) noexcept;
+        Socket(const Socket&) = delete;
+        Socket& operator=(const Socket&) = delete;
+
+        // Once per process before the first socket (Winsock needs it)
+        static bool startup();
+
+        // Port 0 picks a free port, see getLocalPort
+        bool listen(const char* address, const uint16_t port);
+        // A waiting connection, or an invalid socket when there is none
+        Socket accept();
+        // Blocks until connected
+        bool connect(const char* host, const uint16_t port);
+
+        // Bytes sent or received; 0 when it would block, -1 once the connection is closed or broken
+        long send(const void* data, const size_t size);
+        long receive(void* data, const size_t size);
+
+        uint16_t getLocalPort() const;
+        bool isValid() const { return handle_ != invalidHandle; }
+        void close();
+
+    private:
+        // SOCKET on Windows, a file descriptor elsewhere; both fit
+        static constexpr uintptr_t invalidHandle = ~static_cast<uintptr_t>(0);
+        uintptr_t handle_ = invalidHandle;
+
+        explicit Socket(const uintptr_t handle): handle_(handle) {}
+        bool configure();
+    };
+}
@@ -0,0 +1,39 @@
+﻿#pragma once
+#include <mutex>
+#include <utility>
+
+namespace OctaCubic
+{
+    // Hands whole objects from one producer thread to one consumer thread without either waiting for the other.
+    // The producer fills getWriteBuffer() and publishes it; the consumer acquires the newest published one and
+    // reads it until its next acquire. The third slot is what lets both sides run without blocking.
+    template <typename T>
+    class TripleBuffer {
+    public:
+        // Producer
+        T& getWriteBuffer() { return slots_[write_]; }
+        void publish() {
+            std::lock_guard<std::mutex> lock(mutex_);
+            std::swap(write_, ready_);
+            isReadyNew_ = true;
+        }
+
+        // Consumer; false if nothing was published since the last acquire (the read buffer stays the same)
+        bool acquire() {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!isReadyNew_) return false;
+            std::swap(read_, ready_);
+            isReadyNew_ = false;
+            return true;
+        }
+        const T& getReadBuffer() const { return slots_[read_]; }
+
+    private:
+        T slots_[3];
+        int write_ = 0;
+        int ready_ = 1;
+        int read_ = 2;
+        bool isReadyNew_ = false;
+        std::mutex mutex_; // Only held to swap indices
+    };
+}
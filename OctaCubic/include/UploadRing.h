@@ -0,0 +1,92 @@
+﻿#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <glm/fwd.hpp>
+
+typedef struct __GLsync* GLsync;
+
+namespace OctaCubic
+{
+    // Persistently mapped staging buffer used as a ring.
+    // Any thread may allocate and write into it; only the GL thread issues copies out of it and fences them.
+    // A range is reused once the fence placed after its copy has signaled.
+    class UploadRing {
+    public:
+        struct Allocation {
+            uint64_t id = 0;
+            size_t offset = 0;
+            size_t size = 0;
+            void* data = nullptr; // Mapped pointer to write to
+            bool isValid() const { return data != nullptr; }
+        };
+
+        explicit UploadRing(size_t capacity);
+
+        // GL thread; creates and maps the buffer
+        void initGPU();
+        bool isReady() const { return mapped_ != nullptr; }
+
+        // Any thread, never blocks. Returns an invalid allocation when the ring is full.
+        Allocation tryAllocate(size_t size);
+        // GL thread; waits for in-flight copies to finish until the size fits (counted as a stall).
+        // Returns an invalid allocation if the size can never fit.
+        Allocation allocate(size_t size);
+        // GL thread; copies the allocation into dstBuffer at dstOffset (bytes)
+        void copyTo(const Allocation& allocation, glm::uint dstBuffer, size_t dstOffset);
+        // Any thread; hands back an allocation that will not be copied
+        void cancel(const Allocation& allocation);
+        // GL thread, once per frame: fences the copies issued since the last call and recycles finished ranges
+        void endFrame();
+
+        size_t getCapacity() const { return capacity_; }
+        size_t getLastFrameUploadBytes() const { return lastFrameUploadBytes_; }
+        size_t getLastFrameStalls() const { return lastFrameStalls_; }
+        double getLastFrameStallMs() const { return lastFrameStallMs_; }
+        size_t getTotalStalls() const { return totalStalls_; }
+
+    private:
+        enum RecordState { staged, copied, cancelled };
+
+        struct Record {
+            uint64_t id;
+            size_t offset;
+            size_t size;
+            RecordState state;
+            uint64_t fenceSerial; // 0 until a fence covers it
+        };
+
+        struct Fence {
+            uint64_t serial;
+            GLsync sync;
+        };
+
+        size_t capacity_;
+        glm::uint buffer_ = 0;
+        uint8_t* mapped_ = nullptr;
+
+        std::mutex mutex_; // Guards records_, head_ and nextId_, and mapped_ for other threads than the GL thread
+        std::deque<Record> records_; // In allocation order, which is also ring order
+        size_t head_ = 0;
+        uint64_t nextId_ = 1;
+
+        std::deque<Fence> fences_; // GL thread only
+        uint64_t nextFenceSerial_ = 1;
+        uint64_t completedFenceSerial_ = 0;
+
+        std::atomic<size_t> frameUploadBytes_{0};
+        size_t frameStalls_ = 0;
+        double frameStallMs_ = 0;
+        size_t lastFrameUploadBytes_ = 0;
+        size_t lastFrameStalls_ = 0;
+        double lastFrameStallMs_ = 0;
+        size_t totalStalls_ = 0;
+
+        Allocation allocateLocked(size_t size);
+        Record* findRecordLocked(uint64_t id);
+        void pollFences(bool wait);
+        void retireLocked();
+    };
+}
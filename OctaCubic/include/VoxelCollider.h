@@ -0,0 +1,43 @@
+﻿#pragma once
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "World.h"
+
+namespace OctaCubic
+{
+    struct Aabb {
+        glm::vec3 min;
+        glm::vec3 max;
+    };
+
+    struct SweepResult {
+        glm::vec3 delta{0}; // Movement actually made
+        bool isBlocked[3] = {false, false, false}; // Per axis, the movement was cut short
+        bool isOnGround = false; // Stopped by a block below
+        bool hasSteppedUp = false;
+    };
+
+    // Swept AABB against the solid blocks of a world. The blocks the whole movement could touch are read once
+    // into a small occupancy grid, then the movement is clipped one axis at a time (Y, X, Z), so fast movers
+    // cannot tunnel. Keep one collider per thread and reuse it; the grid storage is recycled between moves.
+    class VoxelCollider {
+    public:
+        // Blocked horizontal movement on the ground is retried stepHeight higher, up onto ledges that low
+        SweepResult move(World& world, const Aabb& box, const glm::vec3& delta, const float stepHeight = 0);
+
+    private:
+        static constexpr float epsilon = 1e-4f;
+
+        void gather(World& world, const Aabb& box, const glm::vec3& delta, const float stepHeight);
+        bool isSolid(const int x, const int y, const int z) const;
+        // Longest movement along axis, up to distance, before box hits a solid block
+        float clipAxis(const Aabb& box, const int axis, const float distance) const;
+        // Clip delta axis by axis, moving box along
+        glm::vec3 clipMove(Aabb& box, const glm::vec3& delta, bool isBlocked[3]) const;
+
+        glm::ivec3 gridMin_{0};
+        glm::ivec3 gridSize_{0};
+        std::vector<uint8_t> solid_;
+    };
+}
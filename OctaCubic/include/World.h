@@ -1,9 +1,13 @@
 ﻿#pragma once
 #include <unordered_map>
+#include <unordered_set>
 #include <glm/vec3.hpp>
 
 #include "Chunk.h"
+#include "Frustum.h"
+#include "JobSystem.h"
 #include "Quad.h"
+#include "ShadowCascades.h"
 
 namespace OctaCubic
 {
@@ -19,44 +23,172 @@ namespace OctaCubic
             : isHit(hit), x(x), y(y), z(z), f(face) {}
     };
 
+    // Counted in non-empty chunk sections
+    struct CullingStats {
+        size_t drawn = 0;
+        size_t culled = 0; // Outside the frustum
+        size_t occluded = 0; // Inside the frustum but not reachable through the section connectivity graph
+    };
+
+    struct RayQuery {
+        glm::vec3 start;
+        glm::vec3 dir;
+        float len;
+    };
+
+    // A block changed by World::setBlockId
+    struct BlockEdit {
+        glm::ivec3 coordWorld;
+        uint8_t blockId;
+    };
+
+    struct RenderQueueItem {
+        Chunk* chunk;
+        section_mask sections;
+    };
+
     class World {
     public:
         int altitudeSeaSurface = 23;
         float worldDimMax = 256.0f;
 
         World();
+        ~World();
         static void randomizeSeed();
         int generateSeed();
+        // Terrain of chunks generated from now on
+        void setSeed(const int seed) { seed_ = seed; }
+        int getSeed() const { return seed_; }
 
         bool isOutOfBound(const glm::ivec3& coordWorld) const;
         int getBlockId(const glm::ivec3& coordWorld);
         int setBlockId(const glm::ivec3& coordWorld, const uint8_t blockId);
+        // Every block setBlockId actually changes is appended to log, until set back to nullptr
+        void setEditLog(std::vector<BlockEdit>* log) { editLog_ = log; }
 
         static bool isBlockOpaque(const int blockId);
+        static bool isBlockSolid(const int blockId); // Has collision
         bool isBlockOpaqueAtCoord(const glm::ivec3& coordWorld);
 
         static glm::ivec3 insideBlockCoordinates(const glm::vec3 pos);
 
+        // First non-air block whose face the segment start + dir * [0, len] crosses
         CoordinatesAndFace lineTraceToFace(const glm::vec3 start, const glm::vec3 dir, const float len);
+        // Batched lineTraceToFace (entities, line of sight, explosions); results[i] belongs to rays[i].
+        // Consecutive rays share the chunk lookup cache, so group rays by area for best results.
+        void traceRays(const RayQuery* rays, const size_t numRays, CoordinatesAndFace* results);
+        void traceRays(const std::vector<RayQuery>& rays, std::vector<CoordinatesAndFace>& results);
+
+        // Reads blocks through the last chunk it touched, skipping the chunk map lookup for neighbouring reads.
+        // Chunk pointers stay valid as chunks are added; do not keep one across removing chunks.
+        class BlockReader {
+        public:
+            explicit BlockReader(World& world);
+            int getBlockId(const glm::ivec3& coordWorld);
+
+        private:
+            World& world_;
+            const Chunk* chunk_ = nullptr;
+            chunk_coord chunkCoord_{0, 0, 0};
+            bool hasChunk_ = false;
+        };
 
         static glm::ivec3 getCoordLocalToChunk(const glm::ivec3 coordWorld);
         static glm::ivec3 getCoordLocalToChunk(const glm::vec3 coordWorld);
         static glm::ivec3 getCoordChunk(const glm::ivec3 coordWorld);
         static glm::ivec3 getCoordChunk(const glm::vec3 coordWorld);
 
+        // Generation, meshing and culling are spread over jobSystem's workers; nullptr runs them here
+        void bindJobSystem(JobSystem* jobSystem);
+        JobSystem* getJobSystem() const;
+        // Set before meshing when a GL thread runs the job system's GL jobs every frame: each chunk meshed on a
+        // worker is handed to it right away, instead of waiting for a setRenderQueue that has it in view
+        void setMeshesToGLJobs(const bool isEnabled) { isMeshesToGLJobs_ = isEnabled; }
+
+        // Generate terrain for missing chunks within distance (in chunks) of centerChunk; no meshing, no GL
+        void generateChunks(const glm::ivec3 centerChunk, const int distance);
+        // A client world takes its terrain from the server: missing chunks are created blank instead of generated
+        // and filled in by loadChunk as they arrive
+        void setTerrainGenerated(const bool isGenerated) { isTerrainGenerated_ = isGenerated; }
+        // Simulation thread: blocks serialized by Chunk::serializeBlocks replace the chunk's (created if missing);
+        // the chunk and its neighbours are meshed again. False if the data is corrupt.
+        bool loadChunk(const chunk_coord c, const uint8_t* data, const size_t size);
+        // Simulation thread: a block delta (Chunk::serializeDelta) for chunk c; bypasses the edit log. False if the
+        // chunk is missing or the data corrupt.
+        bool applyChunkDelta(const chunk_coord c, const uint8_t* data, const size_t size);
+        bool isChunkCreated(const chunk_coord c) const;
+        // Serialized blocks of a chunk, appended to out; false if the chunk does not exist
+        bool serializeChunk(const chunk_coord c, std::vector<uint8_t>& out);
+        // Block delta of the blocks at indices (Chunk::getBlockIndex, sorted, no duplicates) of chunk c
+        bool serializeChunkDelta(const chunk_coord c, const std::vector<uint16_t>& indices, std::vector<uint8_t>& out);
+        // Simulation thread: generate and mesh every chunk within viewDistance (in chunks) of center.
+        // chunksInView receives them as the X major grid setRenderQueue expects.
+        void updateChunks(const glm::ivec3 center, const int viewDistance, std::vector<Chunk*>& chunksInView);
+        // Render thread: chunksInView from updateChunks becomes the render queue. New meshes are sent to the GPU
+        // and chunks that left the view free their GPU memory. Everything below runs on the render thread too.
+        void setRenderQueue(const std::vector<Chunk*>& chunksInView, const glm::ivec3 center, const int viewDistance);
+        // updateChunks and setRenderQueue in one go, for single threaded use
         void smartRenderingPreprocess(const glm::ivec3 center, const int viewDistance);
         void smartRenderingPreprocess(const glm::vec3 center, const int viewDistance);
+        size_t getNumChunksInGPU() const;
+        // Since the world was created; simulation thread
+        uint64_t getNumChunksGenerated() const { return numChunksGenerated_; }
+        uint64_t getNumChunksMeshed() const { return numChunksMeshed_; }
+        // Narrow the render queue down to the sections inside a frustum; call after smartRenderingPreprocess.
+        // The camera pass also skips sections hidden behind terrain (BFS over section face connectivity).
+        void cullForCamera(const glm::mat4& camViewProjection, const glm::vec3& camPosition);
+        // Each shadow cascade keeps its own queue
+        void cullForLight(const glm::mat4& lightSpaceMatrix, const int cascade);
         void renderInQueueOpaque();
         void renderInQueueWater();
+        // With a regionMatrix only the sections inside that (sub) light frustum are drawn
+        void renderInQueueShadow(const int cascade, const glm::mat4* regionMatrix = nullptr);
+        // Chunks drawn by a cascade, for shadow caching
+        void getShadowCasters(const int cascade, std::vector<ShadowCaster>& casters) const;
+        const CullingStats& getCameraCullingStats() const;
+        const CullingStats& getLightCullingStats(const int cascade) const;
+        // World space bounds of the chunks in the render queue
+        glm::vec3 getRenderQueueBoundsMin() const;
+        glm::vec3 getRenderQueueBoundsMax() const;
 
     private:
-        int seed_;
+        int seed_ = 0;
+        bool isTerrainGenerated_ = true;
+        std::vector<BlockEdit>* editLog_ = nullptr;
 
         std::vector<Chunk*> renderWaitingQueue_;
+        glm::ivec3 renderQueueMin_{0, 0, 0}; // Chunk coordinates of renderWaitingQueue_[0]
+        int renderQueueDim_ = 0; // renderWaitingQueue_ is a renderQueueDim_ x renderQueueDim_ grid, X major
+        std::vector<RenderQueueItem> cameraVisibleQueue_;
+        std::vector<RenderQueueItem> lightVisibleQueues_[ShadowCascades::maxCascades];
+        CullingStats cameraCullingStats_;
+        CullingStats lightCullingStats_[ShadowCascades::maxCascades];
+        std::vector<DrawArraysIndirectCommand> drawCommands_; // Reused by every pass to avoid reallocating
+        std::unordered_set<Chunk*> chunksInGPU_;
+        std::vector<Chunk*> chunksInView_; // Scratch for smartRenderingPreprocess
 
         std::unordered_map<chunk_coord, Chunk, ChunkCoordHash> chunkMap_;
+        JobSystem* jobSystem_ = nullptr;
+        std::vector<Chunk*> chunksToBuild_; // Scratch for generateChunks and updateChunks
+        bool isMeshesToGLJobs_ = false;
+        size_t chunkMapBytes_ = 0; // Reported to MemoryStats
+        uint64_t numChunksGenerated_ = 0;
+        uint64_t numChunksMeshed_ = 0;
+
+        // body over [0, count) on the job system if there is one
+        void parallelFor(const size_t count, const std::function<void(size_t begin, size_t end)>& body);
 
-        bool isChunkCreated(const chunk_coord c);
+        void updateChunkMapMemory();
         Chunk* getChunk(const chunk_coord c);
+        // GL job for a chunk just meshed: sent to the GPU if it is in the render queue's view
+        void sendMeshed(Chunk* ptr_chunk);
+        void cullRenderQueue(const Frustum& frustum, std::vector<RenderQueueItem>& visibleQueue,
+                             CullingStats& stats) const;
+        static bool isSectionInFrustum(const Frustum& frustum, const Chunk* ptr_chunk, const int section);
+        // Debug builds: asserts that rays from the camera only hit blocks in sections the culling BFS reached
+        void checkOcclusion(const glm::mat4& camViewProjection, const glm::vec3& camPosition,
+                            const std::vector<section_mask>& reached);
+        static CoordinatesAndFace traceRay(BlockReader& reader, const glm::vec3 start, const glm::vec3 dir,
+                                           const float len);
     };
 }
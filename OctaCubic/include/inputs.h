@@ -3,11 +3,12 @@
 #include <GLFW/glfw3.h>
 
 #include "OctaCubic.h"
+#include "Profiler.h"
 
 extern OctaCubic::World world;
-extern OctaCubic::Player* player_ptr;
 extern OctaCubic::Shader shader;
 extern OctaCubic::Shader shNormal;
+extern OctaCubic::ShadowCascades shadowCascades;
 
 void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods);
 void mouseCallback(GLFWwindow* window, int button, int action, int mods);
@@ -34,18 +35,17 @@ inline void keyCallback(GLFWwindow* window, int key, int scancode, int action, i
         if (key == GLFW_KEY_D && action == GLFW_RELEASE) playerMoveRight = 0;
         if (key == GLFW_KEY_A && action == GLFW_PRESS) playerMoveRight = -1;
         if (key == GLFW_KEY_A && action == GLFW_RELEASE) playerMoveRight = 0;
-        if (key == GLFW_KEY_F10 && action == GLFW_PRESS) player_ptr->isFloating = !player_ptr->isFloating;
-        if (player_ptr->isFloating) {
-            if (key == GLFW_KEY_SPACE && action == GLFW_PRESS) playerMoveUp = +1;
-            if (key == GLFW_KEY_SPACE && action == GLFW_RELEASE) playerMoveUp = 0;
-            if (key == GLFW_KEY_LEFT_CONTROL && action == GLFW_PRESS) playerMoveUp = -1;
-            if (key == GLFW_KEY_LEFT_CONTROL && action == GLFW_RELEASE) playerMoveUp = 0;
+        if (key == GLFW_KEY_F10 && action == GLFW_PRESS) playerToggleFloatingPressed = true;
+        // Whether the player floats is up to the simulation: SPACE both jumps and rises
+        if (key == GLFW_KEY_SPACE && action == GLFW_PRESS) {
+            playerJumpPressed = true;
+            playerMoveUp = +1;
         }
-        else {
-            if (key == GLFW_KEY_SPACE && action == GLFW_PRESS) player_ptr->jump();
-        }
-        if (key == GLFW_KEY_LEFT_SHIFT && action == GLFW_PRESS) player_ptr->isSprinting = true;
-        if (key == GLFW_KEY_LEFT_SHIFT && action == GLFW_RELEASE) player_ptr->isSprinting = false;
+        if (key == GLFW_KEY_SPACE && action == GLFW_RELEASE) playerMoveUp = 0;
+        if (key == GLFW_KEY_LEFT_CONTROL && action == GLFW_PRESS) playerMoveUp = -1;
+        if (key == GLFW_KEY_LEFT_CONTROL && action == GLFW_RELEASE) playerMoveUp = 0;
+        if (key == GLFW_KEY_LEFT_SHIFT && action == GLFW_PRESS) playerSprinting = true;
+        if (key == GLFW_KEY_LEFT_SHIFT && action == GLFW_RELEASE) playerSprinting = false;
     }
     if (key == GLFW_KEY_Q && action == GLFW_PRESS) lightPosInputRotZ = +1;
     if (key == GLFW_KEY_Q && action == GLFW_RELEASE) lightPosInputRotZ = 0;
@@ -66,7 +66,14 @@ inline void keyCallback(GLFWwindow* window, int key, int scancode, int action, i
     }
     if (key == GLFW_KEY_F4 && action == GLFW_PRESS) {
         glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-        showLightSpaceDepth = !showLightSpaceDepth;
+        // Cycle through the cascades, then back to the normal view
+        if (!showLightSpaceDepth) {
+            showLightSpaceDepth = true;
+            debugShadowCascade = 0;
+        }
+        else if (++debugShadowCascade >= shadowCascades.getNumCascades()) {
+            showLightSpaceDepth = false;
+        }
     }
     if (key == GLFW_KEY_F5 && action == GLFW_PRESS) {
         isFirstPersonView = !isFirstPersonView;
@@ -84,8 +91,12 @@ inline void keyCallback(GLFWwindow* window, int key, int scancode, int action, i
         glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
     }
     if (key == GLFW_KEY_F11 && action == GLFW_PRESS) toggleFullScreen(window);
-    if (key == GLFW_KEY_F12 && action == GLFW_PRESS) {
+    if (key == GLFW_KEY_F7 && action == GLFW_PRESS) {
+        showProfiler = !showProfiler;
+        if (showProfiler) OctaCubic::Profiler::setEnabled(true); // The timeline would be empty otherwise
     }
+    if (key == GLFW_KEY_F8 && action == GLFW_PRESS) isFrameCsvToggleRequested = true;
+    if (key == GLFW_KEY_F12 && action == GLFW_PRESS) isTraceDumpRequested = true;
 }
 
 inline void mouseCallback(GLFWwindow* window, int button, int action, int mods) {
@@ -0,0 +1,67 @@
+﻿#include "ArenaAllocator.h"
+
+#include <algorithm>
+#include <iterator>
+
+using namespace OctaCubic;
+
+constexpr size_t ArenaAllocator::invalidOffset;
+
+ArenaAllocator::ArenaAllocator(const size_t capacity): capacity_(capacity) {
+    if (capacity > 0) freeBlocks_.emplace(0, capacity);
+}
+
+size_t ArenaAllocator::allocate(const size_t size) {
+    if (size == 0) return invalidOffset;
+    for (auto it = freeBlocks_.begin(); it != freeBlocks_.end(); ++it) {
+        if (it->second < size) continue;
+        const size_t offset = it->first;
+        const size_t remaining = it->second - size;
+        freeBlocks_.erase(it);
+        if (remaining > 0) freeBlocks_.emplace(offset + size, remaining);
+        allocations_.emplace(offset, size);
+        used_ += size;
+        return offset;
+    }
+    return invalidOffset;
+}
+
+void ArenaAllocator::free(const size_t offset) {
+    const auto it = allocations_.find(offset);
+    if (it == allocations_.end()) return; // Not allocated (or already freed)
+    const size_t size = it->second;
+    allocations_.erase(it);
+    used_ -= size;
+    insertFreeBlock(offset, size);
+}
+
+void ArenaAllocator::grow(const size_t newCapacity) {
+    if (newCapacity <= capacity_) return;
+    const size_t oldCapacity = capacity_;
+    capacity_ = newCapacity;
+    insertFreeBlock(oldCapacity, newCapacity - oldCapacity);
+}
+
+size_t ArenaAllocator::getLargestFreeBlock() const {
+    size_t largest = 0;
+    for (const auto& block : freeBlocks_) largest = std::max(largest, block.second);
+    return largest;
+}
+
+void ArenaAllocator::insertFreeBlock(size_t offset, size_t size) {
+    auto next = freeBlocks_.lower_bound(offset);
+    // Merge with the block right after
+    if (next != freeBlocks_.end() && offset + size == next->first) {
+        size += next->second;
+        next = freeBlocks_.erase(next);
+    }
+    // Merge with the block right before
+    if (next != freeBlocks_.begin()) {
+        const auto prev = std::prev(next);
+        if (prev->first + prev->second == offset) {
+            prev->second += size;
+            return;
+        }
+    }
+    freeBlocks_.emplace_hint(next, offset, size);
+}
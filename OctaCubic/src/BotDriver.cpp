@@ -0,0 +1,122 @@
+﻿#include "BotDriver.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace OctaCubic
+{
+    namespace
+    {
+        constexpr float spawnHeight = 256; // Above any terrain; bots fall to the ground first
+        constexpr float minBehaviourSeconds = 2;
+        constexpr float maxBehaviourSeconds = 10;
+        constexpr int ticksPerEdit = 6; // While building
+        constexpr float degreesPerRadian = 57.29578f;
+    }
+
+    BotDriver::BotDriver(ServerWorld& world, const uint32_t seed, const float areaRadius)
+        : world_(world), seed_(seed), areaRadius_(areaRadius) {}
+
+    void BotDriver::addBots(const size_t count) {
+        bots_.reserve(bots_.size() + count);
+        for (size_t i = 0; i < count; ++i) {
+            bots_.emplace_back();
+            Bot& bot = bots_.back();
+            std::seed_seq seq{seed_, static_cast<uint32_t>(bots_.size() - 1)};
+            bot.rng.seed(seq);
+            std::uniform_real_distribution<float> area(-areaRadius_, areaRadius_);
+            const float x = area(bot.rng);
+            const float z = area(bot.rng);
+            bot.id = world_.addPlayer({x, spawnHeight, z});
+            bot.yaw = std::uniform_real_distribution<float>(0, 360)(bot.rng);
+            bot.lastLocation = world_.getPlayer(bot.id)->location;
+            chooseBehaviour(bot);
+        }
+    }
+
+    void BotDriver::submitInputs() {
+        for (Bot& bot : bots_) {
+            const Player* player = world_.getPlayer(bot.id);
+            if (!player) continue;
+            if (--bot.ticksLeft <= 0) chooseBehaviour(bot);
+            const PlayerInput input = steer(bot, *player);
+            world_.submitInput(bot.id, input);
+            bot.lastLocation = player->location;
+            ++stats_.behaviourTicks[bot.behaviour];
+            if (input.isBreakingBlock) ++stats_.numBreaks;
+            if (input.isPlacingBlock) ++stats_.numPlacements;
+        }
+    }
+
+    void BotDriver::chooseBehaviour(Bot& bot) {
+        // Mostly on foot: walking and sprinting are what players do most
+        std::discrete_distribution<int> behaviours{35, 25, 15, 25};
+        bot.behaviour = static_cast<Behaviour>(behaviours(bot.rng));
+        const float seconds = std::uniform_real_distribution<float>(minBehaviourSeconds, maxBehaviourSeconds)(bot.rng);
+        bot.ticksLeft = std::max(1, static_cast<int>(seconds * world_.getClock().getTickRate()));
+        bot.pitch = bot.behaviour == building ? std::uniform_real_distribution<float>(-80, -30)(bot.rng) : 0;
+        bot.flyHeight = std::uniform_real_distribution<float>(90, 160)(bot.rng);
+    }
+
+    PlayerInput BotDriver::steer(Bot& bot, const Player& player) {
+        PlayerInput input;
+        const glm::vec3& location = player.location;
+        // Wander, but head back in once outside the area; yaw 0 faces z-, yaw 90 faces x+
+        if (std::abs(location.x) > areaRadius_ || std::abs(location.z) > areaRadius_)
+            bot.yaw = std::atan2(-location.x, location.z) * degreesPerRadian;
+        else
+            bot.yaw += std::uniform_real_distribution<float>(-3, 3)(bot.rng);
+        bot.yaw = std::fmod(bot.yaw + 360, 360.0f);
+        input.yaw = bot.yaw;
+        input.pitch = bot.pitch;
+
+        const bool shouldFloat = bot.behaviour == flying;
+        input.isTogglingFloating = player.isFloating != shouldFloat;
+        switch (bot.behaviour) {
+            case walking:
+            case sprinting: {
+                input.moveForward = 1;
+                input.isSprinting = bot.behaviour == sprinting;
+                // Barely moved: something is in the way
+                const glm::vec3 moved = location - bot.lastLocation;
+                input.isJumping = moved.x * moved.x + moved.z * moved.z < 0.0025f;
+                break;
+            }
+            case flying:
+                input.moveForward = 1;
+                input.isSprinting = true;
+                input.moveUp = location.y < bot.flyHeight ? 1 : (location.y > bot.flyHeight + 8 ? -1 : 0);
+                break;
+            case building:
+                if (bot.ticksLeft % ticksPerEdit == 0) {
+                    if (bot.rng() % 2) input.isBreakingBlock = true;
+                    else input.isPlacingBlock = true;
+                }
+                break;
+            default:
+                break;
+        }
+        return input;
+    }
+
+    uint32_t BotDriver::getLocationHash() const {
+        uint32_t hash = 2166136261u;
+        for (const Bot& bot : bots_) {
+            const Player* player = world_.getPlayer(bot.id);
+            if (!player) continue;
+            const unsigned char* bytes = reinterpret_cast<const unsigned char*>(&player->location);
+            for (size_t i = 0; i < sizeof(player->location); ++i) hash = (hash ^ bytes[i]) * 16777619u;
+        }
+        return hash;
+    }
+
+    const char* BotDriver::getBehaviourName(const Behaviour behaviour) {
+        switch (behaviour) {
+            case walking: return "walking";
+            case sprinting: return "sprinting";
+            case flying: return "flying";
+            case building: return "building";
+            default: return "unknown";
+        }
+    }
+}
@@ -4,16 +4,23 @@
 #include <glm/ext/matrix_transform.hpp>
 
 #include "World.h"
+#include "ByteStream.h"
+#include "Log.h"
+#include "MemoryStats.h"
 #include "perlin.h"
+#include "Profiler.h"
 #include "Quad.h"
 
 using namespace OctaCubic;
 
-std::unordered_set<chunk_coord, ChunkCoordHash> Chunk::chunkInGPUSet;
+std::atomic<uint64_t> Chunk::nextMeshVersion_{0};
 
-Chunk::Chunk(): chunkCoord_({0, 0, 0}) {}
+Chunk::Chunk(): chunkCoord_({0, 0, 0}) {
+    MemoryStats::add(MemoryStats::chunkBlocks, sizeof(blocks_));
+}
 
 Chunk::Chunk(const int cX, const int cZ): chunkCoord_({cX, 0, cZ}) {
+    MemoryStats::add(MemoryStats::chunkBlocks, sizeof(blocks_));
     for (int x = 0; x < width; ++x)
         for (int z = 0; z < width; ++z)
             for (int y = 0; y < height; ++y)
@@ -22,44 +29,83 @@ Chunk::Chunk(const int cX, const int cZ): chunkCoord_({cX, 0, cZ}) {
 
 Chunk::~Chunk() {
     freeGPU();
+    MemoryStats::sub(MemoryStats::chunkBlocks, sizeof(blocks_));
+}
+
+Chunk::Mesh::~Mesh() {
+    if (numBytes > 0) MemoryStats::sub(MemoryStats::meshData, (int64_t)numBytes);
+    getGPUArena().cancel(stagedOpaque);
+    getGPUArena().cancel(stagedWater);
+    getDepthArena().cancel(stagedDepth);
 }
 
 void Chunk::buildMesh() {
-    printf("Chunk %d %d: Building Mesh\n", chunkCoord_.x, chunkCoord_.z);
-    genMeshData();
+    PROFILE_ZONE("Chunk::buildMesh");
+    LOG_DEBUG("Chunk", "%d %d: Building Mesh", chunkCoord_.x, chunkCoord_.z);
+    const std::shared_ptr<Mesh> mesh = std::make_shared<Mesh>();
+    genMeshData(*mesh);
+    mesh->numBytes = mesh->opaque.capacity() * sizeof(Vertex) + mesh->water.capacity() * sizeof(Vertex) +
+        mesh->depth.capacity() * sizeof(DepthVertex);
+    if (mesh->numBytes > 0) MemoryStats::add(MemoryStats::meshData, (int64_t)mesh->numBytes);
+    mesh->stagedOpaque = getGPUArena().stage(mesh->opaque.data(), mesh->opaque.size());
+    mesh->stagedWater = getGPUArena().stage(mesh->water.data(), mesh->water.size());
+    mesh->stagedDepth = getDepthArena().stage(mesh->depth.data(), mesh->depth.size());
+    mesh->version = ++nextMeshVersion_;
+    // A previous mesh the render thread never picked up is dropped here, cancelling its staged uploads
+    std::atomic_store(&latestMesh_, mesh);
     isDirty = false;
-    chunkInGPUSet.erase(chunkCoord_);
+}
+
+bool Chunk::needsUpload() const {
+    const std::shared_ptr<Mesh> mesh = std::atomic_load(&latestMesh_);
+    return mesh != nullptr && mesh != gpuMesh_;
 }
 
 void Chunk::sendToGPU() {
-    printf("Chunk %d %d: Sending to GPU\n", chunkCoord_.x, chunkCoord_.z);
-    sendToGPUHelper(&vaoOpaque_, &vboOpaque_, meshDataOpaque_);
-    sendToGPUHelper(&vaoWater_, &vboWater_, meshDataWater_);
-    chunkInGPUSet.insert(chunkCoord_);
+    PROFILE_ZONE("Chunk::sendToGPU");
+    const std::shared_ptr<Mesh> mesh = std::atomic_load(&latestMesh_);
+    if (mesh == nullptr || mesh == gpuMesh_) return;
+    LOG_DEBUG("Chunk", "%d %d: Sending to GPU", chunkCoord_.x, chunkCoord_.z);
+    sendToGPUHelper(getGPUArena(), &arenaFirstOpaque_, &mesh->stagedOpaque, mesh->opaque.data(), mesh->opaque.size(),
+                    gpuMesh_ ? gpuMesh_->opaque.size() : 0);
+    sendToGPUHelper(getGPUArena(), &arenaFirstWater_, &mesh->stagedWater, mesh->water.data(), mesh->water.size(),
+                    gpuMesh_ ? gpuMesh_->water.size() : 0);
+    sendToGPUHelper(getDepthArena(), &arenaFirstDepth_, &mesh->stagedDepth, mesh->depth.data(), mesh->depth.size(),
+                    gpuMesh_ ? gpuMesh_->depth.size() : 0);
+    gpuMesh_ = mesh;
 }
 
-void Chunk::renderOpaque() const {
-    if (vaoOpaque_ == 0 && meshDataOpaque_.empty()) return;
-    glBindVertexArray(vaoOpaque_);
-    glDrawArrays(GL_TRIANGLES, 0, (GLsizei)meshDataOpaque_.size());
-    glBindVertexArray(0);
+void Chunk::dropStagedMesh() {
+    const std::shared_ptr<Mesh> mesh = std::atomic_load(&latestMesh_);
+    if (mesh == nullptr || mesh == gpuMesh_) return;
+    getGPUArena().cancel(mesh->stagedOpaque);
+    getGPUArena().cancel(mesh->stagedWater);
+    getDepthArena().cancel(mesh->stagedDepth);
 }
 
-void Chunk::renderWater() const {
-    if (vaoWater_ == 0 && meshDataWater_.empty()) return;
-    glBindVertexArray(vaoWater_);
-    glDrawArrays(GL_TRIANGLES, 0, (GLsizei)meshDataWater_.size());
-    glBindVertexArray(0);
+void Chunk::appendDrawOpaque(std::vector<DrawArraysIndirectCommand>& commands, const section_mask sections) const {
+    if (gpuMesh_) appendDrawSections(commands, arenaFirstOpaque_, gpuMesh_->sectionOffsetOpaque, sections);
+}
+
+void Chunk::appendDrawWater(std::vector<DrawArraysIndirectCommand>& commands, const section_mask sections) const {
+    if (gpuMesh_) appendDrawSections(commands, arenaFirstWater_, gpuMesh_->sectionOffsetWater, sections);
+}
+
+void Chunk::appendDrawDepth(std::vector<DrawArraysIndirectCommand>& commands, const section_mask sections) const {
+    if (gpuMesh_) appendDrawSections(commands, arenaFirstDepth_, gpuMesh_->sectionOffsetOpaque, sections);
 }
 
 void Chunk::freeGPU() {
-    freeGPUHelper(&vaoOpaque_, &vboOpaque_);
-    freeGPUHelper(&vaoWater_, &vboWater_);
-    chunkInGPUSet.erase(chunkCoord_);
+    // Also true for chunks that never reached the GPU, which may be destroyed on any thread
+    if (!gpuMesh_) return;
+    freeGPUHelper(getGPUArena(), &arenaFirstOpaque_, gpuMesh_->opaque.size());
+    freeGPUHelper(getGPUArena(), &arenaFirstWater_, gpuMesh_->water.size());
+    freeGPUHelper(getDepthArena(), &arenaFirstDepth_, gpuMesh_->depth.size());
+    gpuMesh_.reset();
 }
 
 bool Chunk::isInGPU() const {
-    return chunkInGPUSet.find(chunkCoord_) != chunkInGPUSet.end();
+    return gpuMesh_ != nullptr;
 }
 
 bool Chunk::isCoordValid(const glm::ivec3& c) {
@@ -68,7 +114,7 @@ bool Chunk::isCoordValid(const glm::ivec3& c) {
 
 int16_t Chunk::getBlockId(const glm::ivec3& c) const {
     if (!isCoordValid(c)) {
-        printf("Error: Get invalid in-chunk coordinates (%d, %d, %d)\n", c.x, c.y, c.z);
+        LOG_ERROR("Chunk", "Get invalid in-chunk coordinates (%d, %d, %d)", c.x, c.y, c.z);
         return -1;
     }
     return blocks_[c.x][c.y][c.z];
@@ -76,7 +122,7 @@ int16_t Chunk::getBlockId(const glm::ivec3& c) const {
 
 int16_t Chunk::setBlockId(const glm::ivec3& c, const uint8_t blockId) {
     if (!isCoordValid(c)) {
-        printf("Error: Set invalid in-chunk coordinates (%d, %d, %d)\n", c.x, c.y, c.z);
+        LOG_ERROR("Chunk", "Set invalid in-chunk coordinates (%d, %d, %d)", c.x, c.y, c.z);
         return -1;
     }
     if (blocks_[c.x][c.y][c.z] == blockId) {
@@ -87,7 +133,169 @@ int16_t Chunk::setBlockId(const glm::ivec3& c, const uint8_t blockId) {
     return blockId;
 }
 
+void Chunk::serializeBlocks(std::vector<uint8_t>& out) const {
+    serializeLayers(0, height, out);
+}
+
+bool Chunk::deserializeBlocks(const uint8_t* data, const size_t size) {
+    if (!deserializeLayers(0, height, data, size, nullptr)) return false;
+    isDirty = true;
+    return true;
+}
+
+void Chunk::serializeDelta(const std::vector<uint16_t>& indices, std::vector<uint8_t>& out) const {
+    std::vector<uint8_t> list, runs, runData, layers, section;
+    for (size_t begin = 0; begin < indices.size();) {
+        // The indices of one section
+        const int s = indices[begin] >> 12;
+        size_t end = begin;
+        while (end < indices.size() && indices[end] >> 12 == s) ++end;
+
+        list.clear();
+        putU8(list, deltaList);
+        putVarint(list, static_cast<uint32_t>(end - begin));
+        for (size_t i = begin; i < end; ++i) {
+            putU16(list, indices[i]);
+            putU8(list, getBlockByIndex(indices[i]));
+        }
+        // Runs of consecutive indices with one id: rows along Z and whole layers of a fill
+        runs.clear();
+        runData.clear();
+        uint32_t numRuns = 0;
+        for (size_t i = begin; i < end;) {
+            const uint8_t id = getBlockByIndex(indices[i]);
+            size_t j = i + 1;
+            while (j < end && indices[j] == indices[j - 1] + 1 && getBlockByIndex(indices[j]) == id) ++j;
+            putU16(runData, indices[i]);
+            putVarint(runData, static_cast<uint32_t>(j - i));
+            putU8(runData, id);
+            ++numRuns;
+            i = j;
+        }
+        putU8(runs, deltaRuns);
+        putVarint(runs, numRuns);
+        runs.insert(runs.end(), runData.begin(), runData.end());
+        const std::vector<uint8_t>* best = runs.size() < list.size() ? &runs : &list;
+        // The whole section only pays off for bulk edits; a few blocks never beat the list
+        if (end - begin > 64) {
+            layers.clear();
+            serializeLayers(s * sectionHeight, (s + 1) * sectionHeight, layers);
+            section.clear();
+            putU8(section, deltaSection);
+            putU8(section, static_cast<uint8_t>(s));
+            putVarint(section, static_cast<uint32_t>(layers.size()));
+            section.insert(section.end(), layers.begin(), layers.end());
+            if (section.size() < best->size()) best = &section;
+        }
+        out.insert(out.end(), best->begin(), best->end());
+        begin = end;
+    }
+}
+
+bool Chunk::applyDelta(const uint8_t* data, const size_t size, uint8_t& changedBorders) {
+    changedBorders = 0;
+    ByteReader reader(data, size);
+    const auto set = [this, &changedBorders](const uint32_t index, const uint8_t id) {
+        const int x = index >> 4 & 15, y = index >> 8, z = index & 15;
+        if (blocks_[x][y][z] == id) return;
+        blocks_[x][y][z] = id;
+        isDirty = true;
+        changedBorders |= (x == 0 ? borderXNeg : 0) | (x == width - 1 ? borderXPos : 0) |
+            (z == 0 ? borderZNeg : 0) | (z == width - 1 ? borderZPos : 0);
+    };
+    while (!reader.isAtEnd()) {
+        const uint8_t kind = reader.getU8();
+        if (kind == deltaList) {
+            const uint32_t count = reader.getVarint();
+            for (uint32_t i = 0; i < count && reader.isValid(); ++i) {
+                const uint16_t index = reader.getU16();
+                const uint8_t id = reader.getU8();
+                if (reader.isValid()) set(index, id);
+            }
+        }
+        else if (kind == deltaRuns) {
+            const uint32_t count = reader.getVarint();
+            for (uint32_t i = 0; i < count && reader.isValid(); ++i) {
+                const uint32_t start = reader.getU16();
+                const uint32_t length = reader.getVarint();
+                const uint8_t id = reader.getU8();
+                if (!reader.isValid() || start + length > blockBytes) return false;
+                for (uint32_t index = start; index < start + length; ++index) set(index, id);
+            }
+        }
+        else if (kind == deltaSection) {
+            const int s = reader.getU8();
+            const uint32_t length = reader.getVarint();
+            if (!reader.isValid() || s >= numSections || length > reader.getRemaining()) return false;
+            const uint8_t* layers = data + (size - reader.getRemaining());
+            if (!deserializeLayers(s * sectionHeight, (s + 1) * sectionHeight, layers, length, &changedBorders))
+                return false;
+            reader.skip(length);
+        }
+        else return false;
+        if (!reader.isValid()) return false;
+    }
+    return true;
+}
+
+void Chunk::serializeLayers(const int yBegin, const int yEnd, std::vector<uint8_t>& out) const {
+    uint8_t runId = blocks_[0][yBegin][0];
+    uint32_t runLength = 0;
+    for (int x = 0; x < width; ++x)
+        for (int z = 0; z < width; ++z)
+            for (int y = yBegin; y < yEnd; ++y) {
+                const uint8_t id = blocks_[x][y][z];
+                if (id == runId) {
+                    ++runLength;
+                    continue;
+                }
+                putVarint(out, runLength);
+                putU8(out, runId);
+                runId = id;
+                runLength = 1;
+            }
+    putVarint(out, runLength);
+    putU8(out, runId);
+}
+
+bool Chunk::deserializeLayers(const int yBegin, const int yEnd, const uint8_t* data, const size_t size,
+                              uint8_t* changedBorders) {
+    // Check the runs add up before touching a block
+    const size_t numLayerBlocks = static_cast<size_t>(width * width * (yEnd - yBegin));
+    ByteReader check(data, size);
+    size_t numBlocks = 0;
+    while (!check.isAtEnd() && check.isValid() && numBlocks <= numLayerBlocks) {
+        numBlocks += check.getVarint();
+        check.getU8();
+    }
+    if (!check.isValid() || numBlocks != numLayerBlocks) return false;
+
+    ByteReader reader(data, size);
+    uint32_t runLength = 0;
+    uint8_t runId = 0;
+    for (int x = 0; x < width; ++x)
+        for (int z = 0; z < width; ++z)
+            for (int y = yBegin; y < yEnd; ++y) {
+                while (runLength == 0) {
+                    runLength = reader.getVarint();
+                    runId = reader.getU8();
+                }
+                --runLength;
+                if (!changedBorders) {
+                    blocks_[x][y][z] = runId;
+                    continue;
+                }
+                if (blocks_[x][y][z] == runId) continue;
+                blocks_[x][y][z] = runId;
+                isDirty = true;
+                *changedBorders |= (x == 0 ? borderXNeg : 0) | (x == width - 1 ? borderXPos : 0) |
+                    (z == 0 ? borderZNeg : 0) | (z == width - 1 ? borderZPos : 0);
+            }
+    return true;
+}
+
 void Chunk::genTerrain(const int seed) {
+    PROFILE_ZONE("Chunk::genTerrain");
     const float altitudeSeaSurfaceF = 23.0f;
     for (int x = 0; x < width; x++)
         for (int z = 0; z < width; z++) {
@@ -130,12 +338,29 @@ void Chunk::genTerrain(const int seed) {
         }
 }
 
-size_t Chunk::getNumOfChunksInGPU() {
-    return chunkInGPUSet.size();
+ChunkBufferArena& Chunk::getGPUArena() {
+    // Never destroyed: chunks owned by static objects release their ranges during static destruction
+    static ChunkBufferArena* arena = new ChunkBufferArena(sizeof(Vertex), 1 << 20, setupVertexAttributes, 32 << 20);
+    return *arena;
+}
+
+ChunkBufferArena& Chunk::getDepthArena() {
+    static ChunkBufferArena* arena = new ChunkBufferArena(sizeof(DepthVertex), 1 << 20, setupDepthVertexAttributes,
+                                                          8 << 20);
+    return *arena;
 }
 
 size_t Chunk::getNumVertices() const {
-    return numVertices_;
+    return gpuMesh_ ? gpuMesh_->opaque.size() + gpuMesh_->water.size() : 0;
+}
+
+size_t Chunk::getNumBuiltVertices() const {
+    const std::shared_ptr<Mesh> mesh = std::atomic_load(&latestMesh_);
+    return mesh ? mesh->opaque.size() + mesh->water.size() : 0;
+}
+
+uint64_t Chunk::getMeshVersion() const {
+    return gpuMesh_ ? gpuMesh_->version : 0;
 }
 
 World* Chunk::getWorld() const {
@@ -146,6 +371,10 @@ void Chunk::bindWorld(World* ptr_world) {
     ptr_world_ = ptr_world;
 }
 
+const chunk_coord& Chunk::getChunkCoord() const {
+    return chunkCoord_;
+}
+
 glm::ivec3 Chunk::getCoordWorld(const glm::ivec3 coordLocal) const {
     return glm::ivec3{
         coordLocal.x + chunkCoord_.x * width,
@@ -154,69 +383,104 @@ glm::ivec3 Chunk::getCoordWorld(const glm::ivec3 coordLocal) const {
     };
 }
 
-/* Private members */
+glm::vec3 Chunk::getBoundsMin() const {
+    return glm::vec3{chunkCoord_.x * width, gpuMesh_ ? gpuMesh_->minY : 0, chunkCoord_.z * width};
+}
 
-void Chunk::genMeshData() {
-    meshDataOpaque_.clear();
-    meshDataWater_.clear();
+glm::vec3 Chunk::getBoundsMax() const {
+    return glm::vec3{(chunkCoord_.x + 1) * width, gpuMesh_ ? gpuMesh_->maxY : 0, (chunkCoord_.z + 1) * width};
+}
 
-    for (int x = 0; x < width; ++x)
-        for (int z = 0; z < width; ++z)
-            for (int y = 0; y < height; ++y) {
-                const uint8_t blockId = blocks_[x][y][z];
-                if (blockId == 0) continue; // Skip air blocks
-                const int bidXPos = ptr_world_->getBlockId(getCoordWorld({x + 1, y, z}));
-                const int bidYPos = ptr_world_->getBlockId(getCoordWorld({x, y + 1, z}));
-                const int bidZPos = ptr_world_->getBlockId(getCoordWorld({x, y, z + 1}));
-                const int bidXNeg = ptr_world_->getBlockId(getCoordWorld({x - 1, y, z}));
-                const int bidYNeg = ptr_world_->getBlockId(getCoordWorld({x, y - 1, z}));
-                const int bidZNeg = ptr_world_->getBlockId(getCoordWorld({x, y, z - 1}));
-                if (blockId == 10) {
-                    // Water block
-                    // TODO: If it is water surface, shrink height to pre-set value
-                    if (bidXPos != 10)
-                        genQuadData(meshDataWater_, Quad::unit_x_pos, blockId, x, y, z); // X+ face exposed
-                    if (bidYPos != 10)
-                        genQuadData(meshDataWater_, Quad::unit_y_pos, blockId, x, y, z); // Y+ face exposed
-                    if (bidZPos != 10)
-                        genQuadData(meshDataWater_, Quad::unit_z_pos, blockId, x, y, z); // Z+ face exposed
-                    if (bidXNeg != 10)
-                        genQuadData(meshDataWater_, Quad::unit_x_neg, blockId, x, y, z); // X- face exposed
-                    if (bidYNeg != 10)
-                        genQuadData(meshDataWater_, Quad::unit_y_neg, blockId, x, y, z); // Y- face exposed
-                    if (bidZNeg != 10)
-                        genQuadData(meshDataWater_, Quad::unit_z_neg, blockId, x, y, z); // Z- face exposed
-                }
-                else {
-                    // Opaque block
-                    if (x != 0 && x != width - 1 &&
-                        y != 0 && y != height - 1 &&
-                        z != 0 && z != width - 1 &&
-                        isBlockOpaque(bidXPos) && isBlockOpaque(bidXNeg) &&
-                        isBlockOpaque(bidYPos) && isBlockOpaque(bidYNeg) &&
-                        isBlockOpaque(bidZPos) && isBlockOpaque(bidZNeg))
-                        continue; // Skip fully covered blocks
-                    if (!isBlockOpaque(bidXPos))
-                        genQuadData(meshDataOpaque_, Quad::unit_x_pos, blockId, x, y, z); // X+ face exposed
-                    if (!isBlockOpaque(bidYPos))
-                        genQuadData(meshDataOpaque_, Quad::unit_y_pos, blockId, x, y, z); // Y+ face exposed
-                    if (!isBlockOpaque(bidZPos))
-                        genQuadData(meshDataOpaque_, Quad::unit_z_pos, blockId, x, y, z); // Z+ face exposed
-                    if (!isBlockOpaque(bidXNeg))
-                        genQuadData(meshDataOpaque_, Quad::unit_x_neg, blockId, x, y, z); // X- face exposed
-                    if (!isBlockOpaque(bidYNeg))
-                        genQuadData(meshDataOpaque_, Quad::unit_y_neg, blockId, x, y, z); // Y- face exposed
-                    if (!isBlockOpaque(bidZNeg))
-                        genQuadData(meshDataOpaque_, Quad::unit_z_neg, blockId, x, y, z); // Z- face exposed}
+const SectionVisibility& Chunk::getSectionVisibility(const int section) const {
+    static const SectionVisibility noMesh{};
+    return gpuMesh_ ? gpuMesh_->sectionVisibility[section] : noMesh;
+}
+
+bool Chunk::isSectionEmpty(const int section) const {
+    if (!gpuMesh_) return true;
+    return gpuMesh_->sectionOffsetOpaque[section] == gpuMesh_->sectionOffsetOpaque[section + 1] &&
+        gpuMesh_->sectionOffsetWater[section] == gpuMesh_->sectionOffsetWater[section + 1];
+}
+
+/* Private members */
+
+void Chunk::genMeshData(Mesh& mesh) const {
+    PROFILE_ZONE("Chunk::genMeshData");
+    mesh.minY = height;
+    mesh.maxY = 0;
+
+    // Mesh section by section so each section's vertices are contiguous and can be drawn on their own
+    for (int section = 0; section < numSections; ++section) {
+        mesh.sectionOffsetOpaque[section] = mesh.opaque.size();
+        mesh.sectionOffsetWater[section] = mesh.water.size();
+        mesh.sectionVisibility[section] = computeSectionVisibility(section);
+        for (int x = 0; x < width; ++x)
+            for (int z = 0; z < width; ++z)
+                for (int y = section * sectionHeight; y < (section + 1) * sectionHeight; ++y) {
+                    const uint8_t blockId = blocks_[x][y][z];
+                    if (blockId == 0) continue; // Skip air blocks
+                    const int bidXPos = ptr_world_->getBlockId(getCoordWorld({x + 1, y, z}));
+                    const int bidYPos = ptr_world_->getBlockId(getCoordWorld({x, y + 1, z}));
+                    const int bidZPos = ptr_world_->getBlockId(getCoordWorld({x, y, z + 1}));
+                    const int bidXNeg = ptr_world_->getBlockId(getCoordWorld({x - 1, y, z}));
+                    const int bidYNeg = ptr_world_->getBlockId(getCoordWorld({x, y - 1, z}));
+                    const int bidZNeg = ptr_world_->getBlockId(getCoordWorld({x, y, z - 1}));
+                    if (blockId == 10) {
+                        // Water block
+                        // TODO: If it is water surface, shrink height to pre-set value
+                        if (bidXPos != 10)
+                            genQuadData(mesh, mesh.water, Quad::unit_x_pos, blockId, x, y, z); // X+ face exposed
+                        if (bidYPos != 10)
+                            genQuadData(mesh, mesh.water, Quad::unit_y_pos, blockId, x, y, z); // Y+ face exposed
+                        if (bidZPos != 10)
+                            genQuadData(mesh, mesh.water, Quad::unit_z_pos, blockId, x, y, z); // Z+ face exposed
+                        if (bidXNeg != 10)
+                            genQuadData(mesh, mesh.water, Quad::unit_x_neg, blockId, x, y, z); // X- face exposed
+                        if (bidYNeg != 10)
+                            genQuadData(mesh, mesh.water, Quad::unit_y_neg, blockId, x, y, z); // Y- face exposed
+                        if (bidZNeg != 10)
+                            genQuadData(mesh, mesh.water, Quad::unit_z_neg, blockId, x, y, z); // Z- face exposed
+                    }
+                    else {
+                        // Opaque block
+                        if (x != 0 && x != width - 1 &&
+                            y != 0 && y != height - 1 &&
+                            z != 0 && z != width - 1 &&
+                            isBlockOpaque(bidXPos) && isBlockOpaque(bidXNeg) &&
+                            isBlockOpaque(bidYPos) && isBlockOpaque(bidYNeg) &&
+                            isBlockOpaque(bidZPos) && isBlockOpaque(bidZNeg))
+                            continue; // Skip fully covered blocks
+                        if (!isBlockOpaque(bidXPos))
+                            genQuadData(mesh, mesh.opaque, Quad::unit_x_pos, blockId, x, y, z); // X+ face exposed
+                        if (!isBlockOpaque(bidYPos))
+                            genQuadData(mesh, mesh.opaque, Quad::unit_y_pos, blockId, x, y, z); // Y+ face exposed
+                        if (!isBlockOpaque(bidZPos))
+                            genQuadData(mesh, mesh.opaque, Quad::unit_z_pos, blockId, x, y, z); // Z+ face exposed
+                        if (!isBlockOpaque(bidXNeg))
+                            genQuadData(mesh, mesh.opaque, Quad::unit_x_neg, blockId, x, y, z); // X- face exposed
+                        if (!isBlockOpaque(bidYNeg))
+                            genQuadData(mesh, mesh.opaque, Quad::unit_y_neg, blockId, x, y, z); // Y- face exposed
+                        if (!isBlockOpaque(bidZNeg))
+                            genQuadData(mesh, mesh.opaque, Quad::unit_z_neg, blockId, x, y, z); // Z- face exposed}
+                    }
                 }
-            }
+    }
+    mesh.sectionOffsetOpaque[numSections] = mesh.opaque.size();
+    mesh.sectionOffsetWater[numSections] = mesh.water.size();
+
+    if (mesh.opaque.empty() && mesh.water.empty()) mesh.minY = mesh.maxY = 0;
 
-    numVertices_ = meshDataOpaque_.size() + meshDataWater_.size();
+    // Depth stream: same vertex order, so section offsets and draw ranges are shared with the opaque mesh
+    mesh.depth.resize(mesh.opaque.size());
+    for (size_t i = 0; i < mesh.opaque.size(); ++i)
+        mesh.depth[i] = DepthVertex{mesh.opaque[i].x, mesh.opaque[i].y, mesh.opaque[i].z};
 }
 
-void Chunk::genQuadData(std::vector<Vertex>& meshData, const float* vertices, const uint8_t blockId,
-                        const int x, const int y, const int z) {
+void Chunk::genQuadData(Mesh& mesh, std::vector<Vertex>& meshData, const float* vertices, const uint8_t blockId,
+                        const int x, const int y, const int z) const {
     static const size_t indices[6] = {0, 1, 2, 2, 1, 3}; // Indices for two triangles forming a quad
+    if (y < mesh.minY) mesh.minY = y;
+    if (y + 1 > mesh.maxY) mesh.maxY = y + 1;
     for (const size_t idx : indices) {
         meshData.emplace_back(
             vertices[idx * 8 + 0] + (float)x + (float)chunkCoord_.x * width,
@@ -241,17 +505,46 @@ bool Chunk::isBlockOpaque(const int x, const int y, const int z) const {
     return isBlockOpaque(blockId);
 }
 
-void Chunk::sendToGPUHelper(glm::uint* vao, glm::uint* vbo, const std::vector<Vertex>& meshData) {
-    if (*vao == 0)
-        glGenVertexArrays(1, vao);
-    if (*vbo == 0)
-        glGenBuffers(1, vbo);
+SectionVisibility Chunk::computeSectionVisibility(const int section) const {
+    uint8_t opaque[SectionVisibility::numVoxels];
+    const int yBase = section * sectionHeight;
+    for (int y = 0; y < sectionHeight; ++y)
+        for (int z = 0; z < width; ++z)
+            for (int x = 0; x < width; ++x)
+                opaque[(y * sectionHeight + z) * width + x] = isBlockOpaque(x, yBase + y, z);
+    return SectionVisibility::compute(opaque);
+}
 
-    glBindVertexArray(*vao);
-    glBindBuffer(GL_ARRAY_BUFFER, *vbo);
+void Chunk::appendDrawSections(std::vector<DrawArraysIndirectCommand>& commands, const size_t arenaFirst,
+                               const size_t* sectionOffsets, const section_mask sections) {
+    if (arenaFirst == ChunkBufferArena::invalidOffset) return;
+    int section = 0;
+    while (section < numSections) {
+        if ((sections >> section & 1) == 0) {
+            ++section;
+            continue;
+        }
+        const size_t first = sectionOffsets[section];
+        while (section < numSections && (sections >> section & 1) != 0) ++section;
+        const size_t last = sectionOffsets[section];
+        if (last > first)
+            commands.push_back(DrawArraysIndirectCommand{
+                static_cast<uint32_t>(last - first), 1, static_cast<uint32_t>(arenaFirst + first), 0
+            });
+    }
+}
 
-    glBufferData(GL_ARRAY_BUFFER, meshData.size() * sizeof(Vertex), meshData.data(), GL_STATIC_DRAW);
+void Chunk::sendToGPUHelper(ChunkBufferArena& arena, size_t* arenaFirst, ChunkBufferArena::StagedUpload* staged,
+                            const void* meshData, const size_t numVertices, const size_t numVerticesReplaced) {
+    if (*arenaFirst != ChunkBufferArena::invalidOffset)
+        MemoryStats::sub(MemoryStats::gpuChunkMeshes, (int64_t)(numVerticesReplaced * arena.getVertexStride()));
+    arena.release(*arenaFirst);
+    *arenaFirst = staged->isValid() ? arena.commit(*staged) : arena.upload(meshData, numVertices);
+    if (*arenaFirst != ChunkBufferArena::invalidOffset)
+        MemoryStats::add(MemoryStats::gpuChunkMeshes, (int64_t)(numVertices * arena.getVertexStride()));
+}
 
+void Chunk::setupVertexAttributes() {
     // Set the vertex attributes pointers
     /// vec3 vertex's Position
     glEnableVertexAttribArray(0);
@@ -265,17 +558,17 @@ void Chunk::sendToGPUHelper(glm::uint* vao, glm::uint* vbo, const std::vector<Ve
     /// float vertex's Block Id
     glEnableVertexAttribArray(3);
     glVertexAttribPointer(3, 1, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, id));
+}
 
-    glBindVertexArray(0);
+void Chunk::setupDepthVertexAttributes() {
+    /// vec3 vertex's Position
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(DepthVertex), (void*)offsetof(DepthVertex, x));
 }
 
-void Chunk::freeGPUHelper(glm::uint* vao, glm::uint* vbo) {
-    if (*vbo != 0) {
-        glDeleteBuffers(1, vbo);
-        *vbo = 0;
-    }
-    if (*vao != 0) {
-        glDeleteVertexArrays(1, vao);
-        *vao = 0;
-    }
+void Chunk::freeGPUHelper(ChunkBufferArena& arena, size_t* arenaFirst, const size_t numVertices) {
+    if (*arenaFirst != ChunkBufferArena::invalidOffset)
+        MemoryStats::sub(MemoryStats::gpuChunkMeshes, (int64_t)(numVertices * arena.getVertexStride()));
+    arena.release(*arenaFirst);
+    *arenaFirst = ChunkBufferArena::invalidOffset;
 }
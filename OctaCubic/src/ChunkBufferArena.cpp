@@ -0,0 +1,145 @@
+﻿#include "ChunkBufferArena.h"
+
+#include <cstring>
+#include <glad/glad.h>
+
+#include "Log.h"
+#include "MemoryStats.h"
+
+using namespace OctaCubic;
+
+constexpr size_t ChunkBufferArena::invalidOffset;
+
+ChunkBufferArena::ChunkBufferArena(const size_t vertexStride, const size_t initialCapacity,
+                                   const AttributeSetup setupAttributes, const size_t uploadRingBytes)
+    : vertexStride_(vertexStride), setupAttributes_(setupAttributes), allocator_(initialCapacity),
+      uploadRing_(uploadRingBytes) {}
+
+ChunkBufferArena::StagedUpload ChunkBufferArena::stage(const void* vertices, const size_t numVertices) {
+    StagedUpload staged;
+    if (numVertices == 0) return staged;
+    staged.allocation = uploadRing_.tryAllocate(numVertices * vertexStride_);
+    if (!staged.isValid()) return staged;
+    memcpy(staged.allocation.data, vertices, numVertices * vertexStride_);
+    staged.numVertices = numVertices;
+    return staged;
+}
+
+size_t ChunkBufferArena::commit(StagedUpload& staged) {
+    if (!staged.isValid()) return invalidOffset;
+    const size_t first = allocate(staged.numVertices);
+    uploadRing_.copyTo(staged.allocation, vbo_, first * vertexStride_);
+    staged = StagedUpload{};
+    return first;
+}
+
+void ChunkBufferArena::cancel(StagedUpload& staged) {
+    uploadRing_.cancel(staged.allocation);
+    staged = StagedUpload{};
+}
+
+size_t ChunkBufferArena::upload(const void* vertices, const size_t numVertices) {
+    if (numVertices == 0) return invalidOffset;
+    if (vao_ == 0) initGPU();
+    StagedUpload staged;
+    staged.allocation = uploadRing_.allocate(numVertices * vertexStride_);
+    if (staged.isValid()) {
+        memcpy(staged.allocation.data, vertices, numVertices * vertexStride_);
+        staged.numVertices = numVertices;
+        return commit(staged);
+    }
+    // The mesh does not fit in the ring at all, or the ring is held by staged uploads
+    const size_t first = allocate(numVertices);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo_);
+    glBufferSubData(GL_ARRAY_BUFFER, (GLintptr)(first * vertexStride_), (GLsizeiptr)(numVertices * vertexStride_),
+                    vertices);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    return first;
+}
+
+void ChunkBufferArena::release(const size_t first) {
+    if (first == invalidOffset) return;
+    allocator_.free(first);
+}
+
+void ChunkBufferArena::drawIndirect(const std::vector<DrawArraysIndirectCommand>& commands) {
+    if (commands.empty() || vao_ == 0) return;
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer_);
+    if (commands.size() > indirectCapacity_) indirectCapacity_ = commands.size() * 2;
+    // Orphan the previous pass' commands instead of waiting for the GPU to finish with them
+    glBufferData(GL_DRAW_INDIRECT_BUFFER, (GLsizeiptr)(indirectCapacity_ * sizeof(DrawArraysIndirectCommand)),
+                 nullptr, GL_STREAM_DRAW);
+    glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, (GLsizeiptr)(commands.size() * sizeof(DrawArraysIndirectCommand)),
+                    commands.data());
+
+    glBindVertexArray(vao_);
+    glMultiDrawArraysIndirect(GL_TRIANGLES, nullptr, (GLsizei)commands.size(), 0);
+    glBindVertexArray(0);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    numDrawCalls_++;
+    numDrawCommands_ += commands.size();
+}
+
+void ChunkBufferArena::flushUploads() {
+    if (vao_ == 0) initGPU();
+    uploadRing_.endFrame();
+}
+
+void ChunkBufferArena::resetDrawStats() {
+    numDrawCalls_ = 0;
+    numDrawCommands_ = 0;
+}
+
+void ChunkBufferArena::initGPU() {
+    glGenVertexArrays(1, &vao_);
+    glGenBuffers(1, &vbo_);
+    glGenBuffers(1, &indirectBuffer_);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo_);
+    glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)(allocator_.getCapacity() * vertexStride_), nullptr, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    MemoryStats::add(MemoryStats::gpuChunkArenas, (int64_t)(allocator_.getCapacity() * vertexStride_));
+    bindVertexBuffer();
+    uploadRing_.initGPU();
+}
+
+void ChunkBufferArena::grow(const size_t minCapacity) {
+    size_t newCapacity = allocator_.getCapacity() > 0 ? allocator_.getCapacity() : 1;
+    while (newCapacity < minCapacity) newCapacity *= 2;
+    LOG_INFO("ChunkBufferArena", "Growing to %zu vertices", newCapacity);
+
+    // Move the existing meshes into a bigger buffer; offsets stay valid
+    glm::uint newVbo = 0;
+    glGenBuffers(1, &newVbo);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, newVbo);
+    glBufferData(GL_COPY_WRITE_BUFFER, (GLsizeiptr)(newCapacity * vertexStride_), nullptr, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_COPY_READ_BUFFER, vbo_);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0,
+                        (GLsizeiptr)(allocator_.getCapacity() * vertexStride_));
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    glDeleteBuffers(1, &vbo_);
+    vbo_ = newVbo;
+    MemoryStats::resize(MemoryStats::gpuChunkArenas, (int64_t)(allocator_.getCapacity() * vertexStride_),
+                        (int64_t)(newCapacity * vertexStride_));
+
+    allocator_.grow(newCapacity);
+    bindVertexBuffer();
+}
+
+size_t ChunkBufferArena::allocate(const size_t numVertices) {
+    if (vao_ == 0) initGPU();
+    size_t first = allocator_.allocate(numVertices);
+    if (first == invalidOffset) {
+        grow(allocator_.getCapacity() + numVertices);
+        first = allocator_.allocate(numVertices);
+    }
+    return first;
+}
+
+void ChunkBufferArena::bindVertexBuffer() const {
+    glBindVertexArray(vao_);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo_);
+    setupAttributes_();
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
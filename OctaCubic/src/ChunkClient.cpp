@@ -0,0 +1,97 @@
+﻿#include "ChunkClient.h"
+
+#include <chrono>
+#include <thread>
+
+#include "ByteStream.h"
+#include "Log.h"
+#include "Profiler.h"
+
+namespace OctaCubic
+{
+    bool ChunkClient::connect(const char* host, const uint16_t port, const int viewDistance,
+                              const double timeoutSeconds) {
+        Socket socket;
+        if (!Socket::startup() || !socket.connect(host, port)) return false;
+        connection_ = NetConnection(std::move(socket));
+        hasSentPosition_ = false;
+        isDisconnectLogged_ = false;
+        std::vector<uint8_t>& out = connection_.beginMessage(NetMessage::hello);
+        putU32(out, NetMessage::protocolVersion);
+        putU8(out, static_cast<uint8_t>(viewDistance));
+        connection_.endMessage();
+
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::duration<double>(timeoutSeconds);
+        while (connection_.flush()) {
+            if (connection_.poll(message_)) {
+                ByteReader reader(message_.payload);
+                seed_ = reader.getI32();
+                viewDistance_ = reader.getU8();
+                if (message_.type != NetMessage::welcome || !reader.isValid()) break;
+                LOG_INFO("ChunkClient", "Connected to %s:%d, seed %d, view distance %d", host, (int)port, seed_,
+                         viewDistance_);
+                return true;
+            }
+            if (std::chrono::steady_clock::now() > deadline) break;
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        LOG_ERROR("ChunkClient", "No welcome from %s:%d", host, (int)port);
+        connection_.close();
+        return false;
+    }
+
+    bool ChunkClient::update(World& world, const glm::vec3 position) {
+        PROFILE_ZONE("ChunkClient::update");
+        while (connection_.poll(message_)) {
+            if (message_.type != NetMessage::chunkData && message_.type != NetMessage::blockDelta) continue;
+            ByteReader reader(message_.payload);
+            const int x = reader.getI32();
+            const int z = reader.getI32();
+            const chunk_coord c{x, 0, z};
+            const uint8_t* data = message_.payload.data() + (message_.payload.size() - reader.getRemaining());
+            if (!reader.isValid()) continue;
+            if (message_.type == NetMessage::chunkData) {
+                ++numChunksReceived_;
+                if (world.loadChunk(c, data, reader.getRemaining())) chunksReceived_.insert(c);
+                else {
+                    ++numRejected_;
+                    LOG_ERROR("ChunkClient", "Corrupt data for chunk %d %d", c.x, c.z);
+                }
+            }
+            else {
+                ++numDeltasReceived_;
+                if (!world.applyChunkDelta(c, data, reader.getRemaining())) {
+                    ++numRejected_;
+                    LOG_ERROR("ChunkClient", "Corrupt delta for chunk %d %d", c.x, c.z);
+                }
+            }
+        }
+
+        const chunk_coord center = World::getCoordChunk(position);
+        if (!hasSentPosition_ || center != lastCenter_) {
+            std::vector<uint8_t>& out = connection_.beginMessage(NetMessage::position);
+            putF32(out, position.x);
+            putF32(out, position.y);
+            putF32(out, position.z);
+            connection_.endMessage();
+            lastCenter_ = center;
+            hasSentPosition_ = true;
+        }
+        for (const BlockEdit& edit : editLog_) {
+            std::vector<uint8_t>& out = connection_.beginMessage(NetMessage::blockEdit);
+            putI32(out, edit.coordWorld.x);
+            putI32(out, edit.coordWorld.y);
+            putI32(out, edit.coordWorld.z);
+            putU8(out, edit.blockId);
+            connection_.endMessage();
+        }
+        editLog_.clear();
+        if (connection_.flush()) return true;
+        if (!isDisconnectLogged_) {
+            LOG_WARNING("ChunkClient", "Disconnected after %llu chunks",
+                        static_cast<unsigned long long>(numChunksReceived_));
+            isDisconnectLogged_ = true;
+        }
+        return false;
+    }
+}
@@ -0,0 +1,200 @@
+﻿#include "ChunkServer.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+#include "ByteStream.h"
+#include "Log.h"
+#include "Profiler.h"
+
+namespace OctaCubic
+{
+    constexpr size_t ChunkServer::maxPendingBytes;
+
+    ChunkServer::ChunkServer(World& world, const int maxViewDistance)
+        : world_(world), maxViewDistance_(maxViewDistance) {
+        world_.setEditLog(&editLog_);
+    }
+
+    ChunkServer::~ChunkServer() {
+        world_.setEditLog(nullptr);
+    }
+
+    bool ChunkServer::listen(const char* address, const uint16_t port) {
+        if (!listener_.listen(address, port)) return false;
+        LOG_INFO("ChunkServer", "Listening on %s:%d", address, (int)getPort());
+        return true;
+    }
+
+    ChunkServer::Stats ChunkServer::getStats() const {
+        Stats stats = stats_;
+        for (const auto& client : clients_) {
+            stats.numBytesSent += client->connection.getNumBytesSent();
+            stats.numBytesReceived += client->connection.getNumBytesReceived();
+        }
+        return stats;
+    }
+
+    void ChunkServer::update() {
+        PROFILE_ZONE("ChunkServer::update");
+        for (Socket socket = listener_.accept(); socket.isValid(); socket = listener_.accept()) {
+            clients_.emplace_back(new Client);
+            clients_.back()->connection = NetConnection(std::move(socket));
+            LOG_INFO("ChunkServer", "Client connected, %d now", (int)clients_.size());
+        }
+
+        for (const auto& client : clients_) receive(*client);
+        // Changes go out before new chunks, which include them already; nor are they stuck behind a backlog
+        sendDeltas();
+
+        for (const auto& client : clients_) {
+            while (!client->chunksToSend.empty() && client->connection.getNumPendingBytes() < maxPendingBytes) {
+                const chunk_coord c = client->chunksToSend.back();
+                client->chunksToSend.pop_back();
+                if (!client->chunksSent.insert(c).second) continue;
+                subscribers_[c].push_back(client.get());
+                sendChunk(*client, c);
+            }
+            client->connection.flush();
+        }
+
+        for (auto it = clients_.begin(); it != clients_.end();) {
+            if ((*it)->connection.isOpen()) {
+                ++it;
+                continue;
+            }
+            stats_.numBytesSent += (*it)->connection.getNumBytesSent();
+            stats_.numBytesReceived += (*it)->connection.getNumBytesReceived();
+            Client& client = **it;
+            for (const chunk_coord& c : client.chunksSent) unsubscribe(client, c);
+            it = clients_.erase(it);
+            LOG_INFO("ChunkServer", "Client disconnected, %d left", (int)clients_.size());
+        }
+    }
+
+    void ChunkServer::receive(Client& client) {
+        while (client.connection.poll(message_)) {
+            ByteReader reader(message_.payload);
+            if (message_.type == NetMessage::hello) {
+                const uint32_t version = reader.getU32();
+                const int viewDistance = reader.getU8();
+                if (!reader.isValid() || version != NetMessage::protocolVersion) {
+                    LOG_WARNING("ChunkServer", "Client speaks protocol %u, not %u", version,
+                                NetMessage::protocolVersion);
+                    client.connection.close();
+                    return;
+                }
+                client.viewDistance = std::max(1, std::min(viewDistance, maxViewDistance_));
+                client.isWelcomed = true;
+                std::vector<uint8_t>& out = client.connection.beginMessage(NetMessage::welcome);
+                putI32(out, world_.getSeed());
+                putU8(out, static_cast<uint8_t>(client.viewDistance));
+                client.connection.endMessage();
+            }
+            else if (!client.isWelcomed) {
+                LOG_WARNING("ChunkServer", "Client sent message %d before hello", (int)message_.type);
+                client.connection.close();
+                return;
+            }
+            else if (message_.type == NetMessage::position) {
+                glm::vec3 position;
+                position.x = reader.getF32();
+                position.y = reader.getF32();
+                position.z = reader.getF32();
+                if (reader.isValid()) setCenter(client, World::getCoordChunk(position));
+            }
+            else if (message_.type == NetMessage::blockEdit) {
+                glm::ivec3 coord;
+                coord.x = reader.getI32();
+                coord.y = reader.getI32();
+                coord.z = reader.getI32();
+                const uint8_t blockId = reader.getU8();
+                // The change reaches every client with the chunk, the sender too, through the edit log
+                if (reader.isValid() && world_.setBlockId(coord, blockId) >= 0) ++stats_.numEdits;
+            }
+        }
+    }
+
+    void ChunkServer::sendDeltas() {
+        if (editLog_.empty()) return;
+        changedBlocks_.clear();
+        for (const BlockEdit& edit : editLog_) {
+            changedBlocks_[World::getCoordChunk(edit.coordWorld)].push_back(
+                Chunk::getBlockIndex(World::getCoordLocalToChunk(edit.coordWorld)));
+        }
+        editLog_.clear();
+
+        for (auto& changed : changedBlocks_) {
+            std::vector<uint16_t>& indices = changed.second;
+            const auto subscribers = subscribers_.find(changed.first);
+            if (subscribers == subscribers_.end()) continue;
+            // A block changed twice is sent once, as it is now
+            std::sort(indices.begin(), indices.end());
+            indices.erase(std::unique(indices.begin(), indices.end()), indices.end());
+            stats_.numBlocksChanged += indices.size();
+            delta_.clear();
+            world_.serializeChunkDelta(changed.first, indices, delta_);
+            for (Client* client : subscribers->second) {
+                std::vector<uint8_t>& out = client->connection.beginMessage(NetMessage::blockDelta);
+                putI32(out, changed.first.x);
+                putI32(out, changed.first.z);
+                out.insert(out.end(), delta_.begin(), delta_.end());
+                client->connection.endMessage();
+                ++stats_.numDeltasSent;
+                stats_.numDeltaBytes += delta_.size();
+            }
+        }
+    }
+
+    void ChunkServer::setCenter(Client& client, const chunk_coord center) {
+        if (client.hasCenter && center == client.center) return;
+        client.center = center;
+        client.hasCenter = true;
+        world_.generateChunks(center, client.viewDistance);
+        const int distance = client.viewDistance;
+        // Chunks out of view get no more deltas; they are sent whole if they come back
+        for (auto it = client.chunksSent.begin(); it != client.chunksSent.end();) {
+            const chunk_coord c = *it;
+            if (std::abs(c.x - center.x) <= distance && std::abs(c.z - center.z) <= distance) {
+                ++it;
+                continue;
+            }
+            it = client.chunksSent.erase(it);
+            unsubscribe(client, c);
+        }
+        // Whatever is still queued from the old center is reconsidered along with the new view
+        client.chunksToSend.clear();
+        for (int x = center.x - distance; x <= center.x + distance; ++x)
+            for (int z = center.z - distance; z <= center.z + distance; ++z)
+                if (!client.chunksSent.count(chunk_coord{x, 0, z})) client.chunksToSend.push_back({x, 0, z});
+        const auto distanceSquared = [center](const chunk_coord& c) {
+            return (c.x - center.x) * (c.x - center.x) + (c.z - center.z) * (c.z - center.z);
+        };
+        std::sort(client.chunksToSend.begin(), client.chunksToSend.end(),
+                  [&](const chunk_coord& a, const chunk_coord& b) { return distanceSquared(a) > distanceSquared(b); });
+    }
+
+    void ChunkServer::unsubscribe(Client& client, const chunk_coord c) {
+        const auto it = subscribers_.find(c);
+        if (it == subscribers_.end()) return;
+        std::vector<Client*>& clients = it->second;
+        for (size_t i = 0; i < clients.size(); ++i) {
+            if (clients[i] != &client) continue;
+            clients[i] = clients.back();
+            clients.pop_back();
+            break;
+        }
+        if (clients.empty()) subscribers_.erase(it);
+    }
+
+    void ChunkServer::sendChunk(Client& client, const chunk_coord c) {
+        std::vector<uint8_t>& out = client.connection.beginMessage(NetMessage::chunkData);
+        putI32(out, c.x);
+        putI32(out, c.z);
+        const size_t blocksStart = out.size();
+        world_.serializeChunk(c, out);
+        stats_.numChunkBytes += out.size() - blocksStart;
+        ++stats_.numChunksSent;
+        client.connection.endMessage();
+    }
+}
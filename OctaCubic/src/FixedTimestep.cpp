@@ -0,0 +1,31 @@
+﻿#include "FixedTimestep.h"
+
+#include <algorithm>
+
+namespace OctaCubic
+{
+    FixedTimestep::FixedTimestep(const double tickRate, const int maxTicksPerFrame)
+        : tickSeconds_(1.0 / tickRate), maxTicksPerFrame_(maxTicksPerFrame) {}
+
+    int FixedTimestep::advance(const double now) {
+        if (!isStarted_) {
+            isStarted_ = true;
+            lastTime_ = now;
+            return 0;
+        }
+        accumulator_ += std::max(now - lastTime_, 0.0);
+        lastTime_ = now;
+        int ticks = (int)(accumulator_ / tickSeconds_);
+        accumulator_ -= ticks * tickSeconds_;
+        if (ticks > maxTicksPerFrame_) {
+            droppedTicks_ += ticks - maxTicksPerFrame_;
+            ticks = maxTicksPerFrame_;
+        }
+        tickCount_ += ticks;
+        return ticks;
+    }
+
+    float FixedTimestep::getAlpha() const {
+        return (float)std::min(accumulator_ / tickSeconds_, 1.0);
+    }
+}
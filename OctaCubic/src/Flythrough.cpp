@@ -0,0 +1,202 @@
+﻿#include "Flythrough.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+#include "Log.h"
+
+namespace OctaCubic
+{
+    namespace
+    {
+        // Paths and renderer names may hold quotes or Windows separators
+        std::string escapeJson(const std::string& text) {
+            std::string escaped;
+            for (const char c : text) {
+                if (c == '"' || c == '\\') escaped += '\\';
+                escaped += c;
+            }
+            return escaped;
+        }
+
+        struct Distribution {
+            double mean = 0;
+            double p50 = 0;
+            double p95 = 0;
+            double p99 = 0;
+            double max = 0;
+        };
+
+        Distribution getDistribution(std::vector<double> values) {
+            Distribution d;
+            if (values.empty()) return d;
+            std::sort(values.begin(), values.end());
+            for (const double v : values) d.mean += v;
+            d.mean /= (double)values.size();
+            const auto at = [&values](const double q) { return values[(size_t)(q * (double)(values.size() - 1))]; };
+            d.p50 = at(0.50);
+            d.p95 = at(0.95);
+            d.p99 = at(0.99);
+            d.max = values.back();
+            return d;
+        }
+
+        void writeDistribution(FILE* file, const char* name, const std::vector<double>& values, const bool isLast) {
+            const Distribution d = getDistribution(values);
+            fprintf(file, "    \"%s\": {\"mean\": %.4f, \"p50\": %.4f, \"p95\": %.4f, \"p99\": %.4f, \"max\": %.4f}%s\n",
+                    name, d.mean, d.p50, d.p95, d.p99, d.max, isLast ? "" : ",");
+        }
+    }
+
+    bool Flythrough::load(const std::string& path) {
+        std::ifstream file(path);
+        if (!file) {
+            LOG_ERROR("Flythrough", "Could not open %s", path.c_str());
+            return false;
+        }
+        keyframes_.clear();
+        edits_.clear();
+        std::string line;
+        int lineNumber = 0;
+        while (std::getline(file, line)) {
+            ++lineNumber;
+            line = line.substr(0, line.find('#'));
+            std::istringstream in(line);
+            std::string command;
+            if (!(in >> command)) continue;
+            bool isValid = false;
+            if (command == "seed") {
+                isValid = static_cast<bool>(in >> seed);
+            }
+            else if (command == "key") {
+                Keyframe key{};
+                isValid = static_cast<bool>(in >> key.tick >> key.location.x >> key.location.y >> key.location.z >>
+                    key.yaw >> key.pitch);
+                if (isValid) keyframes_.push_back(key);
+            }
+            else if (command == "set") {
+                Edit edit{};
+                int blockId = 0;
+                isValid = static_cast<bool>(in >> edit.tick >> edit.coord.x >> edit.coord.y >> edit.coord.z >> blockId);
+                edit.blockId = static_cast<uint8_t>(blockId);
+                if (isValid) edits_.push_back(edit);
+            }
+            if (!isValid) {
+                LOG_ERROR("Flythrough", "%s:%d: cannot read '%s'", path.c_str(), lineNumber, line.c_str());
+                return false;
+            }
+        }
+        if (keyframes_.empty()) {
+            LOG_ERROR("Flythrough", "%s has no keyframes", path.c_str());
+            return false;
+        }
+        std::stable_sort(keyframes_.begin(), keyframes_.end(),
+                         [](const Keyframe& a, const Keyframe& b) { return a.tick < b.tick; });
+        std::stable_sort(edits_.begin(), edits_.end(), [](const Edit& a, const Edit& b) { return a.tick < b.tick; });
+        name_ = path;
+        return true;
+    }
+
+    void Flythrough::makeDefault() {
+        constexpr int numKeys = 32;
+        constexpr uint64_t ticksPerKey = 60;
+        constexpr float radius = 96.0f;
+        constexpr float pi = 3.14159265f;
+        name_ = "default";
+        keyframes_.clear();
+        edits_.clear();
+        for (int k = 0; k <= numKeys; ++k) {
+            const float angle = 2 * pi * (float)k / numKeys;
+            const bool isLow = k < numKeys / 2;
+            // Facing along the circle: yaw 0 looks to z-, 90 to x+
+            keyframes_.push_back(Keyframe{
+                k * ticksPerKey, glm::vec3{std::cos(angle) * radius, isLow ? 45.0f : 110.0f, std::sin(angle) * radius},
+                glm::degrees(angle) + 180.0f, isLow ? -15.0f : -35.0f
+            });
+        }
+        for (uint64_t tick = ticksPerKey / 2; tick < getNumTicks(); tick += ticksPerKey) {
+            Player player;
+            prepareTick(tick, player);
+            for (int y = 20; y < 40; ++y)
+                edits_.push_back(Edit{tick, glm::ivec3{(int)std::floor(player.location.x), y,
+                                                       (int)std::floor(player.location.z)}, 0});
+        }
+    }
+
+    uint64_t Flythrough::getNumTicks() const {
+        return keyframes_.empty() ? 0 : keyframes_.back().tick + 1;
+    }
+
+    PlayerInput Flythrough::prepareTick(const uint64_t tick, Player& player) const {
+        PlayerInput input;
+        if (keyframes_.empty()) return input;
+        const auto next = std::upper_bound(keyframes_.begin(), keyframes_.end(), tick,
+                                           [](const uint64_t t, const Keyframe& key) { return t < key.tick; });
+        const Keyframe& a = next == keyframes_.begin() ? *next : *(next - 1);
+        const Keyframe& b = next == keyframes_.end() ? a : *next;
+        const float t = b.tick > a.tick ? glm::clamp((float)(tick - a.tick) / (float)(b.tick - a.tick), 0.0f, 1.0f)
+                            : 0.0f;
+        player.location = a.location + (b.location - a.location) * t;
+        player.isFloating = true;
+        input.yaw = a.yaw + (b.yaw - a.yaw) * t;
+        input.pitch = a.pitch + (b.pitch - a.pitch) * t;
+        return input;
+    }
+
+    void Flythrough::applyEdits(const uint64_t tick, World& world) const {
+        const auto first = std::lower_bound(edits_.begin(), edits_.end(), tick,
+                                            [](const Edit& edit, const uint64_t t) { return edit.tick < t; });
+        for (auto it = first; it != edits_.end() && it->tick == tick; ++it)
+            world.setBlockId(it->coord, it->blockId);
+    }
+
+    bool Flythrough::writeReport(const std::string& path, const std::string& renderer) const {
+        FILE* file = fopen(path.c_str(), "w");
+        if (!file) {
+            LOG_ERROR("Flythrough", "Could not write %s", path.c_str());
+            return false;
+        }
+        std::vector<double> series[FrameStats::numSeries], simulationMs, drawCalls, vertices;
+        uint64_t numChunksGenerated = 0, numChunksMeshed = 0, numShadowFullUpdates = 0;
+        for (const Sample& sample : samples_) {
+            for (int s = 0; s < FrameStats::numSeries; ++s) series[s].push_back(sample.seriesMs[s]);
+            simulationMs.push_back(sample.simulationMs);
+            drawCalls.push_back((double)sample.numDrawCalls);
+            vertices.push_back((double)sample.numVertices);
+            numChunksGenerated += sample.numChunksGenerated;
+            numChunksMeshed += sample.numChunksMeshed;
+            numShadowFullUpdates += (uint64_t)sample.numShadowFullUpdates;
+        }
+
+        fprintf(file, "{\n  \"script\": \"%s\",\n  \"seed\": %d,\n  \"renderer\": \"%s\",\n  \"frames\": %zu,\n",
+                escapeJson(name_).c_str(), seed, escapeJson(renderer).c_str(), samples_.size());
+        fprintf(file, "  \"chunksGenerated\": %llu,\n  \"chunksMeshed\": %llu,\n",
+                static_cast<unsigned long long>(numChunksGenerated), static_cast<unsigned long long>(numChunksMeshed));
+        fprintf(file, "  \"shadowFullUpdates\": %llu,\n", static_cast<unsigned long long>(numShadowFullUpdates));
+        fprintf(file, "  \"summary\": {\n");
+        for (int s = 0; s < FrameStats::numSeries; ++s)
+            writeDistribution(file, (std::string(FrameStats::getSeriesName(s)) + "Ms").c_str(), series[s], false);
+        writeDistribution(file, "simulationMs", simulationMs, false);
+        writeDistribution(file, "drawCalls", drawCalls, false);
+        writeDistribution(file, "vertices", vertices, true);
+        fprintf(file, "  },\n  \"columns\": [");
+        for (int s = 0; s < FrameStats::numSeries; ++s) fprintf(file, "\"%sMs\", ", FrameStats::getSeriesName(s));
+        fprintf(file, "\"simulationMs\", \"drawCalls\", \"drawCommands\", \"vertices\", \"chunksGenerated\", "
+                "\"chunksMeshed\"],\n  \"perFrame\": [\n");
+        for (size_t i = 0; i < samples_.size(); ++i) {
+            const Sample& sample = samples_[i];
+            fprintf(file, "    [");
+            for (const float ms : sample.seriesMs) fprintf(file, "%.3f, ", ms);
+            fprintf(file, "%.3f, %zu, %zu, %zu, %llu, %llu]%s\n", sample.simulationMs, sample.numDrawCalls,
+                    sample.numDrawCommands, sample.numVertices,
+                    static_cast<unsigned long long>(sample.numChunksGenerated),
+                    static_cast<unsigned long long>(sample.numChunksMeshed), i + 1 < samples_.size() ? "," : "");
+        }
+        fprintf(file, "  ]\n}\n");
+        fclose(file);
+        return true;
+    }
+}
@@ -0,0 +1,120 @@
+﻿#include "FrameStats.h"
+
+#include <algorithm>
+
+#include "Log.h"
+
+using namespace OctaCubic;
+
+constexpr int FrameStats::numSeries;
+constexpr int FrameStats::frameSeries;
+constexpr size_t FrameStats::windowFrames;
+constexpr double FrameStats::bucketMs;
+constexpr int FrameStats::numBuckets;
+
+FrameStats::FrameStats(const double budgetMs): budgetMs_(budgetMs) {}
+
+FrameStats::~FrameStats() {
+    stopCsv();
+}
+
+void FrameStats::beginFrame() {
+    const auto now = std::chrono::steady_clock::now();
+    if (isFrameStarted_)
+        pushFrame(std::chrono::duration<double, std::milli>(now - frameStart_).count());
+    else
+        firstFrameStart_ = now;
+    isFrameStarted_ = true;
+    frameStart_ = now;
+    std::fill(currentPhaseMs_, currentPhaseMs_ + numPhases, 0.0);
+}
+
+void FrameStats::addPhaseMs(const Phase phase, const double ms) {
+    currentPhaseMs_[phase] += ms;
+}
+
+int FrameStats::getBucket(const double ms) {
+    return std::min(std::max(static_cast<int>(ms / bucketMs), 0), numBuckets - 1);
+}
+
+void FrameStats::pushFrame(const double frameMs) {
+    double values[numSeries];
+    values[frameSeries] = frameMs;
+    for (int phase = 0; phase < numPhases; ++phase)
+        values[phase + 1] = currentPhaseMs_[phase];
+    // The slot being overwritten leaves the histograms
+    for (int series = 0; series < numSeries; ++series) {
+        if (numFrames_ == windowFrames) --histogram_[series][getBucket(history_[series][next_])];
+        history_[series][next_] = static_cast<float>(values[series]);
+        ++histogram_[series][getBucket(values[series])];
+    }
+    next_ = (next_ + 1) % windowFrames;
+    numFrames_ = std::min(numFrames_ + 1, windowFrames);
+
+    if (csv_) {
+        const double seconds = std::chrono::duration<double>(frameStart_ - firstFrameStart_).count();
+        fprintf(csv_, "%llu,%.6f", static_cast<unsigned long long>(frameIndex_), seconds);
+        for (const double value : values)
+            fprintf(csv_, ",%.4f", value);
+        fputc('\n', csv_);
+    }
+    ++frameIndex_;
+}
+
+FrameStats::Summary FrameStats::getSummary(const int series) const {
+    Summary summary;
+    if (numFrames_ == 0) return summary;
+    // Percentiles from the histogram, each reported as the upper edge of its bucket
+    const size_t ranks[3] = {
+        (numFrames_ * 50 + 99) / 100, (numFrames_ * 95 + 99) / 100, (numFrames_ * 99 + 99) / 100
+    };
+    double* results[3] = {&summary.p50, &summary.p95, &summary.p99};
+    size_t seen = 0;
+    int next = 0;
+    for (int bucket = 0; bucket < numBuckets && next < 3; ++bucket) {
+        seen += histogram_[series][bucket];
+        while (next < 3 && seen >= ranks[next])
+            *results[next++] = (bucket + 1) * bucketMs;
+    }
+    // The window is small enough to scan for the exact maximum and the budget
+    for (size_t i = 0; i < numFrames_; ++i) {
+        const double value = history_[series][i];
+        summary.max = std::max(summary.max, value);
+        if (series == frameSeries && value > budgetMs_) ++summary.numOverBudget;
+    }
+    for (double* result : results)
+        *result = std::min(*result, summary.max);
+    return summary;
+}
+
+void FrameStats::setBudgetMs(const double budgetMs) {
+    budgetMs_ = budgetMs;
+}
+
+const char* FrameStats::getSeriesName(const int series) {
+    static const char* names[numSeries] = {"frame", "preprocess", "shadow", "main", "water", "gui"};
+    return names[series];
+}
+
+bool FrameStats::startCsv(const std::string& path) {
+    stopCsv();
+    csv_ = fopen(path.c_str(), "w");
+    if (!csv_) {
+        LOG_ERROR("FrameStats", "Could not open %s", path);
+        return false;
+    }
+    csvPath_ = path;
+    fprintf(csv_, "frame,time_s");
+    for (int series = 0; series < numSeries; ++series)
+        fprintf(csv_, ",%s_ms", getSeriesName(series));
+    fputc('\n', csv_);
+    LOG_INFO("FrameStats", "Writing frame times to %s", path);
+    return true;
+}
+
+void FrameStats::stopCsv() {
+    if (!csv_) return;
+    fclose(csv_);
+    csv_ = nullptr;
+    LOG_INFO("FrameStats", "Closed %s", csvPath_);
+}
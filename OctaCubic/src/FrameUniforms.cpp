@@ -0,0 +1,24 @@
+﻿#include "FrameUniforms.h"
+
+#include <glad/glad.h>
+
+using namespace OctaCubic;
+
+constexpr unsigned int FrameUniformBuffer::bindingPoint;
+constexpr const char* FrameUniformBuffer::blockName;
+
+static_assert(sizeof(FrameUniforms) % 16 == 0, "std140 blocks are padded to vec4");
+
+void FrameUniformBuffer::initGPU() {
+    glGenBuffers(1, &buffer_);
+    glBindBuffer(GL_UNIFORM_BUFFER, buffer_);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameUniforms), nullptr, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    glBindBufferBase(GL_UNIFORM_BUFFER, bindingPoint, buffer_);
+}
+
+void FrameUniformBuffer::update(const FrameUniforms& uniforms) const {
+    glBindBuffer(GL_UNIFORM_BUFFER, buffer_);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(FrameUniforms), &uniforms);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
@@ -0,0 +1,78 @@
+﻿#include "Frustum.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define OCTACUBIC_FRUSTUM_SSE
+#include <xmmintrin.h>
+#endif
+
+using namespace OctaCubic;
+
+Frustum::Frustum() {
+    // Default frustum accepts everything
+    for (int i = 0; i < numPlanes; ++i) planeW_[i] = 1.0f;
+}
+
+Frustum::Frustum(const glm::mat4& viewProjection) {
+    update(viewProjection);
+}
+
+void Frustum::update(const glm::mat4& viewProjection) {
+    // Gribb & Hartmann plane extraction; glm is column-major so row r is m[0][r], m[1][r], m[2][r], m[3][r]
+    const glm::mat4& m = viewProjection;
+    const glm::vec4 row0{m[0][0], m[1][0], m[2][0], m[3][0]};
+    const glm::vec4 row1{m[0][1], m[1][1], m[2][1], m[3][1]};
+    const glm::vec4 row2{m[0][2], m[1][2], m[2][2], m[3][2]};
+    const glm::vec4 row3{m[0][3], m[1][3], m[2][3], m[3][3]};
+    const glm::vec4 planes[6] = {
+        row3 + row0, // Left
+        row3 - row0, // Right
+        row3 + row1, // Bottom
+        row3 - row1, // Top
+        row3 + row2, // Near
+        row3 - row2, // Far
+    };
+    for (int i = 0; i < 6; ++i) {
+        planeX_[i] = planes[i].x;
+        planeY_[i] = planes[i].y;
+        planeZ_[i] = planes[i].z;
+        planeW_[i] = planes[i].w;
+    }
+    for (int i = 6; i < numPlanes; ++i) {
+        planeX_[i] = planeY_[i] = planeZ_[i] = 0.0f;
+        planeW_[i] = 1.0f;
+    }
+}
+
+bool Frustum::isBoxVisible(const glm::vec3& boxMin, const glm::vec3& boxMax) const {
+    // A box is outside if its most positive corner along a plane's normal is still behind that plane.
+    // n . p_vertex = sum over axes of max(n * min, n * max), which needs no per-plane branching.
+#ifdef OCTACUBIC_FRUSTUM_SSE
+    const __m128 minX = _mm_set1_ps(boxMin.x);
+    const __m128 minY = _mm_set1_ps(boxMin.y);
+    const __m128 minZ = _mm_set1_ps(boxMin.z);
+    const __m128 maxX = _mm_set1_ps(boxMax.x);
+    const __m128 maxY = _mm_set1_ps(boxMax.y);
+    const __m128 maxZ = _mm_set1_ps(boxMax.z);
+    const __m128 zero = _mm_setzero_ps();
+    for (int i = 0; i < numPlanes; i += 4) {
+        const __m128 pX = _mm_load_ps(planeX_ + i);
+        const __m128 pY = _mm_load_ps(planeY_ + i);
+        const __m128 pZ = _mm_load_ps(planeZ_ + i);
+        const __m128 pW = _mm_load_ps(planeW_ + i);
+        __m128 dist = _mm_add_ps(_mm_max_ps(_mm_mul_ps(pX, minX), _mm_mul_ps(pX, maxX)), pW);
+        dist = _mm_add_ps(dist, _mm_max_ps(_mm_mul_ps(pY, minY), _mm_mul_ps(pY, maxY)));
+        dist = _mm_add_ps(dist, _mm_max_ps(_mm_mul_ps(pZ, minZ), _mm_mul_ps(pZ, maxZ)));
+        if (_mm_movemask_ps(_mm_cmplt_ps(dist, zero)) != 0) return false;
+    }
+    return true;
+#else
+    for (int i = 0; i < numPlanes; ++i) {
+        const float dist = planeW_[i]
+            + glm::max(planeX_[i] * boxMin.x, planeX_[i] * boxMax.x)
+            + glm::max(planeY_[i] * boxMin.y, planeY_[i] * boxMax.y)
+            + glm::max(planeZ_[i] * boxMin.z, planeZ_[i] * boxMax.z);
+        if (dist < 0) return false;
+    }
+    return true;
+#endif
+}
@@ -0,0 +1,156 @@
+﻿#include "InputRecording.h"
+
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+#include "ByteStream.h"
+#include "Log.h"
+
+namespace OctaCubic
+{
+    namespace
+    {
+        // Little endian throughout
+        constexpr char magic[4] = {'O', 'C', 'I', 'N'};
+        constexpr uint32_t version = 1;
+
+        enum InputFlag : uint8_t {
+            sprinting = 1 << 0,
+            jumping = 1 << 1,
+            breakingBlock = 1 << 2,
+            placingBlock = 1 << 3,
+            togglingFloating = 1 << 4,
+        };
+
+        bool isSameInput(const PlayerInput& a, const PlayerInput& b) {
+            return a.moveForward == b.moveForward && a.moveRight == b.moveRight && a.moveUp == b.moveUp &&
+                a.isSprinting == b.isSprinting && a.isJumping == b.isJumping &&
+                a.isBreakingBlock == b.isBreakingBlock && a.isPlacingBlock == b.isPlacingBlock &&
+                a.isTogglingFloating == b.isTogglingFloating && a.yaw == b.yaw && a.pitch == b.pitch &&
+                a.sunRotation == b.sunRotation;
+        }
+    }
+
+    InputRecorder::~InputRecorder() {
+        close();
+    }
+
+    bool InputRecorder::open(const std::string& path, const InputRecordingHeader& header) {
+        close();
+        file_ = fopen(path.c_str(), "wb");
+        if (!file_) {
+            LOG_ERROR("InputRecorder", "Could not open %s", path.c_str());
+            return false;
+        }
+        std::vector<uint8_t> bytes(magic, magic + sizeof(magic));
+        putU32(bytes, version);
+        putU32(bytes, static_cast<uint32_t>(header.seed));
+        putF64(bytes, header.tickRate);
+        putF32(bytes, header.spawn.x);
+        putF32(bytes, header.spawn.y);
+        putF32(bytes, header.spawn.z);
+        fwrite(bytes.data(), 1, bytes.size(), file_);
+        runLength_ = 0;
+        numTicks_ = 0;
+        LOG_INFO("InputRecorder", "Recording to %s, seed %d", path.c_str(), header.seed);
+        return true;
+    }
+
+    void InputRecorder::record(const PlayerInput& input) {
+        if (!file_) return;
+        ++numTicks_;
+        if (runLength_ > 0 && isSameInput(input, run_)) {
+            ++runLength_;
+            return;
+        }
+        writeRun();
+        run_ = input;
+        runLength_ = 1;
+    }
+
+    void InputRecorder::close() {
+        if (!file_) return;
+        writeRun();
+        fclose(file_);
+        file_ = nullptr;
+        LOG_INFO("InputRecorder", "Recorded %llu ticks", static_cast<unsigned long long>(numTicks_));
+    }
+
+    void InputRecorder::writeRun() {
+        if (runLength_ == 0) return;
+        // Run length, flags, the four small integers, then the look direction
+        std::vector<uint8_t> bytes;
+        putVarint(bytes, runLength_);
+        bytes.push_back(static_cast<uint8_t>((run_.isSprinting ? sprinting : 0) | (run_.isJumping ? jumping : 0) |
+            (run_.isBreakingBlock ? breakingBlock : 0) | (run_.isPlacingBlock ? placingBlock : 0) |
+            (run_.isTogglingFloating ? togglingFloating : 0)));
+        for (const int value : {run_.moveForward, run_.moveRight, run_.moveUp, run_.sunRotation})
+            bytes.push_back(static_cast<uint8_t>(static_cast<int8_t>(value)));
+        putF32(bytes, run_.yaw);
+        putF32(bytes, run_.pitch);
+        fwrite(bytes.data(), 1, bytes.size(), file_);
+        runLength_ = 0;
+    }
+
+    bool InputReplay::load(const std::string& path) {
+        std::ifstream file(path, std::ios::binary);
+        if (!file) {
+            LOG_ERROR("InputReplay", "Could not open %s", path.c_str());
+            return false;
+        }
+        const std::vector<uint8_t> data{std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+        ByteReader reader(data);
+        char fileMagic[sizeof(magic)];
+        for (char& c : fileMagic) c = static_cast<char>(reader.getU8());
+        if (memcmp(fileMagic, magic, sizeof(magic)) != 0 || reader.getU32() != version) {
+            LOG_ERROR("InputReplay", "%s is not an input recording of this version", path.c_str());
+            return false;
+        }
+        header_.seed = static_cast<int32_t>(reader.getU32());
+        header_.tickRate = reader.getF64();
+        header_.spawn.x = reader.getF32();
+        header_.spawn.y = reader.getF32();
+        header_.spawn.z = reader.getF32();
+
+        runs_.clear();
+        numTicks_ = 0;
+        while (!reader.isAtEnd()) {
+            Run run;
+            run.length = reader.getVarint();
+            const uint8_t flags = reader.getU8();
+            run.input.isSprinting = (flags & sprinting) != 0;
+            run.input.isJumping = (flags & jumping) != 0;
+            run.input.isBreakingBlock = (flags & breakingBlock) != 0;
+            run.input.isPlacingBlock = (flags & placingBlock) != 0;
+            run.input.isTogglingFloating = (flags & togglingFloating) != 0;
+            run.input.moveForward = static_cast<int8_t>(reader.getU8());
+            run.input.moveRight = static_cast<int8_t>(reader.getU8());
+            run.input.moveUp = static_cast<int8_t>(reader.getU8());
+            run.input.sunRotation = static_cast<int8_t>(reader.getU8());
+            run.input.yaw = reader.getF32();
+            run.input.pitch = reader.getF32();
+            if (!reader.isValid() || run.length == 0) {
+                LOG_ERROR("InputReplay", "%s is truncated or corrupt", path.c_str());
+                return false;
+            }
+            runs_.push_back(run);
+            numTicks_ += run.length;
+        }
+        nextRun_ = 0;
+        nextInRun_ = 0;
+        LOG_INFO("InputReplay", "Replaying %llu ticks from %s, seed %d",
+                 static_cast<unsigned long long>(numTicks_), path.c_str(), header_.seed);
+        return true;
+    }
+
+    bool InputReplay::next(PlayerInput& input) {
+        if (nextRun_ >= runs_.size()) return false;
+        input = runs_[nextRun_].input;
+        if (++nextInRun_ == runs_[nextRun_].length) {
+            ++nextRun_;
+            nextInRun_ = 0;
+        }
+        return true;
+    }
+}
@@ -0,0 +1,180 @@
+﻿#include "JobSystem.h"
+
+#include <algorithm>
+
+#include "Profiler.h"
+
+using namespace OctaCubic;
+
+constexpr int JobSystem::maxExternalThreads;
+
+namespace
+{
+    std::atomic<uint64_t> nextSystemId{1};
+    // Which JobSystem the calling thread last worked for (by id, 0: none), and its slot there
+    thread_local uint64_t currentSystemId = 0;
+    thread_local int currentSlot = 0;
+}
+
+JobSystem::JobSystem(const int numWorkers)
+    : id_(nextSystemId.fetch_add(1, std::memory_order_relaxed)), numWorkers_(std::max(numWorkers, 0)) {
+    for (int i = 0; i < numWorkers_ + maxExternalThreads; ++i)
+        slots_.emplace_back(new Slot);
+    for (int i = 0; i < numWorkers_; ++i)
+        threads_.emplace_back(&JobSystem::workerLoop, this, i);
+}
+
+JobSystem::~JobSystem() {
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex_);
+        isStopping_ = true;
+    }
+    wakeCondition_.notify_all();
+    for (std::thread& thread : threads_)
+        thread.join();
+}
+
+int JobSystem::getDefaultNumWorkers() {
+    return std::max(static_cast<int>(std::thread::hardware_concurrency()) - 1, 1);
+}
+
+int JobSystem::getCurrentSlot() {
+    if (currentSystemId != id_) {
+        // First job from a thread that is not a worker
+        const int external = std::min(numExternalThreads_.fetch_add(1, std::memory_order_relaxed),
+                                      maxExternalThreads - 1);
+        currentSystemId = id_;
+        currentSlot = numWorkers_ + external;
+    }
+    return currentSlot;
+}
+
+void JobSystem::submit(std::function<void()> job, Counter* counter, const Priority priority) {
+    if (counter) counter->pending_.fetch_add(1, std::memory_order_relaxed);
+    push(Job{std::move(job), counter}, priority);
+}
+
+void JobSystem::submitAfter(Counter& dependency, std::function<void()> job, Counter* counter,
+                            const Priority priority) {
+    if (counter) counter->pending_.fetch_add(1, std::memory_order_relaxed);
+    {
+        std::lock_guard<std::mutex> lock(dependency.mutex_);
+        if (dependency.pending_.load(std::memory_order_acquire) > 0) {
+            dependency.continuations_.push_back(Counter::Continuation{std::move(job), counter, priority});
+            return;
+        }
+    }
+    push(Job{std::move(job), counter}, priority);
+}
+
+void JobSystem::push(Job&& job, const Priority priority) {
+    Slot& slot = *slots_[getCurrentSlot()];
+    {
+        std::lock_guard<std::mutex> lock(slot.mutex);
+        slot.queues[priority].push_back(std::move(job));
+    }
+    numQueued_.fetch_add(1, std::memory_order_release);
+    // Taking the lock keeps a worker from missing the wakeup between checking numQueued_ and sleeping
+    { std::lock_guard<std::mutex> lock(sleepMutex_); }
+    wakeCondition_.notify_one();
+}
+
+bool JobSystem::tryRunOne(const bool isOwnOnly) {
+    if (numQueued_.load(std::memory_order_acquire) == 0) return false;
+    const int numSlots = static_cast<int>(slots_.size());
+    const int own = getCurrentSlot();
+    Job job;
+    bool isFound = false;
+    for (int priority = 0; priority < numPriorities && !isFound; ++priority) {
+        // Own jobs newest first, they are the most likely to still be in cache
+        {
+            Slot& slot = *slots_[own];
+            std::lock_guard<std::mutex> lock(slot.mutex);
+            std::deque<Job>& queue = slot.queues[priority];
+            if (!queue.empty()) {
+                job = std::move(queue.back());
+                queue.pop_back();
+                isFound = true;
+            }
+        }
+        // Others' oldest first, usually the largest pieces of work left
+        for (int i = 1; i < numSlots && !isOwnOnly && !isFound; ++i) {
+            Slot& slot = *slots_[(own + i) % numSlots];
+            std::lock_guard<std::mutex> lock(slot.mutex);
+            std::deque<Job>& queue = slot.queues[priority];
+            if (!queue.empty()) {
+                job = std::move(queue.front());
+                queue.pop_front();
+                isFound = true;
+                numSteals_.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+    }
+    if (!isFound) return false;
+    numQueued_.fetch_sub(1, std::memory_order_relaxed);
+    job.job();
+    numJobsRun_.fetch_add(1, std::memory_order_relaxed);
+    finish(job.counter);
+    return true;
+}
+
+void JobSystem::finish(Counter* counter) {
+    if (!counter) return;
+    std::vector<Counter::Continuation> released;
+    {
+        std::lock_guard<std::mutex> lock(counter->mutex_);
+        if (counter->pending_.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            released.swap(counter->continuations_);
+    }
+    // The counter may be gone from here on: a waiter can return as soon as the lock is released
+    for (Counter::Continuation& continuation : released)
+        push(Job{std::move(continuation.job), continuation.counter}, continuation.priority);
+}
+
+void JobSystem::wait(Counter& counter) {
+    // Without workers nobody else would run the jobs
+    const bool isOwnOnly = getCurrentSlot() >= numWorkers_ && numWorkers_ > 0;
+    while (!counter.isDone()) {
+        if (!tryRunOne(isOwnOnly)) std::this_thread::yield();
+    }
+    // The last finish() may still hold the lock
+    std::lock_guard<std::mutex> lock(counter.mutex_);
+}
+
+void JobSystem::parallelFor(const size_t count, const size_t grainSize,
+                            const std::function<void(size_t begin, size_t end)>& body, const Priority priority) {
+    const size_t grain = std::max<size_t>(grainSize, 1);
+    Counter counter;
+    for (size_t begin = 0; begin < count; begin += grain) {
+        const size_t end = std::min(begin + grain, count);
+        submit([&body, begin, end] { body(begin, end); }, &counter, priority);
+    }
+    wait(counter);
+}
+
+void JobSystem::submitGL(std::function<void()> job) {
+    std::lock_guard<std::mutex> lock(glMutex_);
+    glJobs_.push_back(std::move(job));
+}
+
+size_t JobSystem::drainGLJobs() {
+    std::vector<std::function<void()>> jobs;
+    {
+        std::lock_guard<std::mutex> lock(glMutex_);
+        jobs.swap(glJobs_);
+    }
+    for (std::function<void()>& job : jobs)
+        job();
+    return jobs.size();
+}
+
+void JobSystem::workerLoop(const int slot) {
+    currentSystemId = id_;
+    currentSlot = slot;
+    Profiler::setThreadName("Worker " + std::to_string(slot));
+    while (!isStopping_) {
+        if (tryRunOne()) continue;
+        std::unique_lock<std::mutex> lock(sleepMutex_);
+        wakeCondition_.wait(lock, [this] { return isStopping_ || numQueued_.load(std::memory_order_acquire) > 0; });
+    }
+}
@@ -0,0 +1,249 @@
+﻿#include "Log.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <thread>
+
+using namespace OctaCubic;
+
+std::atomic<int> Log::level_{Log::debug};
+std::atomic<uint64_t> Log::numDropped_{0};
+constexpr size_t Log::maxArgs;
+constexpr size_t Log::stringCapacity;
+constexpr size_t Log::queueCapacity;
+constexpr uint32_t Log::maxPerSecond;
+
+namespace
+{
+    std::atomic<uint32_t> nextThreadId{1};
+    thread_local uint32_t currentThreadId = 0;
+
+    const char* levelNames[Log::numLevels] = {"DEBUG", "INFO ", "WARN ", "ERROR"};
+}
+
+// Kept apart from Log so the queue is only touched from here
+struct OctaCubic::LogQueue {
+    // Never destroyed, threads may still log during static destruction
+    static LogQueue& get() {
+        static LogQueue* queue = new LogQueue;
+        return *queue;
+    }
+
+    LogQueue() {
+        for (size_t i = 0; i < Log::queueCapacity; ++i)
+            records[i].sequence.store(i, std::memory_order_relaxed);
+        std::atexit(Log::flush);
+        std::thread(&LogQueue::run, this).detach();
+    }
+
+    Log::Record records[Log::queueCapacity];
+    std::atomic<size_t> enqueuePosition{0};
+    size_t dequeuePosition = 0; // Guarded by consumerMutex
+    std::mutex consumerMutex;
+    uint64_t numDroppedReported = 0; // Guarded by consumerMutex
+
+    void run() {
+        while (true) {
+            const size_t numWritten = drain();
+            if (numWritten == 0) std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        }
+    }
+
+    size_t drain() {
+        std::lock_guard<std::mutex> lock(consumerMutex);
+        size_t numWritten = 0;
+        while (true) {
+            Log::Record& record = records[dequeuePosition & (Log::queueCapacity - 1)];
+            if (record.sequence.load(std::memory_order_acquire) != dequeuePosition + 1) break;
+            writeLine(record);
+            record.sequence.store(dequeuePosition + Log::queueCapacity, std::memory_order_release);
+            ++dequeuePosition;
+            ++numWritten;
+        }
+        const uint64_t numDropped = Log::getNumDropped();
+        if (numDropped != numDroppedReported) {
+            fprintf(stdout, "[Log] %llu messages dropped, the queue was full\n",
+                    static_cast<unsigned long long>(numDropped - numDroppedReported));
+            numDroppedReported = numDropped;
+        }
+        if (numWritten) fflush(stdout);
+        return numWritten;
+    }
+
+    static void writeLine(const Log::Record& record) {
+        char message[2048];
+        format(record, message, sizeof(message));
+        fprintf(stdout, "[%9.3f] %s T%u %s: %s", (double)record.timeNs / 1e9, levelNames[record.level],
+                record.threadId, record.category, message);
+        if (record.numSuppressed)
+            fprintf(stdout, " (%u similar suppressed)", record.numSuppressed);
+        fputc('\n', stdout);
+    }
+
+    // printf over the captured arguments, one conversion at a time
+    static void format(const Log::Record& record, char* out, const size_t size) {
+        size_t used = 0;
+        uint32_t nextArg = 0;
+        const auto append = [&](const char* text, const size_t length) {
+            const size_t n = std::min(length, size - 1 - used);
+            memcpy(out + used, text, n);
+            used += n;
+        };
+        for (const char* c = record.format; *c && used < size - 1;) {
+            if (*c != '%') {
+                const char* next = strchr(c, '%');
+                const size_t length = next ? (size_t)(next - c) : strlen(c);
+                append(c, length);
+                c += length;
+                continue;
+            }
+            if (c[1] == '%') {
+                append("%", 1);
+                c += 2;
+                continue;
+            }
+            // %[flags][width][.precision][length]conversion; the length is replaced to fit the captured type
+            char spec[32] = "%";
+            size_t specLength = 1;
+            const char* p = c + 1;
+            while (*p && strchr("-+ #0123456789.", *p) && specLength < sizeof(spec) - 4) spec[specLength++] = *p++;
+            while (*p && strchr("hljztL", *p)) ++p;
+            const char conversion = *p ? *p++ : 's';
+            c = p;
+            if (nextArg >= record.numArgs) {
+                append("<?>", 3);
+                continue;
+            }
+            const Log::Arg& arg = record.args[nextArg++];
+            char text[512];
+            int length = 0;
+            switch (conversion) {
+                case 'c':
+                    spec[specLength++] = 'c';
+                    spec[specLength] = 0;
+                    length = snprintf(text, sizeof(text), spec, (int)toInteger(arg));
+                    break;
+                case 'd': case 'i':
+                    spec[specLength++] = 'l';
+                    spec[specLength++] = 'l';
+                    spec[specLength++] = 'd';
+                    spec[specLength] = 0;
+                    length = snprintf(text, sizeof(text), spec, toInteger(arg));
+                    break;
+                case 'u': case 'x': case 'X': case 'o':
+                    spec[specLength++] = 'l';
+                    spec[specLength++] = 'l';
+                    spec[specLength++] = conversion;
+                    spec[specLength] = 0;
+                    length = snprintf(text, sizeof(text), spec, (unsigned long long)toInteger(arg));
+                    break;
+                case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+                    spec[specLength++] = conversion;
+                    spec[specLength] = 0;
+                    length = snprintf(text, sizeof(text), spec, toFloating(arg));
+                    break;
+                case 'p':
+                    spec[specLength++] = 'p';
+                    spec[specLength] = 0;
+                    length = snprintf(text, sizeof(text), spec, arg.type == Log::Arg::pointer ? arg.p : nullptr);
+                    break;
+                default: // 's'
+                    spec[specLength++] = 's';
+                    spec[specLength] = 0;
+                    length = snprintf(text, sizeof(text), spec,
+                                      arg.type == Log::Arg::string ? record.strings + arg.s : "<?>");
+                    break;
+            }
+            if (length > 0) append(text, std::min((size_t)length, sizeof(text) - 1));
+        }
+        out[used] = 0;
+    }
+
+    static long long toInteger(const Log::Arg& arg) {
+        switch (arg.type) {
+            case Log::Arg::integer: return arg.i;
+            case Log::Arg::unsignedInteger: return (long long)arg.u;
+            case Log::Arg::floating: return (long long)arg.f;
+            default: return 0;
+        }
+    }
+
+    static double toFloating(const Log::Arg& arg) {
+        switch (arg.type) {
+            case Log::Arg::integer: return (double)arg.i;
+            case Log::Arg::unsignedInteger: return (double)arg.u;
+            case Log::Arg::floating: return arg.f;
+            default: return 0;
+        }
+    }
+};
+
+bool Log::Site::admit(const uint64_t nowNs, uint32_t& numSuppressed) {
+    const uint64_t second = nowNs / 1000000000 + 1; // 0 is the state before the first message
+    uint64_t current = second_.load(std::memory_order_relaxed);
+    if (current != second && second_.compare_exchange_strong(current, second, std::memory_order_relaxed)) {
+        count_.store(0, std::memory_order_relaxed);
+        numSuppressed = numSuppressed_.exchange(0, std::memory_order_relaxed);
+    }
+    if (count_.fetch_add(1, std::memory_order_relaxed) < maxPerSecond) return true;
+    numSuppressed_.fetch_add(1, std::memory_order_relaxed);
+    return false;
+}
+
+uint64_t Log::getNowNs() {
+    static const auto clockStart = std::chrono::steady_clock::now();
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - clockStart).count());
+}
+
+Log::Record* Log::beginRecord() {
+    LogQueue& queue = LogQueue::get();
+    size_t position = queue.enqueuePosition.load(std::memory_order_relaxed);
+    while (true) {
+        Record& record = queue.records[position & (queueCapacity - 1)];
+        const size_t sequence = record.sequence.load(std::memory_order_acquire);
+        const intptr_t difference = (intptr_t)sequence - (intptr_t)position;
+        if (difference == 0) {
+            if (queue.enqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                if (!currentThreadId) currentThreadId = nextThreadId.fetch_add(1, std::memory_order_relaxed);
+                record.threadId = currentThreadId;
+                record.timeNs = getNowNs();
+                return &record;
+            }
+        }
+        else if (difference < 0) {
+            // Full: the writer is behind by a whole queue
+            numDropped_.fetch_add(1, std::memory_order_relaxed);
+            return nullptr;
+        }
+        else position = queue.enqueuePosition.load(std::memory_order_relaxed);
+    }
+}
+
+void Log::commitRecord(Record* record) {
+    // The slot was claimed at sequence == position; position + 1 hands it to the writer
+    record->sequence.store(record->sequence.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+void Log::capture(Record& record, Arg& arg, const char* value) {
+    arg.type = Arg::string;
+    arg.s = record.stringsUsed;
+    if (!value) value = "(null)";
+    const size_t available = stringCapacity - record.stringsUsed;
+    if (available == 0) {
+        arg.s = stringCapacity - 1; // The last byte is always a terminator
+        return;
+    }
+    const size_t length = std::min(strlen(value), available - 1);
+    memcpy(record.strings + record.stringsUsed, value, length);
+    record.strings[record.stringsUsed + length] = 0;
+    record.stringsUsed += length + 1;
+}
+
+void Log::flush() {
+    LogQueue::get().drain();
+}
@@ -0,0 +1,62 @@
+﻿#include "MemoryStats.h"
+
+using namespace OctaCubic;
+
+namespace
+{
+    struct AtomicCounter {
+        std::atomic<int64_t> bytes{0};
+        std::atomic<int64_t> peakBytes{0};
+        std::atomic<int64_t> numAllocations{0};
+    };
+
+    AtomicCounter counters[MemoryStats::numTags];
+
+    const char* const tagNames[MemoryStats::numTags] = {
+        "Chunk blocks", "Chunk map", "Mesh data", "GPU chunk meshes", "GPU chunk arenas", "GPU upload rings",
+        "GPU shadow maps", "GPU textures"
+    };
+
+    void addBytes(AtomicCounter& counter, const int64_t bytes) {
+        const int64_t now = counter.bytes.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+        int64_t peak = counter.peakBytes.load(std::memory_order_relaxed);
+        while (now > peak && !counter.peakBytes.compare_exchange_weak(peak, now, std::memory_order_relaxed)) {}
+    }
+}
+
+void MemoryStats::add(const Tag tag, const int64_t bytes) {
+    addBytes(counters[tag], bytes);
+    counters[tag].numAllocations.fetch_add(1, std::memory_order_relaxed);
+}
+
+void MemoryStats::sub(const Tag tag, const int64_t bytes) {
+    counters[tag].bytes.fetch_sub(bytes, std::memory_order_relaxed);
+    counters[tag].numAllocations.fetch_sub(1, std::memory_order_relaxed);
+}
+
+void MemoryStats::resize(const Tag tag, const int64_t oldBytes, const int64_t newBytes) {
+    addBytes(counters[tag], newBytes - oldBytes);
+}
+
+MemoryStats::Counter MemoryStats::get(const Tag tag) {
+    const AtomicCounter& counter = counters[tag];
+    return Counter{
+        counter.bytes.load(std::memory_order_relaxed), counter.peakBytes.load(std::memory_order_relaxed),
+        counter.numAllocations.load(std::memory_order_relaxed)
+    };
+}
+
+const char* MemoryStats::getTagName(const Tag tag) {
+    return tagNames[tag];
+}
+
+bool MemoryStats::isGPU(const Tag tag) {
+    return tag >= gpuChunkMeshes;
+}
+
+int64_t MemoryStats::getTotalBytes(const bool gpu) {
+    int64_t total = 0;
+    for (int tag = 0; tag < numTags; ++tag)
+        if (tag != gpuChunkMeshes && isGPU(static_cast<Tag>(tag)) == gpu) total += counters[tag].bytes.load(std::memory_order_relaxed);
+    return total;
+}
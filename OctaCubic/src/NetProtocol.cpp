@@ -0,0 +1,77 @@
+﻿#include "NetProtocol.h"
+
+#include "Log.h"
+
+namespace OctaCubic
+{
+    constexpr uint32_t NetMessage::protocolVersion;
+    constexpr uint16_t NetMessage::defaultPort;
+    constexpr uint32_t NetMessage::maxPayloadBytes;
+    constexpr size_t NetConnection::headerBytes;
+
+    std::vector<uint8_t>& NetConnection::beginMessage(const NetMessage::Type type) {
+        // Drop what was sent before the buffer grows again
+        if (sendOffset_ > 0 && sendOffset_ * 2 >= sendBuffer_.size()) {
+            sendBuffer_.erase(sendBuffer_.begin(), sendBuffer_.begin() + sendOffset_);
+            sendOffset_ = 0;
+        }
+        messageStart_ = sendBuffer_.size();
+        sendBuffer_.resize(messageStart_ + headerBytes);
+        sendBuffer_[messageStart_ + 4] = type;
+        return sendBuffer_;
+    }
+
+    void NetConnection::endMessage() {
+        const uint32_t size = static_cast<uint32_t>(sendBuffer_.size() - messageStart_ - headerBytes);
+        for (int i = 0; i < 4; ++i) sendBuffer_[messageStart_ + i] = static_cast<uint8_t>(size >> (8 * i));
+    }
+
+    bool NetConnection::flush() {
+        while (sendOffset_ < sendBuffer_.size()) {
+            const long sent = socket_.send(sendBuffer_.data() + sendOffset_, sendBuffer_.size() - sendOffset_);
+            if (sent < 0) {
+                socket_.close();
+                return false;
+            }
+            if (sent == 0) return true; // Socket buffer full, the rest goes next time
+            sendOffset_ += static_cast<size_t>(sent);
+            numBytesSent_ += static_cast<uint64_t>(sent);
+        }
+        sendBuffer_.clear();
+        sendOffset_ = 0;
+        return socket_.isValid();
+    }
+
+    bool NetConnection::poll(NetMessage& message) {
+        for (;;) {
+            const size_t available = receiveBuffer_.size() - receiveOffset_;
+            if (available >= headerBytes) {
+                const uint8_t* header = receiveBuffer_.data() + receiveOffset_;
+                const uint32_t size = header[0] | header[1] << 8 | header[2] << 16 | static_cast<uint32_t>(header[3]) << 24;
+                if (size > NetMessage::maxPayloadBytes || header[4] >= NetMessage::numTypes) {
+                    LOG_ERROR("Net", "Malformed message (type %d, %u bytes), closing the connection", (int)header[4], size);
+                    socket_.close();
+                    return false;
+                }
+                if (available >= headerBytes + size) {
+                    message.type = static_cast<NetMessage::Type>(header[4]);
+                    message.payload.assign(header + headerBytes, header + headerBytes + size);
+                    receiveOffset_ += headerBytes + size;
+                    return true;
+                }
+            }
+            // Not a whole message yet: read more
+            if (receiveOffset_ > 0) {
+                receiveBuffer_.erase(receiveBuffer_.begin(), receiveBuffer_.begin() + receiveOffset_);
+                receiveOffset_ = 0;
+            }
+            const size_t oldSize = receiveBuffer_.size();
+            receiveBuffer_.resize(oldSize + 64 * 1024);
+            const long received = socket_.receive(receiveBuffer_.data() + oldSize, receiveBuffer_.size() - oldSize);
+            receiveBuffer_.resize(oldSize + static_cast<size_t>(received > 0 ? received : 0));
+            if (received < 0) socket_.close();
+            if (received <= 0) return false;
+            numBytesReceived_ += static_cast<uint64_t>(received);
+        }
+    }
+}
@@ -1,5 +1,7 @@
 #include "OctaCubic.h"
 
+#include <cstring>
+
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 
@@ -10,7 +12,17 @@
 #include <glad/glad.h> // Must before GLFW
 #include <GLFW/glfw3.h>
 
+#include "ChunkClient.h"
+#include "Flythrough.h"
+#include "FrameStats.h"
+#include "InputRecording.h"
+#include "JobSystem.h"
+#include "Log.h"
+#include "MemoryStats.h"
+#include "Profiler.h"
 #include "Shader.h"
+#include "Simulation.h"
+#include "FrameUniforms.h"
 #include "Cube.h"
 #include "World.h"
 #include "debugQuad.h"
@@ -30,19 +42,99 @@ OctaCubic::Shader shDebugFrameBuffer{};
 OctaCubic::Shader shHighlightBlock{};
 
 OctaCubic::World world{};
-OctaCubic::Player* player_ptr = nullptr;
+OctaCubic::JobSystem jobSystem{};
+OctaCubic::FrameStats frameStats{frameBudgetMs};
+OctaCubic::ShadowCascades shadowCascades{shadowCascadeCount, shadowResolution};
+OctaCubic::FrameUniformBuffer frameUniformBuffer{};
 
 OctaCubic::Cube unitCube{true};
 
-int main() {
+int main(int argc, char** argv) {
+    // OctaCubic --flythrough [script] [--report path]: the scripted benchmark, in a window that is never shown
+    OctaCubic::Flythrough flythrough;
+    bool isFlythrough = false;
+    std::string flythroughReportPath = "flythrough.json";
+    // --record path: every tick's input, to replay the session with --replay path
+    OctaCubic::InputRecorder inputRecorder;
+    OctaCubic::InputReplay inputReplay;
+    const char* inputRecordPath = nullptr;
+    bool isReplaying = false;
+    // --connect host[:port]: the world comes from a server (OctaCubicServer --port) instead of the seed
+    OctaCubic::ChunkClient chunkClient;
+    std::string serverHost;
+    uint16_t serverPort = OctaCubic::NetMessage::defaultPort;
+    // --profile, or OCTACUBIC_PROFILE=1: record profiler zones from the start instead of from the F7 timeline
+    if (const char* envProfile = getenv("OCTACUBIC_PROFILE"))
+        OctaCubic::Profiler::setEnabled(strcmp(envProfile, "0") != 0);
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--flythrough") == 0) {
+            isFlythrough = true;
+            if (i + 1 < argc && argv[i + 1][0] != '-') {
+                if (!flythrough.load(argv[++i])) return -1;
+            }
+            else flythrough.makeDefault();
+        }
+        else if (strcmp(argv[i], "--profile") == 0) OctaCubic::Profiler::setEnabled(true);
+        else if (strcmp(argv[i], "--report") == 0 && i + 1 < argc) flythroughReportPath = argv[++i];
+        else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) inputRecordPath = argv[++i];
+        else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+            if (!inputReplay.load(argv[++i])) return -1;
+            isReplaying = true;
+        }
+        else if (strcmp(argv[i], "--connect") == 0 && i + 1 < argc) {
+            serverHost = argv[++i];
+            const size_t colon = serverHost.rfind(':');
+            if (colon != std::string::npos) {
+                serverPort = static_cast<uint16_t>(atoi(serverHost.c_str() + colon + 1));
+                serverHost.resize(colon);
+            }
+        }
+        else {
+            LOG_ERROR("Startup", "Usage: %s [--flythrough [script] [--report path]] [--record path] [--replay path] "
+                      "[--connect host[:port]] [--profile]", argv[0]);
+            return -1;
+        }
+    }
+    const bool isConnecting = !serverHost.empty();
+    if (isConnecting && (isFlythrough || isReplaying)) {
+        LOG_ERROR("Startup", "--connect takes its world from the server, it cannot be combined with --flythrough "
+                  "or --replay");
+        return -1;
+    }
+    // Without a GPU or a display (CI): OCTACUBIC_GL_CONTEXT=osmesa or egl takes the context from Mesa directly
+    const char* headlessContextApi = isFlythrough ? getenv("OCTACUBIC_GL_CONTEXT") : nullptr;
+    if (headlessContextApi && strcmp(headlessContextApi, "osmesa") != 0 && strcmp(headlessContextApi, "egl") != 0) {
+        LOG_ERROR("Startup", "Unknown OCTACUBIC_GL_CONTEXT '%s', expected osmesa or egl", headlessContextApi);
+        return -1;
+    }
+#ifdef GLFW_PLATFORM_NULL
+    if (headlessContextApi) glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_NULL);
+#endif
+
     if (!glfwInit()) {
-        printf("Failed to init GLFW\n");
+        LOG_ERROR("Startup", "Failed to init GLFW");
         return -1;
     }
 
+    // Startup timing, printed per phase
+    const double startupBegin = glfwGetTime();
+    double startupPhaseBegin = startupBegin;
+    const auto logStartupPhase = [&startupPhaseBegin](const char* phase) {
+        const double now = glfwGetTime();
+        LOG_INFO("Startup", "%s took %.1f ms", phase, (now - startupPhaseBegin) * 1000);
+        startupPhaseBegin = now;
+    };
+
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 6);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    if (isFlythrough) {
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+        if (headlessContextApi && strcmp(headlessContextApi, "osmesa") == 0)
+            glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_OSMESA_CONTEXT_API);
+        else if (headlessContextApi && strcmp(headlessContextApi, "egl") == 0)
+            glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_EGL_CONTEXT_API);
+    }
 
     windowWidth = 1280;
     windowHeight = 720;
@@ -57,27 +149,43 @@ int main() {
     );
 
     if (!window) {
-        printf("Failed to create GLFW window\n");
+        LOG_ERROR("Startup", "Failed to create GLFW window");
         glfwTerminate();
         return -1;
     }
 
     glfwMakeContextCurrent(window);
     if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
-        printf("Failed to initialize GLAD\n");
+        LOG_ERROR("Startup", "Failed to initialize GLAD");
         glfwTerminate();
         return -1;
     }
     // Make sure not to call any OpenGL functions until *after* we initialize our function loader
-
-    // Compile shaders
-    shader.compile("src/shaders/vsh.glsl", "src/shaders/fsh.glsl");
-    shWater.compile("src/shaders/water_v.glsl", "src/shaders/water_f.glsl");
-    shNormal.compile("src/shaders/normal_v.glsl", "src/shaders/normal_f.glsl");
-    shShadowMap.compile("src/shaders/shadowMap_v.glsl", "src/shaders/shadowMap_f.glsl");
-    shDebugDepth.compile("src/shaders/debug_depth_v.glsl", "src/shaders/debug_depth_f.glsl");
-    shDebugFrameBuffer.compile("src/shaders/frameBuffer_v.glsl", "src/shaders/frameBuffer_f.glsl");
-    shHighlightBlock.compile("src/shaders/highlightBlock_v.glsl", "src/shaders/highlightBlock_f.glsl");
+    logStartupPhase("Window and GL context");
+
+    // Compile shaders: submit all of them before waiting on any, cached binaries skip compiling
+    const bool isParallelCompile = OctaCubic::Shader::enableParallelCompile((GLADloadproc)glfwGetProcAddress);
+    OctaCubic::Shader::setJobSystem(&jobSystem);
+    shader.beginCompile("src/shaders/vsh.glsl", "src/shaders/fsh.glsl");
+    shWater.beginCompile("src/shaders/water_v.glsl", "src/shaders/water_f.glsl");
+    shNormal.beginCompile("src/shaders/normal_v.glsl", "src/shaders/normal_f.glsl");
+    shShadowMap.beginCompile("src/shaders/shadowMap_v.glsl", "src/shaders/shadowMap_f.glsl");
+    shDebugDepth.beginCompile("src/shaders/debug_depth_v.glsl", "src/shaders/debug_depth_f.glsl");
+    shDebugFrameBuffer.beginCompile("src/shaders/frameBuffer_v.glsl", "src/shaders/frameBuffer_f.glsl");
+    shHighlightBlock.beginCompile("src/shaders/highlightBlock_v.glsl", "src/shaders/highlightBlock_f.glsl");
+    for (OctaCubic::Shader* sh : {&shader, &shWater, &shNormal, &shShadowMap, &shDebugDepth, &shDebugFrameBuffer,
+                                  &shHighlightBlock})
+        sh->finishCompile();
+    LOG_INFO("Startup", "Shaders: %d from cache, %d compiled%s",
+           OctaCubic::Shader::numCacheHits,
+           OctaCubic::Shader::numCacheMisses,
+           isParallelCompile ? " (parallel)" : "");
+    logStartupPhase("Shaders");
+    frameUniformBuffer.initGPU();
+    // Texture units never change
+    shader.setInt("texBlocks", 0);
+    shader.setInt("shadowMap", 1);
+    shWater.setInt("shadowMap", 1);
 
     // Set Inputs
     setInputs(window);
@@ -91,27 +199,55 @@ int main() {
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
     glfwSwapInterval(0); // Disable VSync
 
-    printf("%s\n", reinterpret_cast<const char*>(glGetString(GL_VERSION)));
+    LOG_INFO("Startup", "OpenGL %s", reinterpret_cast<const char*>(glGetString(GL_VERSION)));
 
     // Initialize World
-    OctaCubic::World::randomizeSeed();
+    if (isFlythrough) {
+        srand(flythrough.seed);
+        world.generateSeed();
+    }
+    else if (isReplaying) {
+        world.setSeed(inputReplay.getHeader().seed);
+    }
+    else if (isConnecting) {
+        if (!chunkClient.connect(serverHost.c_str(), serverPort, viewDistance)) return -1;
+        world.setSeed(chunkClient.getSeed());
+        world.setTerrainGenerated(false);
+        world.setEditLog(&chunkClient.getEditLog());
+        viewDistance = chunkClient.getViewDistance();
+    }
+    else {
+        OctaCubic::World::randomizeSeed();
+        world.generateSeed();
+    }
+    world.bindJobSystem(&jobSystem);
+    world.setMeshesToGLJobs(true);
     world.altitudeSeaSurface = SEA_SURFACE_ALTITUDE;
 
     // Initialize Player
     OctaCubic::Player player{};
-    player_ptr = &player;
     player.world_ptr = &world;
     if (!player.generatePlayerSpawn()) { return -1; }
+    if (isFlythrough) {
+        flythrough.prepareTick(0, player);
+        isFirstPersonView = true;
+    }
+    if (isReplaying) {
+        player.location = player.previousLocation = inputReplay.getHeader().spawn;
+        simulationTickRate = inputReplay.getHeader().tickRate;
+    }
+    logStartupPhase("World and player spawn");
 
     
     // Initialize Light Position Transform
     auto lightPosMat = glm::mat4(1.0f);
-    lightPosMat = glm::translate(lightPosMat, player_ptr->location); // Move to player location
+    lightPosMat = glm::translate(lightPosMat, player.location); // Move to player location
     lightPosMat = glm::scale(lightPosMat, glm::vec3((float)world.worldDimMax));
     lightPosition = lightPosMat * glm::vec4(lightPosition, 1);
 
-    setupDepthMap();
+    shadowCascades.initGPU();
     setupTextures();
+    logStartupPhase("Shadow maps and textures");
 
     // Setup ImGui context
     IMGUI_CHECKVERSION();
@@ -122,8 +258,42 @@ int main() {
     // Setup Platform/Renderer backends
     ImGui_ImplGlfw_InitForOpenGL(window, true); // install_callback=true: install GLFW callbacks and chain to existing ones.
     ImGui_ImplOpenGL3_Init();
-
+    logStartupPhase("ImGui");
+    LOG_INFO("Startup", "Total %.1f ms", (glfwGetTime() - startupBegin) * 1000);
+
+    // From here on the player and the blocks belong to the simulation thread; this thread draws its snapshots
+    OctaCubic::Simulation simulation{world, player, simulationTickRate, viewDistance};
+    float viewYaw = player.yaw, viewPitch = player.pitch; // Applied every frame, ahead of the ticks
+    if (inputRecordPath) {
+        OctaCubic::InputRecordingHeader header;
+        header.seed = world.getSeed();
+        header.tickRate = simulationTickRate;
+        header.spawn = player.location;
+        if (inputRecorder.open(inputRecordPath, header)) simulation.setInputRecorder(&inputRecorder);
+    }
+    if (isReplaying) simulation.setInputReplay(&inputReplay);
+    if (isConnecting) simulation.setChunkClient(&chunkClient);
+    // The flythrough runs the simulation here in lockstep, tick n at (n + 1) ticks on its own clock
+    simulation.update(isFlythrough ? -0.5 / simulationTickRate : OctaCubic::Simulation::getClockSeconds());
+    if (!isFlythrough) simulation.start();
+    uint64_t flythroughTick = 0;
+    OctaCubic::Flythrough::Sample flythroughSample{};
+
+    OctaCubic::Profiler::setThreadName("Main");
+    // Nightly performance runs set this to collect every frame
+    if (const char* envCsvPath = getenv("OCTACUBIC_FRAME_CSV")) frameStats.startCsv(envCsvPath);
     while (!glfwWindowShouldClose(window)) {
+        PROFILE_ZONE("Frame");
+        frameStats.beginFrame();
+        if (isFlythrough) {
+            // The frame times of the previous frame are known now
+            if (flythroughTick > 0) {
+                for (int series = 0; series < OctaCubic::FrameStats::numSeries; ++series)
+                    flythroughSample.seriesMs[series] = frameStats.getLastFrameMs(series);
+                flythrough.addSample(flythroughSample);
+            }
+            if (flythroughTick == flythrough.getNumTicks()) break;
+        }
 
         // Update inputs
         cursorDeltaX = cursorDeltaY = 0;
@@ -134,72 +304,130 @@ int main() {
         mouseButtonRightPressedPrev = mouseButtonRightPressed;
 
         /* Start handling game logics */
-        // Update time related variables
-        timeCurr = glfwGetTime();
-        timeDiff = timeCurr - timePrev;
-        frameCounter++;
-        if (timeDiff >= 1.0 / 30.0) {
-            second = timeDiff / frameCounter;
-        }
-        // Observer mode camera controls
-        if (!isFirstPersonView && cursorControlCam) {
-            camValPitch = glm::clamp<float>(camValPitch + cursorDeltaY * camRotSensitivity, -90, 90);
-            camValYaw += cursorDeltaX * camRotSensitivity;
-            if (camValYaw >= 180) camValYaw -= 360;
-            if (camValYaw < -180) camValYaw += 360;
+        if (isFlythrough) {
+            const uint64_t numGenerated = world.getNumChunksGenerated(), numMeshed = world.getNumChunksMeshed();
+            flythrough.applyEdits(flythroughTick, world);
+            const OctaCubic::PlayerInput input = flythrough.prepareTick(flythroughTick, player);
+            viewYaw = input.yaw;
+            viewPitch = input.pitch;
+            simulation.submitInput(input);
+            simulation.update((double)(flythroughTick + 1) / simulationTickRate);
+            flythroughSample.numChunksGenerated = world.getNumChunksGenerated() - numGenerated;
+            flythroughSample.numChunksMeshed = world.getNumChunksMeshed() - numMeshed;
+            ++flythroughTick;
         }
-        // Update player location and rotation
-        player.updateLocation(static_cast<float>(second), playerMoveForward, playerMoveRight, playerMoveUp);
-        player.updateRotation(cursorDeltaX, cursorDeltaY, camRotSensitivity);
-        // Player Aiming
-        const glm::vec3 posPlayerEye = player.location + glm::vec3{0, player.eyeHeight, 0};
-        const OctaCubic::CoordinatesAndFace aimBlockInfo = world.lineTraceToFace(posPlayerEye, player.directionLooking, 10.0f);
-        player.isAimingAtSomeBlock = aimBlockInfo.isHit;
-        player.aimingAtBlockCoord = glm::vec3{
-            static_cast<float>(aimBlockInfo.x),
-            static_cast<float>(aimBlockInfo.y),
-            static_cast<float>(aimBlockInfo.z)
-        };
-        player.aimingAtBlockFace = aimBlockInfo.f;
-        // Destroy & place block
-        if (isFirstPersonView) {
-            const int aX = static_cast<int>(player_ptr->aimingAtBlockCoord.x);
-            const int aY = static_cast<int>(player_ptr->aimingAtBlockCoord.y);
-            const int aZ = static_cast<int>(player_ptr->aimingAtBlockCoord.z);
-            if (mouseButtonLeftPressDown) {
-                world.setBlockId(glm::ivec3(aX, aY, aZ), 0);
+        else {
+            // Observer mode camera controls
+            if (!isFirstPersonView && cursorControlCam) {
+                camValPitch = glm::clamp<float>(camValPitch + cursorDeltaY * camRotSensitivity, -90, 90);
+                camValYaw += cursorDeltaX * camRotSensitivity;
+                if (camValYaw >= 180) camValYaw -= 360;
+                if (camValYaw < -180) camValYaw += 360;
             }
-            if (mouseButtonRightPressDown) {
-                int pX = aX, pY = aY, pZ = aZ;
-                switch (player_ptr->aimingAtBlockFace) {
-                    case OctaCubic::xPos: pX += 1; break;
-                    case OctaCubic::xNeg: pX -= 1; break;
-                    case OctaCubic::yPos: pY += 1; break;
-                    case OctaCubic::yNeg: pY -= 1; break;
-                    case OctaCubic::zPos: pZ += 1; break;
-                    case OctaCubic::zNeg: pZ -= 1; break;
-                }
-                world.setBlockId(glm::ivec3(pX, pY, pZ), 2);
+            // Looking around is applied every frame; ticks pick the rotation up through the input
+            OctaCubic::Player::applyLookDelta(viewYaw, viewPitch, cursorDeltaX, cursorDeltaY, camRotSensitivity);
+            OctaCubic::PlayerInput input{};
+            input.moveForward = playerMoveForward;
+            input.moveRight = playerMoveRight;
+            input.moveUp = playerMoveUp;
+            input.isSprinting = playerSprinting;
+            input.yaw = viewYaw;
+            input.pitch = viewPitch;
+            input.sunRotation = lightPosInputRotZ;
+            // One-shot actions wait for the next tick, however many frames that takes
+            input.isJumping = playerJumpPressed;
+            input.isTogglingFloating = playerToggleFloatingPressed;
+            playerJumpPressed = playerToggleFloatingPressed = false;
+            if (isFirstPersonView) {
+                input.isBreakingBlock = mouseButtonLeftPressDown;
+                input.isPlacingBlock = mouseButtonRightPressDown;
             }
+            simulation.submitInput(input);
         }
         /* End handling game logics */
 
+        // Draw the newest simulation state; if no tick finished since the last frame, the same one again
+        OctaCubic::TripleBuffer<OctaCubic::FrameSnapshot>& snapshots = simulation.getSnapshots();
+        snapshots.acquire();
+        const OctaCubic::FrameSnapshot& snapshot = snapshots.getReadBuffer();
+        if (isReplaying) {
+            // The camera follows the recorded look, not the mouse
+            viewYaw = snapshot.playerYaw;
+            viewPitch = snapshot.playerPitch;
+            if (simulation.isReplayFinished() && !glfwWindowShouldClose(window)) {
+                LOG_INFO("InputReplay", "Replayed all %llu ticks",
+                         static_cast<unsigned long long>(inputReplay.getNumTicks()));
+                glfwSetWindowShouldClose(window, 1);
+            }
+        }
+        const float alpha = isFlythrough ? 1.0f : glm::clamp<float>(
+            (float)((OctaCubic::Simulation::getClockSeconds() - snapshot.tickTime) / snapshot.tickSeconds), 0, 1);
+        lightPosRotZ = snapshot.lightPosRotZ;
+
         // Debugging GUI
-        updateDebuggingGUI(&player);
+        if (!isFlythrough) {
+            OctaCubic::FrameStats::Scope statsScope(frameStats, OctaCubic::FrameStats::gui);
+            updateDebuggingGUI(snapshot);
+            if (showProfiler) updateProfilerGUI();
+        }
+        if (isFrameCsvToggleRequested) {
+            isFrameCsvToggleRequested = false;
+            if (frameStats.isWritingCsv()) frameStats.stopCsv();
+            else frameStats.startCsv(frameCsvPath);
+        }
+        if (isTraceDumpRequested) {
+            isTraceDumpRequested = false;
+            if (!OctaCubic::Profiler::isEnabled())
+                LOG_WARNING("Profiler", "Not recording: start with --profile or tick Record in the profiler (F7)");
+            else if (OctaCubic::Profiler::writeChromeTrace(traceDumpPath, traceDumpSeconds))
+                LOG_INFO("Profiler", "Wrote the last %.0f s to %s", traceDumpSeconds, traceDumpPath);
+            else
+                LOG_ERROR("Profiler", "Could not write %s", traceDumpPath);
+        }
 
         // Clear screen
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
         // Main Draw
-        drawVertices(player);
+        drawVertices(snapshot, viewYaw, viewPitch, alpha);
+        if (isFlythrough) {
+            flythroughSample.simulationMs = snapshot.updateMs;
+            flythroughSample.numDrawCalls = OctaCubic::Chunk::getGPUArena().getNumDrawCalls() +
+                OctaCubic::Chunk::getDepthArena().getNumDrawCalls();
+            flythroughSample.numDrawCommands = OctaCubic::Chunk::getGPUArena().getNumDrawCommands() +
+                OctaCubic::Chunk::getDepthArena().getNumDrawCommands();
+            flythroughSample.numVertices = worldVertCount;
+            flythroughSample.numShadowFullUpdates = 0;
+            for (int i = 0; i < shadowCascades.getNumCascades(); ++i)
+                if (shadowCascades.getLastUpdateKind(i) == OctaCubic::ShadowCascades::full)
+                    ++flythroughSample.numShadowFullUpdates;
+        }
 
         // Render Debugging GUI
-        ImGui::Render();
-        ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+        if (!isFlythrough) {
+            PROFILE_ZONE("ImGui");
+            OctaCubic::FrameStats::Scope statsScope(frameStats, OctaCubic::FrameStats::gui);
+            ImGui::Render();
+            ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+        }
+
+        // GL work other threads handed over: new chunk meshes, program binaries to save
+        jobSystem.drainGLJobs();
 
+        PROFILE_ZONE("Swap buffers"); // Waits for the GPU when it is behind
         glfwSwapBuffers(window);
     }
 
+    simulation.stop();
+    inputRecorder.close();
+    frameStats.stopCsv();
+    if (isFlythrough) {
+        const std::string renderer = reinterpret_cast<const char*>(glGetString(GL_RENDERER));
+        if (flythrough.writeReport(flythroughReportPath, renderer))
+            LOG_INFO("Flythrough", "%llu frames of %s, report in %s",
+                     static_cast<unsigned long long>(flythroughTick), flythrough.getName().c_str(),
+                     flythroughReportPath.c_str());
+    }
     ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplGlfw_Shutdown();
     ImGui::DestroyContext();
@@ -209,98 +437,158 @@ int main() {
 
 
 // Render
-void drawVertices(OctaCubic::Player& player) {
-    world.smartRenderingPreprocess(player_ptr->location, 10);
+void drawVertices(const OctaCubic::FrameSnapshot& snapshot, const float yaw, const float pitch, const float alpha) {
+    const glm::vec3 playerLocation = snapshot.getPlayerLocation(alpha);
+    {
+        PROFILE_ZONE("Render queue");
+        OctaCubic::FrameStats::Scope statsScope(frameStats, OctaCubic::FrameStats::preprocess);
+        world.setRenderQueue(snapshot.chunksInView, snapshot.viewCenter, snapshot.viewDistance);
+    }
+    OctaCubic::Chunk::getGPUArena().flushUploads();
+    OctaCubic::Chunk::getGPUArena().resetDrawStats();
+    OctaCubic::Chunk::getDepthArena().flushUploads();
+    OctaCubic::Chunk::getDepthArena().resetDrawStats();
     // OctaCubic::Quad::vertRenderCount = 0;
 
+    // View(Camera) Transform
+    camView = glm::mat4(1.0f);
+    if (isFirstPersonView) {
+        camView = OctaCubic::Player::getCameraViewMat4(playerLocation + glm::vec3{0, snapshot.playerEyeHeight, 0},
+                                                       yaw, pitch);
+    }
+    else {
+        // Cam z distance
+        camView = glm::translate(camView, {0.0f, 0.0f, -(float)world.worldDimMax * camValDistance});
+        camView = glm::rotate(camView, glm::radians(camValPitch), glm::vec3(1.0f, 0.0f, 0.0f));
+        camView = glm::rotate(camView, glm::radians(camValYaw), glm::vec3(0.0f, 1.0f, 0.0f));
+        camView = glm::translate(camView, -playerLocation);
+    }
+
+    // Perspective Transform
+    const float fovY = glm::radians(isFirstPersonView ? 90.0f * (float)windowHeight / (float)windowWidth : 45.0f);
+    const float aspect = (float)windowWidth / (float)windowHeight;
+    const float camNear = 0.1f, camFar = 5 * (float)world.worldDimMax;
+    glm::mat4 projection = glm::perspective(fovY, aspect, camNear, camFar);
+
     // Light Position Transform
     auto lightPosMtx = glm::mat4(1.0f);
-    if (lightPosInputRotZ) lightPosRotZ += (float)lightPosInputRotZ;
-    lightPosRotZ = remainder(lightPosRotZ, 360);
     lightPosMtx = glm::rotate(lightPosMtx, glm::radians(lightPosRotZ), glm::vec3(0.0f, 0.0f, 1.0f));
 
-    // Render to depth map from light's POV
-    const float near_plane = (float)world.worldDimMax, far_plane = 5 * (float)world.worldDimMax;
-    glm::mat4 lightProjection = glm::ortho(
-        -(float)world.worldDimMax * .75f,
-        (float)world.worldDimMax * .75f,
-        -(float)world.worldDimMax * .9f,
-        (float)world.worldDimMax * .9f,
-        near_plane, far_plane);
-    glm::mat4 lightView = glm::lookAt(glm::vec3(lightPosMtx * glm::vec4(lightPosition, 1.0f)), player_ptr->location,
-                                      glm::vec3(0.0, 1.0, 0.0));
-    glm::mat4 lightSpaceMatrix = lightProjection * lightView;
-
-    glViewport(0, 0, shadow_width, shadow_height);
-    glBindFramebuffer(GL_FRAMEBUFFER, fboDepthMap);
-    glClear(GL_DEPTH_BUFFER_BIT);
-    shShadowMap.use();
-    setShaderUniforms(false, nullptr, nullptr, nullptr, &lightSpaceMatrix);
-    world.renderInQueueOpaque();
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    // Shadow cascades cover the part of the camera frustum that overlaps the loaded chunks
+    const glm::vec3 boundsMin = world.getRenderQueueBoundsMin(), boundsMax = world.getRenderQueueBoundsMax();
+    float worldNearZ = camFar, worldFarZ = camNear;
+    for (int c = 0; c < 8; ++c) {
+        const glm::vec3 corner(c & 1 ? boundsMax.x : boundsMin.x, c & 2 ? boundsMax.y : boundsMin.y,
+                               c & 4 ? boundsMax.z : boundsMin.z);
+        const float depth = -(camView * glm::vec4(corner, 1.0f)).z;
+        worldNearZ = glm::min(worldNearZ, depth);
+        worldFarZ = glm::max(worldFarZ, depth);
+    }
+    const float shadowNearZ = glm::clamp(worldNearZ, camNear, camFar);
+    const float shadowFarZ = glm::clamp(glm::min(worldFarZ, shadowNearZ + shadowDistance), shadowNearZ + 1, camFar);
+    // The sun is far enough for its rays to be parallel: only its rotation turns them, so walking keeps the
+    // cascades' light space, and what they cached, as it was
+    const glm::vec3 lightDir = -glm::vec3(lightPosMtx * glm::vec4(sunOffset, 0.0f));
+    shadowCascades.update(camView, fovY, aspect, shadowNearZ, shadowFarZ, lightDir, (float)OctaCubic::Chunk::height);
+
+    // Values shared by every pass, uploaded once
+    OctaCubic::FrameUniforms frameUniforms{};
+    frameUniforms.view = camView;
+    frameUniforms.projection = projection;
+    frameUniforms.normalMatrix = glm::transpose(glm::inverse(camView));
+    for (int i = 0; i < shadowCascades.getNumCascades(); ++i) {
+        frameUniforms.lightSpaceMatrices[i] = shadowCascades.getLightSpaceMatrix(i);
+        frameUniforms.cascadeSplits[i] = shadowCascades.getSplitDistances()[i];
+    }
+    frameUniforms.lightPosView = camView * lightPosMtx * glm::vec4(lightPosition, 1.0f);
+    frameUniforms.lightColor = glm::vec4(lightColor, 1.0f);
+    frameUniforms.ambient = ambient;
+    frameUniforms.time = (float)glfwGetTime();
+    frameUniforms.numCascades = shadowCascades.getNumCascades();
+    frameUniformBuffer.update(frameUniforms);
+
+    // Frustum culling: the camera and each cascade only draw the chunks they can see, each pass a job
+    {
+        PROFILE_ZONE("Culling");
+        OctaCubic::FrameStats::Scope statsScope(frameStats, OctaCubic::FrameStats::preprocess);
+        OctaCubic::JobSystem::Counter cullCounter;
+        jobSystem.submit([&] {
+            PROFILE_ZONE("Cull camera");
+            world.cullForCamera(projection * camView, glm::vec3(glm::inverse(camView)[3]));
+        }, &cullCounter, OctaCubic::JobSystem::high);
+        for (int i = 0; i < shadowCascades.getNumCascades(); ++i)
+            jobSystem.submit([i] {
+                PROFILE_ZONE("Cull cascade");
+                world.cullForLight(shadowCascades.getLightSpaceMatrix(i), i);
+            }, &cullCounter, OctaCubic::JobSystem::high);
+        jobSystem.wait(cullCounter);
+    }
+
+    // Render to depth map from light's POV, only where the cached depth is out of date
+    {
+        PROFILE_ZONE("Shadow pass");
+        OctaCubic::FrameStats::Scope statsScope(frameStats, OctaCubic::FrameStats::shadow);
+        static std::vector<OctaCubic::ShadowCaster> shadowCasters;
+        shShadowMap.use();
+        setShaderUniforms(false);
+        for (int i = 0; i < shadowCascades.getNumCascades(); ++i) {
+            world.getShadowCasters(i, shadowCasters);
+            const OctaCubic::ShadowCascades::CascadeUpdate update = shadowCascades.planUpdate(i, shadowCasters);
+            if (update.kind == OctaCubic::ShadowCascades::cached) continue;
+            shadowCascades.beginCascade(i, update);
+            shShadowMap.setMat4("lightSpaceMatrix", shadowCascades.getLightSpaceMatrix(i));
+            world.renderInQueueShadow(i, update.kind == OctaCubic::ShadowCascades::partial ? &update.regionMatrix : nullptr);
+            shadowCascades.endCascade(update);
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
 
     if (showLightSpaceDepth) {
         glViewport(0, 0, windowWidth, windowHeight);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
         shDebugDepth.use();
-        shDebugDepth.setFloat("near_plane", near_plane);
-        shDebugDepth.setFloat("far_plane", far_plane);
         shDebugDepth.setInt("depthMap", 0);
+        shDebugDepth.setInt("layer", debugShadowCascade);
         glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, texDepthMap);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, shadowCascades.getTexture());
         renderQuad();
         return;
     }
 
     /// Render Final Frame ///
-    glViewport(0, 0, windowWidth, windowHeight);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-    // View(Camera) Transform
-    camView = glm::mat4(1.0f);
-    if (isFirstPersonView) {
-        camView = player.getCameraViewMat4();
-    }
-    else {
-        // Cam z distance
-        camView = glm::translate(camView, {0.0f, 0.0f, -(float)world.worldDimMax * camValDistance});
-        camView = glm::rotate(camView, glm::radians(camValPitch), glm::vec3(1.0f, 0.0f, 0.0f));
-        camView = glm::rotate(camView, glm::radians(camValYaw), glm::vec3(0.0f, 1.0f, 0.0f));
-        camView = glm::translate(camView, -player_ptr->location);
-    }
-
-    // Perspective Transform
-    glm::mat4 projection = glm::perspective(glm::radians(isFirstPersonView
-                                                             ? 90.0f * (float)windowHeight / (float)windowWidth
-                                                             : 45.0f),
-                                            (float)windowWidth / (float)windowHeight,
-                                            0.1f,
-                                            5 * (float)world.worldDimMax);
+    PROFILE_ZONE("Main pass");
+    {
+        OctaCubic::FrameStats::Scope statsScope(frameStats, OctaCubic::FrameStats::main);
+        glViewport(0, 0, windowWidth, windowHeight);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
 
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, texBlocks);
-    glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_2D, texDepthMap);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, texBlocks);
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, shadowCascades.getTexture());
 
-    updateSkyColor();
+        updateSkyColor();
 
-    shader.use();
-    setShaderUniforms(false, &camView, &projection, &lightPosMtx, &lightSpaceMatrix);
-    world.renderInQueueOpaque();
-    shWater.use();
-    setShaderUniforms(true, &camView, &projection, &lightPosMtx, &lightSpaceMatrix);
-    world.renderInQueueWater();
+        shader.use();
+        setShaderUniforms(false);
+        world.renderInQueueOpaque();
+    }
+    {
+        PROFILE_ZONE("Water pass");
+        OctaCubic::FrameStats::Scope statsScope(frameStats, OctaCubic::FrameStats::water);
+        shWater.use();
+        setShaderUniforms(true);
+        world.renderInQueueWater();
+    }
 
     // Render Player Aiming Block
     shHighlightBlock.use();
     glm::mat4 aimingBlockModel = glm::mat4{1.0f};
-    aimingBlockModel = translate(aimingBlockModel, player_ptr->aimingAtBlockCoord);
+    aimingBlockModel = translate(aimingBlockModel, glm::vec3(snapshot.aimingAtBlockCoord));
     aimingBlockModel = translate(aimingBlockModel, glm::vec3{-.005f});
     aimingBlockModel = glm::scale(aimingBlockModel, glm::vec3{1.01f});
     shHighlightBlock.setMat4("model", aimingBlockModel);
-    shHighlightBlock.setMat4("view", camView);
-    shHighlightBlock.setMat4("projection", projection);
     unitCube.XPos.renderQuad();
     unitCube.XNeg.renderQuad();
     unitCube.YPos.renderQuad();
@@ -325,25 +613,9 @@ void drawVertices(OctaCubic::Player& player) {
     unitCube.ZNeg.renderQuad();
 }
 
-void setShaderUniforms(bool isWater,
-                 const glm::mat4* camView,
-                 const glm::mat4* projection,
-                 const glm::mat4* lightPosMat,
-                 const glm::mat4* lightSpaceMat) {
+void setShaderUniforms(bool isWater) {
+    // View, projection, light and time come from the per-frame uniform buffer
     OctaCubic::Shader::activeShader->setMat4("model", glm::mat4(1.0f));
-    if (camView)
-        OctaCubic::Shader::activeShader->setMat4("view", *camView);
-    if (projection)
-        OctaCubic::Shader::activeShader->setMat4("projection", *projection);
-    OctaCubic::Shader::activeShader->setInt("texBlocks", 0);
-    OctaCubic::Shader::activeShader->setInt("shadowMap", 1);
-    if (lightSpaceMat)
-        OctaCubic::Shader::activeShader->setMat4("lightSpaceMatrix", *lightSpaceMat);
-    if (lightPosMat)
-        OctaCubic::Shader::activeShader->setVec3("lightPos", *lightPosMat * glm::vec4(lightPosition, 1.0f));
-    OctaCubic::Shader::activeShader->setVec3("lightColor", lightColor);
-    OctaCubic::Shader::activeShader->setFloat("ambient", ambient);
-    OctaCubic::Shader::activeShader->setFloat("time", (float)glfwGetTime());
     if (isWater) {
         // Specular lighting and wave
         OctaCubic::Shader::activeShader->setFloat("specularStrength", 2);
@@ -403,36 +675,23 @@ void setupTextures() {
         glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, texBlocksDimX, texBlocksDimY, 0, GL_RGBA, GL_UNSIGNED_BYTE,
                      texBlocks_data);
         glGenerateMipmap(GL_TEXTURE_2D);
+        int64_t atlasBytes = 0;
+        for (int w = texBlocksDimX, h = texBlocksDimY; ; w = std::max(w / 2, 1), h = std::max(h / 2, 1)) {
+            atlasBytes += (int64_t)w * h * 4;
+            if (w == 1 && h == 1) break;
+        }
+        OctaCubic::MemoryStats::add(OctaCubic::MemoryStats::gpuTextures, atlasBytes);
     }
     else {
-        printf("Failed to load texture");
+        LOG_ERROR("Texture", "Failed to load texture");
     }
     stbi_image_free(texBlocks_data); // free the loaded image
     shader.setInt("blockRes", 16);
     shader.setInt("textureRes", texBlocksDimX);
 }
 
-void setupDepthMap() {
-    glGenFramebuffers(1, &fboDepthMap);
-    glGenTextures(1, &texDepthMap);
-    glBindTexture(GL_TEXTURE_2D, texDepthMap);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT, shadow_width, shadow_height, 0, GL_DEPTH_COMPONENT, GL_FLOAT,
-                 nullptr);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-
-    glBindFramebuffer(GL_FRAMEBUFFER, fboDepthMap);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, texDepthMap, 0);
-    glDrawBuffer(GL_NONE);
-    glReadBuffer(GL_NONE);
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-}
-
-
 // Debugging
-void updateDebuggingGUI(const OctaCubic::Player* player_ptr_local) {
+void updateDebuggingGUI(const OctaCubic::FrameSnapshot& snapshot) {
     ImGui_ImplOpenGL3_NewFrame();
     ImGui_ImplGlfw_NewFrame();
     ImGui::NewFrame();
@@ -453,25 +712,101 @@ void updateDebuggingGUI(const OctaCubic::Player* player_ptr_local) {
 
     ImGui::Text("FPS: %.1f", ImGui::GetIO().Framerate);
     ImGui::Text("MS: %.1f", ImGui::GetIO().Framerate > 0 ? 1000.0f / ImGui::GetIO().Framerate : 0.0f);
+    { // Frame time percentiles over the last frames, the graph scaled to show the budget line
+        const OctaCubic::FrameStats::Summary frame = frameStats.getSummary(OctaCubic::FrameStats::frameSeries);
+        ImGui::Text("Frame ms p50 %.1f / p95 %.1f / p99 %.1f / max %.1f, over %.1f ms: %llu of %llu%s",
+                    frame.p50, frame.p95, frame.p99, frame.max, frameStats.getBudgetMs(),
+                    (unsigned long long)frame.numOverBudget, (unsigned long long)frameStats.getNumFrames(),
+                    frameStats.isWritingCsv() ? " (CSV)" : "");
+        const float graphMax = (float)std::max(2 * frameStats.getBudgetMs(), frame.p99);
+        ImGui::PlotLines("##frameTimes", frameStats.getHistory(OctaCubic::FrameStats::frameSeries),
+                         (int)OctaCubic::FrameStats::windowFrames, (int)frameStats.getHistoryOffset(),
+                         nullptr, 0.0f, graphMax, ImVec2(36 * ImGui::GetFontSize(), 4 * ImGui::GetFontSize()));
+        for (int series = 1; series < OctaCubic::FrameStats::numSeries; ++series) {
+            const OctaCubic::FrameStats::Summary phase = frameStats.getSummary(series);
+            ImGui::Text("  %-10s p50 %.1f / p95 %.1f / p99 %.1f / max %.1f",
+                        OctaCubic::FrameStats::getSeriesName(series), phase.p50, phase.p95, phase.p99, phase.max);
+        }
+    }
+    ImGui::Text("Ticks: %llu at %.0f Hz, dropped: %llu, update: %.2f ms",
+                snapshot.tick,
+                1 / snapshot.tickSeconds,
+                snapshot.droppedTicks,
+                snapshot.updateMs);
     ImGui::Text("%llu Vertices", worldVertCount);
-    ImGui::Text("%llu Chunks in GPU", OctaCubic::Chunk::getNumOfChunksInGPU());
+    ImGui::Text("%llu Chunks in GPU", world.getNumChunksInGPU());
+    ImGui::Text("Sections drawn: %llu / culled: %llu / occluded: %llu",
+                world.getCameraCullingStats().drawn,
+                world.getCameraCullingStats().culled,
+                world.getCameraCullingStats().occluded);
+    const OctaCubic::ChunkBufferArena& chunkArena = OctaCubic::Chunk::getGPUArena();
+    ImGui::Text("Draw calls: %llu (%llu chunk ranges)",
+                chunkArena.getNumDrawCalls(),
+                chunkArena.getNumDrawCommands());
+    ImGui::Text("Chunk arena: %.1f / %.1f MB",
+                (float)(chunkArena.getUsed() * chunkArena.getVertexStride()) / (1024 * 1024),
+                (float)(chunkArena.getCapacity() * chunkArena.getVertexStride()) / (1024 * 1024));
+    const OctaCubic::ChunkBufferArena& depthArena = OctaCubic::Chunk::getDepthArena();
+    ImGui::Text("Depth arena: %.1f / %.1f MB, %llu draw calls (%llu chunk ranges)",
+                (float)(depthArena.getUsed() * depthArena.getVertexStride()) / (1024 * 1024),
+                (float)(depthArena.getCapacity() * depthArena.getVertexStride()) / (1024 * 1024),
+                depthArena.getNumDrawCalls(),
+                depthArena.getNumDrawCommands());
+    ImGui::Text("Uploaded: %.1f KB / frame, ring stalls: %llu (%.2f ms), total: %llu",
+                (float)chunkArena.getUploadRing().getLastFrameUploadBytes() / 1024,
+                chunkArena.getUploadRing().getLastFrameStalls(),
+                chunkArena.getUploadRing().getLastFrameStallMs(),
+                chunkArena.getUploadRing().getTotalStalls());
+    static const char* shadowUpdateNames[] = {"cached", "partial", "full"};
+    for (int i = 0; i < shadowCascades.getNumCascades(); ++i) {
+        // With the sun still, walking should leave most frames cached or partial
+        const uint64_t numFull = shadowCascades.getUpdateCount(i, OctaCubic::ShadowCascades::full);
+        const uint64_t numFrames = numFull + shadowCascades.getUpdateCount(i, OctaCubic::ShadowCascades::partial) +
+            shadowCascades.getUpdateCount(i, OctaCubic::ShadowCascades::cached);
+        ImGui::Text("Shadow cascade %d (to %.0f m) drawn: %llu / culled: %llu, %s (full %.1f%% of frames)",
+                    i,
+                    shadowCascades.getSplitDistances()[i],
+                    world.getLightCullingStats(i).drawn,
+                    world.getLightCullingStats(i).culled,
+                    shadowUpdateNames[shadowCascades.getLastUpdateKind(i)],
+                    numFrames ? 100.0 * (double)numFull / (double)numFrames : 0.0);
+    }
+    ImGui::Text("Shadow maps: %d x %dx%d, %.0f MB",
+                shadowCascades.getNumCascades(),
+                shadowCascades.getResolution(),
+                shadowCascades.getResolution(),
+                (float)shadowCascades.getMemoryBytes() / (1024 * 1024));
+    ImGui::Text("Memory: CPU %.1f MB, GPU %.1f MB",
+                (float)OctaCubic::MemoryStats::getTotalBytes(false) / (1024 * 1024),
+                (float)OctaCubic::MemoryStats::getTotalBytes(true) / (1024 * 1024));
+    for (int i = 0; i < OctaCubic::MemoryStats::numTags; ++i) {
+        const auto tag = static_cast<OctaCubic::MemoryStats::Tag>(i);
+        const OctaCubic::MemoryStats::Counter counter = OctaCubic::MemoryStats::get(tag);
+        ImGui::Text("  %-16s %8.1f MB (peak %.1f), %lld allocations",
+                    OctaCubic::MemoryStats::getTagName(tag),
+                    (double)counter.bytes / (1024 * 1024),
+                    (double)counter.peakBytes / (1024 * 1024),
+                    (long long)counter.numAllocations);
+    }
     ImGui::Text("Player: %.1f %.1f %.1f",
-                player_ptr_local->location.x,
-                player_ptr_local->location.y,
-                player_ptr_local->location.z);
-    const glm::ivec3 cc = OctaCubic::World::getCoordChunk(player_ptr_local->location);
-    const glm::ivec3 cl = OctaCubic::World::getCoordLocalToChunk(player_ptr_local->location);
+                snapshot.playerLocation.x,
+                snapshot.playerLocation.y,
+                snapshot.playerLocation.z);
+    const glm::ivec3 cc = OctaCubic::World::getCoordChunk(snapshot.playerLocation);
+    const glm::ivec3 cl = OctaCubic::World::getCoordLocalToChunk(snapshot.playerLocation);
     ImGui::Text("Chunk: %d %d %d / %d %d %d",
                 cc.x, cc.y, cc.z, cl.x, cl.y, cl.z);
     ImGui::Text("Yaw: %.1f Pitch: %.1f",
-                player_ptr_local->yaw, player_ptr_local->pitch);
+                snapshot.playerYaw, snapshot.playerPitch);
+    if (snapshot.isServerLost) ImGui::Text("Server: disconnected");
+    else if (snapshot.isWaitingForChunks) ImGui::Text("Server: waiting for chunks");
     ImGui::Text("Looking: %.1f %.1f %.1f",
-                player_ptr_local->directionLooking.x,
-                player_ptr_local->directionLooking.y,
-                player_ptr_local->directionLooking.z);
-    if (player_ptr_local->isAimingAtSomeBlock) {
+                snapshot.playerDirectionLooking.x,
+                snapshot.playerDirectionLooking.y,
+                snapshot.playerDirectionLooking.z);
+    if (snapshot.isAimingAtSomeBlock) {
         std::string blockFaceName;
-        switch (player_ptr_local->aimingAtBlockFace) {
+        switch (snapshot.aimingAtBlockFace) {
             case OctaCubic::xPos: blockFaceName = "X+"; break;
             case OctaCubic::xNeg: blockFaceName = "X-"; break;
             case OctaCubic::yPos: blockFaceName = "Y+"; break;
@@ -480,9 +815,9 @@ void updateDebuggingGUI(const OctaCubic::Player* player_ptr_local) {
             case OctaCubic::zNeg: blockFaceName = "Z-"; break;
         }
         ImGui::Text("Aiming: %d %d %d / %s", 
-                    static_cast<int>(floor(player_ptr_local->aimingAtBlockCoord.x)),
-                    static_cast<int>(floor(player_ptr_local->aimingAtBlockCoord.y)),
-                    static_cast<int>(floor(player_ptr_local->aimingAtBlockCoord.z)),
+                    snapshot.aimingAtBlockCoord.x,
+                    snapshot.aimingAtBlockCoord.y,
+                    snapshot.aimingAtBlockCoord.z,
                     blockFaceName.c_str());
     }
     else
@@ -506,3 +841,56 @@ void updateDebuggingGUI(const OctaCubic::Player* player_ptr_local) {
 
     ImGui::End();
 }
+
+void updateProfilerGUI() {
+    static std::vector<OctaCubic::Profiler::ThreadEvents> threads;
+    OctaCubic::Profiler::collect(profilerWindowMs / 1000, threads);
+    const double endNs = (double)OctaCubic::Profiler::getNowNs();
+    const double beginNs = endNs - profilerWindowMs * 1e6;
+
+    ImGui::SetNextWindowPos(ImVec2(10, (float)windowHeight - 340), ImGuiCond_FirstUseEver);
+    ImGui::SetNextWindowSize(ImVec2((float)windowWidth - 20, 330), ImGuiCond_FirstUseEver);
+    ImGui::SetNextWindowBgAlpha(0.8f);
+    ImGui::Begin("Profiler");
+    bool isRecording = OctaCubic::Profiler::isEnabled();
+    if (ImGui::Checkbox("Record", &isRecording)) OctaCubic::Profiler::setEnabled(isRecording);
+    ImGui::SameLine();
+    ImGui::SliderFloat("Window (ms)", &profilerWindowMs, 5.0f, 500.0f, "%.0f");
+    ImGui::SameLine();
+    ImGui::Text("F12: last %.0f s to %s", traceDumpSeconds, traceDumpPath.c_str());
+
+    ImDrawList* drawList = ImGui::GetWindowDrawList();
+    const float rowHeight = ImGui::GetTextLineHeight() + 2;
+    const float labelWidth = 8 * ImGui::GetFontSize();
+    const ImVec2 origin = ImGui::GetCursorScreenPos();
+    const float laneLeft = origin.x + labelWidth;
+    const float laneWidth = std::max(ImGui::GetContentRegionAvail().x - labelWidth, 1.0f);
+    const double pxPerNs = laneWidth / (endNs - beginNs);
+    float laneTop = origin.y;
+    for (const OctaCubic::Profiler::ThreadEvents& thread : threads) {
+        uint32_t maxDepth = 0;
+        for (const OctaCubic::Profiler::Event& event : thread.events)
+            maxDepth = std::max(maxDepth, event.depth);
+        drawList->AddText(ImVec2(origin.x, laneTop), IM_COL32(255, 255, 255, 255), thread.threadName.c_str());
+        for (const OctaCubic::Profiler::Event& event : thread.events) {
+            const float x0 = laneLeft + (float)((std::max((double)event.beginNs, beginNs) - beginNs) * pxPerNs);
+            const float x1 = std::max(laneLeft + (float)(((double)event.endNs - beginNs) * pxPerNs), x0 + 1);
+            const float y0 = laneTop + (float)event.depth * rowHeight;
+            const ImVec2 min(x0, y0), max(x1, y0 + rowHeight - 1);
+            // Same zone, same color: hue from the name
+            uint32_t hash = 2166136261u;
+            for (const char* c = event.name; c && *c; ++c) hash = (hash ^ (uint8_t)*c) * 16777619u;
+            drawList->AddRectFilled(min, max, ImColor::HSV((float)(hash % 360) / 360.0f, 0.5f, 0.75f));
+            if (x1 - x0 > 2 * ImGui::GetFontSize()) {
+                const ImVec4 clip(x0, y0, x1, y0 + rowHeight);
+                drawList->AddText(ImGui::GetFont(), ImGui::GetFontSize(), ImVec2(x0 + 2, y0),
+                                  IM_COL32(0, 0, 0, 255), event.name, nullptr, 0.0f, &clip);
+            }
+            if (ImGui::IsMouseHoveringRect(min, max))
+                ImGui::SetTooltip("%s: %.3f ms", event.name, (double)(event.endNs - event.beginNs) / 1e6);
+        }
+        laneTop += (float)(maxDepth + 1) * rowHeight + 4;
+    }
+    ImGui::Dummy(ImVec2(labelWidth + laneWidth, laneTop - origin.y));
+    ImGui::End();
+}
@@ -0,0 +1,161 @@
+﻿#include "Profiler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+
+using namespace OctaCubic;
+
+std::atomic<bool> Profiler::isEnabled_{false};
+constexpr size_t Profiler::eventsPerThread;
+
+namespace
+{
+    // Written only by its thread. The fields are atomic so a reader racing with the writer gets torn events,
+    // which collect() recognizes by the head having moved past them, rather than undefined behaviour.
+    struct EventSlot {
+        std::atomic<const char*> name{nullptr};
+        std::atomic<uint64_t> beginNs{0};
+        std::atomic<uint64_t> endNs{0};
+        std::atomic<uint32_t> depth{0};
+    };
+
+    struct ThreadBuffer {
+        int threadId = 0;
+        std::string threadName; // Guarded by Registry::mutex
+        std::atomic<uint64_t> head{0}; // Events ever recorded
+        EventSlot slots[Profiler::eventsPerThread];
+    };
+
+    struct Registry {
+        std::mutex mutex;
+        std::vector<std::unique_ptr<ThreadBuffer>> threads; // Kept after their thread exits
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    };
+
+    // Never destroyed: threads may still record during static destruction
+    Registry& getRegistry() {
+        static Registry* registry = new Registry;
+        return *registry;
+    }
+
+    thread_local ThreadBuffer* currentBuffer = nullptr;
+    thread_local uint32_t currentDepth = 0;
+
+    ThreadBuffer& getThreadBuffer() {
+        if (!currentBuffer) {
+            Registry& registry = getRegistry();
+            std::lock_guard<std::mutex> lock(registry.mutex);
+            registry.threads.emplace_back(new ThreadBuffer);
+            currentBuffer = registry.threads.back().get();
+            currentBuffer->threadId = static_cast<int>(registry.threads.size());
+            currentBuffer->threadName = "Thread " + std::to_string(currentBuffer->threadId);
+        }
+        return *currentBuffer;
+    }
+
+    // JSON string contents; zone and thread names are plain, but a quote or backslash must not break the file
+    void writeEscaped(FILE* file, const std::string& text) {
+        for (const char c : text) {
+            if (c == '"' || c == '\\') fputc('\\', file);
+            if (static_cast<unsigned char>(c) >= 0x20) fputc(c, file);
+        }
+    }
+}
+
+void Profiler::setEnabled(const bool isEnabled) {
+    isEnabled_.store(isEnabled, std::memory_order_relaxed);
+}
+
+void Profiler::setThreadName(const std::string& name) {
+    ThreadBuffer& buffer = getThreadBuffer();
+    std::lock_guard<std::mutex> lock(getRegistry().mutex);
+    buffer.threadName = name;
+}
+
+uint64_t Profiler::getNowNs() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - getRegistry().start).count());
+}
+
+void Profiler::record(const char* name, const uint64_t beginNs, const uint64_t endNs) {
+    ThreadBuffer& buffer = getThreadBuffer();
+    const uint64_t head = buffer.head.load(std::memory_order_relaxed);
+    EventSlot& slot = buffer.slots[head % eventsPerThread];
+    slot.name.store(name, std::memory_order_relaxed);
+    slot.beginNs.store(beginNs, std::memory_order_relaxed);
+    slot.endNs.store(endNs, std::memory_order_relaxed);
+    slot.depth.store(currentDepth, std::memory_order_relaxed);
+    buffer.head.store(head + 1, std::memory_order_release);
+}
+
+void Profiler::collect(const double lastSeconds, std::vector<ThreadEvents>& threads) {
+    threads.clear();
+    const uint64_t nowNs = getNowNs();
+    const uint64_t windowNs = static_cast<uint64_t>(lastSeconds * 1e9);
+    const uint64_t sinceNs = nowNs > windowNs ? nowNs - windowNs : 0;
+    Registry& registry = getRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    for (const std::unique_ptr<ThreadBuffer>& buffer : registry.threads) {
+        ThreadEvents thread{buffer->threadId, buffer->threadName, {}};
+        const uint64_t head = buffer->head.load(std::memory_order_acquire);
+        const uint64_t first = head > eventsPerThread ? head - eventsPerThread : 0;
+        for (uint64_t i = first; i < head; ++i) {
+            const EventSlot& slot = buffer->slots[i % eventsPerThread];
+            const Event event{
+                slot.name.load(std::memory_order_relaxed),
+                slot.beginNs.load(std::memory_order_relaxed),
+                slot.endNs.load(std::memory_order_relaxed),
+                slot.depth.load(std::memory_order_relaxed)
+            };
+            if (event.endNs >= sinceNs) thread.events.push_back(event);
+        }
+        // Drop what the thread overwrote while it was being copied
+        const uint64_t headAfter = buffer->head.load(std::memory_order_acquire);
+        const uint64_t overwritten = headAfter > eventsPerThread ? headAfter - eventsPerThread : 0;
+        if (overwritten > first) {
+            const uint64_t numTorn = std::min<uint64_t>(overwritten - first, head - first);
+            const uint64_t numOld = head - first - thread.events.size(); // Skipped for ending before sinceNs
+            if (numTorn > numOld)
+                thread.events.erase(thread.events.begin(), thread.events.begin() + (numTorn - numOld));
+        }
+        if (!thread.events.empty()) threads.push_back(std::move(thread));
+    }
+}
+
+bool Profiler::writeChromeTrace(const std::string& path, const double lastSeconds) {
+    std::vector<ThreadEvents> threads;
+    collect(lastSeconds, threads);
+    FILE* file = fopen(path.c_str(), "w");
+    if (!file) return false;
+    fprintf(file, "{\"traceEvents\":[\n");
+    bool isFirst = true;
+    for (const ThreadEvents& thread : threads) {
+        fprintf(file, "%s{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":0,\"tid\":%d,\"args\":{\"name\":\"",
+                isFirst ? "" : ",\n", thread.threadId);
+        writeEscaped(file, thread.threadName);
+        fprintf(file, "\"}}");
+        isFirst = false;
+        for (const Event& event : thread.events) {
+            // Complete events, microseconds
+            fprintf(file, ",\n{\"ph\":\"X\",\"name\":\"");
+            writeEscaped(file, event.name ? event.name : "?");
+            fprintf(file, "\",\"pid\":0,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+                    thread.threadId, (double)event.beginNs / 1000, (double)(event.endNs - event.beginNs) / 1000);
+        }
+    }
+    fprintf(file, "\n]}\n");
+    return fclose(file) == 0;
+}
+
+void ProfileZone::begin() {
+    beginNs_ = Profiler::getNowNs();
+    ++currentDepth;
+}
+
+void ProfileZone::end() {
+    --currentDepth;
+    Profiler::record(name_, beginNs_, Profiler::getNowNs());
+}
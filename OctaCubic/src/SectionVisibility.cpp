@@ -0,0 +1,101 @@
+﻿#include "SectionVisibility.h"
+
+#include <bitset>
+#include <vector>
+
+using namespace OctaCubic;
+
+void SectionVisibility::setConnected(const face a, const face b) {
+    bits_ |= uint64_t{1} << (a * 6 + b);
+    bits_ |= uint64_t{1} << (b * 6 + a);
+}
+
+bool SectionVisibility::isConnected(const face a, const face b) const {
+    return (bits_ >> (a * 6 + b) & 1) != 0;
+}
+
+void SectionVisibility::setAllConnected() {
+    bits_ = (uint64_t{1} << 36) - 1;
+}
+
+SectionVisibility SectionVisibility::compute(const uint8_t* opaque) {
+    SectionVisibility result;
+    std::bitset<numVoxels> visited;
+    std::vector<int> stack;
+    stack.reserve(numVoxels);
+
+    bool hasOpaque = false;
+    for (int i = 0; i < numVoxels && !hasOpaque; ++i)
+        hasOpaque = opaque[i] != 0;
+    if (!hasOpaque) {
+        result.setAllConnected(); // Plain air, e.g. the sky
+        return result;
+    }
+
+    // Flood fill every air region that touches the boundary and connect all faces it touches.
+    // Regions fully enclosed by opaque voxels touch no face, so only boundary voxels need to seed a fill.
+    for (int seed = 0; seed < numVoxels; ++seed) {
+        const int sx = seed % size, sz = seed / size % size, sy = seed / (size * size);
+        const bool onBoundary = sx == 0 || sx == size - 1 || sy == 0 || sy == size - 1 || sz == 0 || sz == size - 1;
+        if (!onBoundary || opaque[seed] || visited[seed]) continue;
+
+        uint8_t touchedFaces = 0;
+        visited[seed] = true;
+        stack.push_back(seed);
+        while (!stack.empty()) {
+            const int i = stack.back();
+            stack.pop_back();
+            const int x = i % size, z = i / size % size, y = i / (size * size);
+            if (x == 0) touchedFaces |= 1 << xNeg;
+            if (x == size - 1) touchedFaces |= 1 << xPos;
+            if (y == 0) touchedFaces |= 1 << yNeg;
+            if (y == size - 1) touchedFaces |= 1 << yPos;
+            if (z == 0) touchedFaces |= 1 << zNeg;
+            if (z == size - 1) touchedFaces |= 1 << zPos;
+
+            const int neighbors[6] = {
+                x > 0 ? i - 1 : -1,
+                x < size - 1 ? i + 1 : -1,
+                z > 0 ? i - size : -1,
+                z < size - 1 ? i + size : -1,
+                y > 0 ? i - size * size : -1,
+                y < size - 1 ? i + size * size : -1,
+            };
+            for (const int n : neighbors) {
+                if (n < 0 || opaque[n] || visited[n]) continue;
+                visited[n] = true;
+                stack.push_back(n);
+            }
+        }
+
+        for (int a = 0; a < 6; ++a)
+            for (int b = a; b < 6; ++b)
+                if ((touchedFaces >> a & 1) && (touchedFaces >> b & 1))
+                    result.setConnected(static_cast<face>(a), static_cast<face>(b));
+    }
+    return result;
+}
+
+face SectionVisibility::opposite(const face f) {
+    switch (f) {
+        case xPos: return xNeg;
+        case xNeg: return xPos;
+        case yPos: return yNeg;
+        case yNeg: return yPos;
+        case zPos: return zNeg;
+        case zNeg: return zPos;
+    }
+    return f;
+}
+
+glm::ivec3 SectionVisibility::faceDirection(const face f) {
+    switch (f) {
+        case xPos: return {1, 0, 0};
+        case xNeg: return {-1, 0, 0};
+        case yPos: return {0, 1, 0};
+        case yNeg: return {0, -1, 0};
+        case zPos: return {0, 0, 1};
+        case zNeg: return {0, 0, -1};
+    }
+    return {0, 0, 0};
+}
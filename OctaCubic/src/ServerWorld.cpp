@@ -0,0 +1,86 @@
+﻿#include "ServerWorld.h"
+
+#include <chrono>
+
+#include "Profiler.h"
+#include "Simulation.h"
+
+namespace OctaCubic
+{
+    constexpr ServerWorld::PlayerId ServerWorld::invalidPlayer;
+
+    ServerWorld::ServerWorld(const int seed, const double tickRate, const int viewDistance, JobSystem* jobSystem)
+        : clock_(tickRate), viewDistance_(viewDistance) {
+        world_.setSeed(seed);
+        world_.bindJobSystem(jobSystem);
+    }
+
+    ServerWorld::PlayerId ServerWorld::addPlayer(const glm::vec3 spawn) {
+        PlayerId id = 0;
+        while (id < slots_.size() && slots_[id].player) ++id;
+        if (id == slots_.size()) slots_.emplace_back();
+        Slot& slot = slots_[id];
+        slot.player.reset(new Player);
+        slot.player->world_ptr = &world_;
+        slot.player->location = slot.player->previousLocation = spawn;
+        slot.pendingInput = PlayerInput{};
+        slot.isLoaded = false;
+        loadChunks(slot);
+        ++numPlayers_;
+        return id;
+    }
+
+    void ServerWorld::removePlayer(const PlayerId id) {
+        if (id >= slots_.size() || !slots_[id].player) return;
+        slots_[id].player.reset();
+        --numPlayers_;
+    }
+
+    void ServerWorld::submitInput(const PlayerId id, const PlayerInput& input) {
+        if (id >= slots_.size() || !slots_[id].player) return;
+        PlayerInput& pending = slots_[id].pendingInput;
+        const PlayerInput previous = pending;
+        pending = input;
+        pending.isJumping |= previous.isJumping;
+        pending.isBreakingBlock |= previous.isBreakingBlock;
+        pending.isPlacingBlock |= previous.isPlacingBlock;
+        pending.isTogglingFloating |= previous.isTogglingFloating;
+    }
+
+    const Player* ServerWorld::getPlayer(const PlayerId id) const {
+        return id < slots_.size() ? slots_[id].player.get() : nullptr;
+    }
+
+    int ServerWorld::update(const double now) {
+        PROFILE_ZONE("ServerWorld::update");
+        const auto updateStart = std::chrono::steady_clock::now();
+        const int numTicks = clock_.advance(now);
+        const float tickSeconds = (float)clock_.getTickSeconds();
+        for (int i = 0; i < numTicks; ++i) {
+            for (Slot& slot : slots_) {
+                if (!slot.player) continue;
+                Simulation::tickPlayer(world_, *slot.player, slot.pendingInput, tickSeconds);
+                PlayerInput& pending = slot.pendingInput;
+                pending.isJumping = pending.isBreakingBlock = pending.isPlacingBlock = pending.isTogglingFloating = false;
+            }
+        }
+        for (Slot& slot : slots_)
+            if (slot.player) loadChunks(slot);
+        lastUpdateMs_ = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - updateStart).count();
+        return numTicks;
+    }
+
+    void ServerWorld::loadChunks(Slot& slot) {
+        const glm::ivec3 center = World::insideBlockCoordinates(slot.player->location);
+        // Edits re-mesh chunks wherever the player stands, so meshing looks every time
+        if (isMeshingEnabled_) {
+            world_.updateChunks(center, viewDistance_, chunksInView_);
+            return;
+        }
+        const glm::ivec3 centerChunk = World::getCoordChunk(center);
+        if (slot.isLoaded && centerChunk == slot.loadedCenter) return;
+        world_.generateChunks(centerChunk, viewDistance_);
+        slot.loadedCenter = centerChunk;
+        slot.isLoaded = true;
+    }
+}
@@ -1,10 +1,64 @@
 ﻿#include "Shader.h"
 
-#include <iostream>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+#include "FrameUniforms.h"
+#include "JobSystem.h"
+#include "Log.h"
 
 using namespace OctaCubic;
 
 Shader* Shader::activeShader = nullptr;
+int Shader::numCacheHits = 0;
+int Shader::numCacheMisses = 0;
+JobSystem* Shader::jobSystem_ = nullptr;
+
+namespace
+{
+    const char* const cacheDirectory = "shader_cache";
+    constexpr uint32 cacheFileMagic = 0x4F435342; // "OCSB"
+
+    // Prepended to a program binary on disk
+    struct CacheFileHeader {
+        uint32 magic;
+        uint32 binaryFormat;
+        uint64 key;
+        uint32 length;
+    };
+
+    // 64-bit FNV-1a
+    uint64 hashBytes(const char* data, const size_t size, uint64 hash = 14695981039346656037ull) {
+        for (size_t i = 0; i < size; ++i) {
+            hash ^= static_cast<uint8>(data[i]);
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+
+    uint64 hashGLString(const GLenum name, const uint64 hash) {
+        const char* str = reinterpret_cast<const char*>(glGetString(name));
+        return str ? hashBytes(str, strlen(str), hash) : hash;
+    }
+
+    void writeCacheFile(const std::string& path, const CacheFileHeader& header, const std::vector<char>& binary) {
+#ifdef _WIN32
+        _mkdir(cacheDirectory);
+#else
+        mkdir(cacheDirectory, 0755);
+#endif
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        if (!file) return;
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(binary.data(), static_cast<std::streamsize>(binary.size()));
+    }
+}
 
 Shader::Shader(const char* vertexShaderPath, const char* fragmentShaderPath) {
     compile(vertexShaderPath, fragmentShaderPath);
@@ -12,71 +66,122 @@ Shader::Shader(const char* vertexShaderPath, const char* fragmentShaderPath) {
 }
 
 const std::string Shader::readFile(const char* path) {
-    std::string line;
-    std::string code;
-    std::ifstream file;
-    file.open(path);
-    std::cout << "Loading: " << path;
-
-    while (std::getline(file, line)) {
-        code += line + "\n";
+    // One read of the whole file instead of line by line
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file) {
+        LOG_ERROR("Shader", "File not found '%s'", path);
+        return std::string();
     }
-    file.close();
+    std::string code(static_cast<size_t>(file.tellg()), '\0');
+    file.seekg(0);
+    file.read(&code[0], static_cast<std::streamsize>(code.size()));
     return code;
 }
 
 void Shader::compile(const char* vertexShaderPath, const char* fragmentShaderPath) {
+    beginCompile(vertexShaderPath, fragmentShaderPath);
+    finishCompile();
+}
+
+void Shader::beginCompile(const char* vertexShaderPath, const char* fragmentShaderPath) {
+    const std::string vshStr = readFile(vertexShaderPath);
+    const std::string fshStr = readFile(fragmentShaderPath);
+    name_ = std::string(vertexShaderPath) + " + " + fragmentShaderPath;
+    cacheKey_ = computeCacheKey(vshStr, fshStr);
+
+    programId = glCreateProgram();
+    isLoadedFromCache_ = loadProgramBinary();
+    if (isLoadedFromCache_) {
+        numCacheHits++;
+        return;
+    }
+    numCacheMisses++;
+
     // Adapted from https://learnopengl.com/code_viewer_gh.php?code=src/1.getting_started/2.2.hello_triangle_indexed/hello_triangle_indexed.cpp
-    // Vertex Shader
-    const std::string& vshStr = readFile(vertexShaderPath);
+    // Status is only queried in finishCompile(), so the driver can compile in the background meanwhile
     const char* vsh = vshStr.c_str();
-    uint32 vertexShader = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vertexShader, 1, &vsh, nullptr);
-    glCompileShader(vertexShader);
-    // check for shader compile errors
-    int success;
-    char infoLog[512];
-    glGetShaderiv(vertexShader, GL_COMPILE_STATUS, &success);
-    if (!success) {
-        glGetShaderInfoLog(vertexShader, 512, nullptr, infoLog);
-        printf("\nERROR::SHADER::VERTEX::COMPILATION_FAILED\n '%s'\n", infoLog);
-        glDeleteShader(vertexShader);
-    }
-    printf("  Success!\n");
+    pendingVertexShader_ = glCreateShader(GL_VERTEX_SHADER);
+    glShaderSource(pendingVertexShader_, 1, &vsh, nullptr);
+    glCompileShader(pendingVertexShader_);
 
-    // Fragment Shader
-    const std::string& fshStr = readFile(fragmentShaderPath);
     const char* fsh = fshStr.c_str();
-    uint32 fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragmentShader, 1, &fsh, nullptr);
-    glCompileShader(fragmentShader);
-    // check for shader compile errors
-    glGetShaderiv(fragmentShader, GL_COMPILE_STATUS, &success);
-    if (!success) {
-        glGetShaderInfoLog(fragmentShader, 512, nullptr, infoLog);
-        printf("\nERROR::SHADER::FRAGMENT::COMPILATION_FAILED\n '%s'\n", infoLog);
-        glDeleteShader(fragmentShader);
-    }
-    printf("  Success!\n");
+    pendingFragmentShader_ = glCreateShader(GL_FRAGMENT_SHADER);
+    glShaderSource(pendingFragmentShader_, 1, &fsh, nullptr);
+    glCompileShader(pendingFragmentShader_);
 
     // link shaders
-    programId = glCreateProgram();
-    glAttachShader(programId, vertexShader);
-    glAttachShader(programId, fragmentShader);
+    glAttachShader(programId, pendingVertexShader_);
+    glAttachShader(programId, pendingFragmentShader_);
+    glProgramParameteri(programId, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
     glLinkProgram(programId);
-    // check for linking errors
-    glGetProgramiv(programId, GL_LINK_STATUS, &success);
-    if (!success) {
-        glGetProgramInfoLog(programId, 512, nullptr, infoLog);
-        printf("ERROR::SHADER::PROGRAM::LINKING_FAILED\n '%s'\n", infoLog);
-        glDeleteProgram(programId);
+}
+
+void Shader::finishCompile() {
+    if (isLoadedFromCache_) {
+        LOG_INFO("Shader", "%s: loaded from cache", name_);
     }
+    else {
+        // check for shader compile errors
+        int success;
+        char infoLog[512];
+        glGetShaderiv(pendingVertexShader_, GL_COMPILE_STATUS, &success);
+        if (!success) {
+            glGetShaderInfoLog(pendingVertexShader_, 512, nullptr, infoLog);
+            LOG_ERROR("Shader", "%s: vertex compilation failed\n%s", name_, infoLog);
+        }
+        glGetShaderiv(pendingFragmentShader_, GL_COMPILE_STATUS, &success);
+        if (!success) {
+            glGetShaderInfoLog(pendingFragmentShader_, 512, nullptr, infoLog);
+            LOG_ERROR("Shader", "%s: fragment compilation failed\n%s", name_, infoLog);
+        }
+        // check for linking errors
+        glGetProgramiv(programId, GL_LINK_STATUS, &success);
+        if (!success) {
+            glGetProgramInfoLog(programId, 512, nullptr, infoLog);
+            LOG_ERROR("Shader", "%s: linking failed\n%s", name_, infoLog);
+        }
+
+        // After successful link, detach shaders and destroy when not needed.
+        glDetachShader(programId, pendingVertexShader_);
+        glDetachShader(programId, pendingFragmentShader_);
+        glDeleteShader(pendingVertexShader_);
+        glDeleteShader(pendingFragmentShader_);
+        pendingVertexShader_ = pendingFragmentShader_ = 0;
 
-    // After successful link, detach shaders and destroy when not needed.
-    glDetachShader(programId, vertexShader);
-    glDetachShader(programId, fragmentShader);
-    glDeleteShader(vertexShader);
-    glDeleteShader(fragmentShader);
+        if (success) {
+            if (jobSystem_) jobSystem_->submitGL([this] { saveProgramBinary(); });
+            else saveProgramBinary();
+            LOG_INFO("Shader", "%s: compiled", name_);
+        }
+    }
+
+    // Per-frame values come from the shared uniform buffer
+    const GLuint frameBlock = glGetUniformBlockIndex(programId, FrameUniformBuffer::blockName);
+    if (frameBlock != GL_INVALID_INDEX)
+        glUniformBlockBinding(programId, frameBlock, FrameUniformBuffer::bindingPoint);
+    cacheUniformLocations();
+}
+
+bool Shader::enableParallelCompile(void* (*loadProc)(const char* name)) {
+    bool hasExtension = false;
+    int numExtensions = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &numExtensions);
+    for (int i = 0; i < numExtensions && !hasExtension; ++i) {
+        const char* extension = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, (GLuint)i));
+        hasExtension = strcmp(extension, "GL_KHR_parallel_shader_compile") == 0 ||
+            strcmp(extension, "GL_ARB_parallel_shader_compile") == 0;
+    }
+    if (!hasExtension) return false;
+
+    using MaxShaderCompilerThreadsProc = void (*)(GLuint count);
+    auto maxShaderCompilerThreads =
+        reinterpret_cast<MaxShaderCompilerThreadsProc>(loadProc("glMaxShaderCompilerThreadsKHR"));
+    if (!maxShaderCompilerThreads)
+        maxShaderCompilerThreads = reinterpret_cast<MaxShaderCompilerThreadsProc>(
+            loadProc("glMaxShaderCompilerThreadsARB"));
+    if (!maxShaderCompilerThreads) return false;
+    maxShaderCompilerThreads(0xFFFFFFFF); // Let the driver pick the number of threads
+    return true;
 }
 
 void Shader::use() {
@@ -84,27 +189,108 @@ void Shader::use() {
     activeShader = this;
 }
 
+int Shader::getUniformLocation(const char* uniformName) const {
+    const auto it = uniformLocations_.find(uniformName);
+    return it != uniformLocations_.end() ? it->second : -1;
+}
+
 // Link Uniforms
 void Shader::setBool(const char* uniformName, bool val) {
     setInt(uniformName, val);
 }
 
 void Shader::setInt(const char* uniformName, int val) {
-    glUniform1i(glGetUniformLocation(programId, uniformName), val);
+    glProgramUniform1i(programId, getUniformLocation(uniformName), val);
 }
 
 void Shader::setFloat(const char* uniformName, float val) {
-    glUniform1f(glGetUniformLocation(programId, uniformName), val);
+    glProgramUniform1f(programId, getUniformLocation(uniformName), val);
 }
 
 void Shader::setVec3(const char* uniformName, const glm::vec3 &vec) {
-    glUniform3fv(glGetUniformLocation(programId, uniformName), 1, glm::value_ptr(vec));
+    glProgramUniform3fv(programId, getUniformLocation(uniformName), 1, glm::value_ptr(vec));
 }
 
 void Shader::setVec4(const char* uniformName, const glm::vec4 &vec) {
-    glUniform4fv(glGetUniformLocation(programId, uniformName), 1, glm::value_ptr(vec));
+    glProgramUniform4fv(programId, getUniformLocation(uniformName), 1, glm::value_ptr(vec));
 }
 
 void Shader::setMat4(const char* uniformName, const glm::mat4 &mat) {
-    glUniformMatrix4fv(glGetUniformLocation(programId, uniformName), 1, GL_FALSE, glm::value_ptr(mat));
+    glProgramUniformMatrix4fv(programId, getUniformLocation(uniformName), 1, GL_FALSE, glm::value_ptr(mat));
+}
+
+void Shader::cacheUniformLocations() {
+    uniformLocations_.clear();
+    int numUniforms = 0, maxNameLength = 0;
+    glGetProgramiv(programId, GL_ACTIVE_UNIFORMS, &numUniforms);
+    glGetProgramiv(programId, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxNameLength);
+    std::string name(maxNameLength, '\0');
+    for (int i = 0; i < numUniforms; ++i) {
+        GLsizei length = 0;
+        GLint size = 0;
+        GLenum type = 0;
+        glGetActiveUniform(programId, (GLuint)i, maxNameLength, &length, &size, &type, &name[0]);
+        const std::string uniformName(name.c_str(), length);
+        const int location = glGetUniformLocation(programId, uniformName.c_str());
+        if (location < 0) continue; // Members of uniform blocks have no location
+        uniformLocations_[uniformName] = location;
+        // Arrays are reported as "name[0]"; also accept the plain name
+        const size_t bracket = uniformName.find('[');
+        if (bracket != std::string::npos) uniformLocations_[uniformName.substr(0, bracket)] = location;
+    }
+}
+
+/* Private members */
+
+uint64 Shader::computeCacheKey(const std::string& vertexSource, const std::string& fragmentSource) {
+    // A binary is only valid for the exact sources on the exact driver that produced it
+    uint64 hash = hashBytes(vertexSource.data(), vertexSource.size());
+    hash = hashBytes("\0", 1, hash); // Keep "ab" + "c" apart from "a" + "bc"
+    hash = hashBytes(fragmentSource.data(), fragmentSource.size(), hash);
+    hash = hashGLString(GL_VENDOR, hash);
+    hash = hashGLString(GL_RENDERER, hash);
+    hash = hashGLString(GL_VERSION, hash);
+    return hash;
+}
+
+std::string Shader::getCachePath() const {
+    char fileName[64];
+    snprintf(fileName, sizeof(fileName), "/%016llx.bin", static_cast<unsigned long long>(cacheKey_));
+    return cacheDirectory + std::string(fileName);
+}
+
+bool Shader::loadProgramBinary() {
+    std::ifstream file(getCachePath(), std::ios::binary);
+    if (!file) return false;
+    CacheFileHeader header{};
+    file.read(reinterpret_cast<char*>(&header), sizeof(header));
+    if (!file || header.magic != cacheFileMagic || header.key != cacheKey_) return false;
+    std::vector<char> binary(header.length);
+    file.read(binary.data(), static_cast<std::streamsize>(binary.size()));
+    if (!file) return false;
+
+    glProgramBinary(programId, header.binaryFormat, binary.data(), (GLsizei)binary.size());
+    int success = 0;
+    glGetProgramiv(programId, GL_LINK_STATUS, &success);
+    // Rejected binaries (e.g. after a driver update with an unchanged version string) fall back to compiling
+    return success != 0;
+}
+
+void Shader::saveProgramBinary() const {
+    int length = 0;
+    glGetProgramiv(programId, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) return; // Driver does not support program binaries
+    std::vector<char> binary(length);
+    GLenum binaryFormat = 0;
+    glGetProgramBinary(programId, length, nullptr, &binaryFormat, binary.data());
+
+    const CacheFileHeader header{cacheFileMagic, binaryFormat, cacheKey_, (uint32)length};
+    if (!jobSystem_) {
+        writeCacheFile(getCachePath(), header, binary);
+        return;
+    }
+    // The disk write stays off the GL thread
+    jobSystem_->submit([path = getCachePath(), header, binary = std::move(binary)] {
+        writeCacheFile(path, header, binary);
+    }, nullptr, JobSystem::low);
 }
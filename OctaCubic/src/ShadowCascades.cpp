@@ -0,0 +1,224 @@
+﻿#include "ShadowCascades.h"
+
+#include <algorithm>
+#include <cmath>
+#include <glad/glad.h>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "MemoryStats.h"
+
+using namespace OctaCubic;
+
+constexpr int ShadowCascades::maxCascades;
+
+ShadowCascades::ShadowCascades(const int numCascades, const int resolution)
+    : numCascades_(glm::clamp(numCascades, 1, maxCascades)), resolution_(resolution) {
+    for (glm::mat4& m : lightSpaceMatrices_) m = glm::mat4(1.0f);
+}
+
+void ShadowCascades::initGPU() {
+    if (texture_ == 0) glGenTextures(1, &texture_);
+    if (fbo_ == 0) glGenFramebuffers(1, &fbo_);
+
+    glBindTexture(GL_TEXTURE_2D_ARRAY, texture_);
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT24, resolution_, resolution_, maxCascades, 0,
+                 GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+    // Called again on resolution changes, which reallocate the same texture
+    if (accountedBytes_ == 0) MemoryStats::add(MemoryStats::gpuShadowMaps, (int64_t)getMemoryBytes());
+    else MemoryStats::resize(MemoryStats::gpuShadowMaps, (int64_t)accountedBytes_, (int64_t)getMemoryBytes());
+    accountedBytes_ = getMemoryBytes();
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    // Samples outside a cascade read depth 1, i.e. lit
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+    constexpr float border[] = {1.0f, 1.0f, 1.0f, 1.0f};
+    glTexParameterfv(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BORDER_COLOR, border);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo_);
+    glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, texture_, 0, 0);
+    glDrawBuffer(GL_NONE);
+    glReadBuffer(GL_NONE);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    invalidate();
+}
+
+void ShadowCascades::setResolution(const int resolution) {
+    if (resolution == resolution_) return;
+    resolution_ = resolution;
+    if (texture_ != 0) initGPU();
+}
+
+void ShadowCascades::setNumCascades(const int numCascades) {
+    numCascades_ = glm::clamp(numCascades, 1, maxCascades);
+    invalidate();
+}
+
+void ShadowCascades::update(const glm::mat4& camView, const float fovY, const float aspect, const float nearZ,
+                            const float farZ, const glm::vec3& lightDir, const float casterDepth) {
+    const glm::mat4 camToWorld = glm::inverse(camView);
+    const float tanY = std::tan(fovY * .5f);
+    const float tanX = tanY * aspect;
+    const glm::vec3 dir = glm::normalize(lightDir);
+    const glm::vec3 up = std::abs(dir.y) > .99f ? glm::vec3(0, 0, 1) : glm::vec3(0, 1, 0);
+    // Light space without a translation: a point that doesn't move keeps its light space coordinates
+    const glm::mat4 lightRotation = glm::lookAt(glm::vec3(0.0f), dir, up);
+    if (dir != fitLightDir_ || casterDepth != fitCasterDepth_) {
+        for (float& extent : fitExtents_) extent = 0;
+        fitLightDir_ = dir;
+        fitCasterDepth_ = casterDepth;
+    }
+
+    float sliceNear = nearZ;
+    for (int i = 0; i < numCascades_; ++i) {
+        // Practical split scheme: blend of logarithmic and uniform distribution
+        const float t = static_cast<float>(i + 1) / static_cast<float>(numCascades_);
+        const float logSplit = nearZ * std::pow(farZ / nearZ, t);
+        const float uniformSplit = nearZ + (farZ - nearZ) * t;
+        const float sliceFar = splitLambda * logSplit + (1 - splitLambda) * uniformSplit;
+        splitDistances_[i] = sliceFar;
+
+        // Bounding sphere of the slice: its size does not change as the camera rotates, so shadow edges don't swim
+        glm::vec3 corners[8];
+        glm::vec3 center(0.0f);
+        for (int c = 0; c < 8; ++c) {
+            const float z = c & 4 ? sliceFar : sliceNear;
+            const glm::vec3 cornerView(z * tanX * (c & 1 ? 1.f : -1.f), z * tanY * (c & 2 ? 1.f : -1.f), -z);
+            corners[c] = glm::vec3(camToWorld * glm::vec4(cornerView, 1.0f));
+            center += corners[c];
+        }
+        center /= 8.0f;
+        float radius = 0;
+        for (const glm::vec3& corner : corners) radius = std::max(radius, glm::length(corner - center));
+        radius = std::ceil(radius);
+
+        // Keep the box while the sphere is inside it and not much smaller; then the matrix, and what the cascade
+        // has cached, stay valid as the camera moves
+        const glm::vec3 centerLight(lightRotation * glm::vec4(center, 1.0f));
+        glm::vec3& fitCenter = fitCenters_[i];
+        float& fitExtent = fitExtents_[i];
+        const glm::vec3 offset = glm::abs(centerLight - fitCenter);
+        const bool isInside = std::max(offset.x, std::max(offset.y, offset.z)) + radius <= fitExtent;
+        if (!isInside || radius * (1 + fitSlack) < fitExtent * .5f) {
+            fitExtent = radius * (1 + fitSlack);
+            // Snapped to whole texels of the new box, so refits shift the map by whole texels
+            const float texel = 2 * fitExtent / (float)resolution_;
+            fitCenter = glm::vec3(std::round(centerLight.x / texel) * texel, std::round(centerLight.y / texel) * texel,
+                                  centerLight.z);
+        }
+
+        // Looking along -z: the near plane is the side towards the light
+        const glm::mat4 lightProjection = glm::ortho(fitCenter.x - fitExtent, fitCenter.x + fitExtent,
+                                                     fitCenter.y - fitExtent, fitCenter.y + fitExtent,
+                                                     -(fitCenter.z + fitExtent + casterDepth), -(fitCenter.z - fitExtent));
+        lightSpaceMatrices_[i] = lightProjection * lightRotation;
+        sliceNear = sliceFar;
+    }
+}
+
+ShadowCascades::CascadeUpdate ShadowCascades::planUpdate(const int cascade, std::vector<ShadowCaster>& casters) {
+    std::sort(casters.begin(), casters.end(),
+              [](const ShadowCaster& a, const ShadowCaster& b) { return a.id < b.id; });
+    const glm::mat4& lightSpaceMatrix = lightSpaceMatrices_[cascade];
+    std::vector<ShadowCaster>& rendered = renderedCasters_[cascade];
+
+    CascadeUpdate update;
+    if (!isCacheValid_[cascade] || renderedMatrices_[cascade] != lightSpaceMatrix) {
+        update.kind = full;
+    }
+    else {
+        // Light space rectangle (NDC) covering every caster that appeared, disappeared or changed
+        glm::vec2 dirtyMin(1.0f), dirtyMax(-1.0f);
+        const auto addDirty = [&](const ShadowCaster& caster) {
+            for (int c = 0; c < 8; ++c) {
+                const glm::vec3 corner(c & 1 ? caster.boundsMax.x : caster.boundsMin.x,
+                                       c & 2 ? caster.boundsMax.y : caster.boundsMin.y,
+                                       c & 4 ? caster.boundsMax.z : caster.boundsMin.z);
+                const glm::vec4 p = lightSpaceMatrix * glm::vec4(corner, 1.0f);
+                dirtyMin = glm::min(dirtyMin, glm::vec2(p.x, p.y));
+                dirtyMax = glm::max(dirtyMax, glm::vec2(p.x, p.y));
+            }
+        };
+        size_t i = 0, j = 0;
+        while (i < rendered.size() || j < casters.size()) {
+            if (j == casters.size() || (i < rendered.size() && rendered[i].id < casters[j].id)) {
+                addDirty(rendered[i++]);
+            }
+            else if (i == rendered.size() || casters[j].id < rendered[i].id) {
+                addDirty(casters[j++]);
+            }
+            else {
+                if (rendered[i].version != casters[j].version) {
+                    addDirty(rendered[i]);
+                    addDirty(casters[j]);
+                }
+                i++;
+                j++;
+            }
+        }
+        if (dirtyMin.x <= dirtyMax.x) {
+            // To texels, one texel of padding for rasterization rules
+            const int x0 = glm::clamp((int)std::floor((dirtyMin.x * .5f + .5f) * resolution_) - 1, 0, resolution_);
+            const int y0 = glm::clamp((int)std::floor((dirtyMin.y * .5f + .5f) * resolution_) - 1, 0, resolution_);
+            const int x1 = glm::clamp((int)std::ceil((dirtyMax.x * .5f + .5f) * resolution_) + 1, 0, resolution_);
+            const int y1 = glm::clamp((int)std::ceil((dirtyMax.y * .5f + .5f) * resolution_) + 1, 0, resolution_);
+            if (x1 > x0 && y1 > y0) {
+                update.kind = partial;
+                update.x = x0;
+                update.y = y0;
+                update.width = x1 - x0;
+                update.height = y1 - y0;
+                if ((float)update.width * (float)update.height > maxPartialArea * (float)resolution_ * resolution_)
+                    update.kind = full;
+            }
+        }
+    }
+
+    if (update.kind == full) {
+        update.x = update.y = 0;
+        update.width = update.height = resolution_;
+    }
+    if (update.kind != cached) {
+        // Map the rectangle to [-1, 1] so a Frustum built from regionMatrix only keeps casters touching it
+        const float ndcX0 = (float)update.x / resolution_ * 2 - 1, ndcX1 = (float)(update.x + update.width) / resolution_ * 2 - 1;
+        const float ndcY0 = (float)update.y / resolution_ * 2 - 1, ndcY1 = (float)(update.y + update.height) / resolution_ * 2 - 1;
+        glm::mat4 toRegion(1.0f);
+        toRegion[0][0] = 2 / (ndcX1 - ndcX0);
+        toRegion[1][1] = 2 / (ndcY1 - ndcY0);
+        toRegion[3][0] = -(ndcX1 + ndcX0) / (ndcX1 - ndcX0);
+        toRegion[3][1] = -(ndcY1 + ndcY0) / (ndcY1 - ndcY0);
+        update.regionMatrix = toRegion * lightSpaceMatrix;
+    }
+
+    isCacheValid_[cascade] = true;
+    renderedMatrices_[cascade] = lightSpaceMatrix;
+    rendered = casters;
+    lastUpdateKinds_[cascade] = update.kind;
+    ++updateCounts_[cascade][update.kind];
+    return update;
+}
+
+void ShadowCascades::invalidate() {
+    for (bool& valid : isCacheValid_) valid = false;
+    for (float& extent : fitExtents_) extent = 0;
+}
+
+void ShadowCascades::beginCascade(const int cascade, const CascadeUpdate& update) const {
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo_);
+    glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, texture_, 0, cascade);
+    glViewport(0, 0, resolution_, resolution_);
+    if (update.kind == partial) {
+        glEnable(GL_SCISSOR_TEST);
+        glScissor(update.x, update.y, update.width, update.height);
+    }
+    glClear(GL_DEPTH_BUFFER_BIT);
+}
+
+void ShadowCascades::endCascade(const CascadeUpdate& update) const {
+    if (update.kind == partial) glDisable(GL_SCISSOR_TEST);
+}
+
+size_t ShadowCascades::getMemoryBytes() const {
+    return static_cast<size_t>(resolution_) * resolution_ * maxCascades * 4;
+}
@@ -0,0 +1,188 @@
+﻿#include "Simulation.h"
+
+#include <algorithm>
+#include <chrono>
+
+#include "Log.h"
+#include "Profiler.h"
+
+namespace OctaCubic
+{
+    namespace
+    {
+        // Q/E; the old one degree per frame at 60 fps, whatever the tick rate
+        constexpr float sunDegreesPerSecond = 60.0f;
+    }
+
+    Simulation::Simulation(World& world, Player& player, const double tickRate, const int viewDistance)
+        : world_(world), player_(player), clock_(tickRate), viewDistance_(viewDistance) {}
+
+    Simulation::~Simulation() {
+        stop();
+    }
+
+    void Simulation::start() {
+        if (isRunning_) return;
+        isRunning_ = true;
+        thread_ = std::thread(&Simulation::run, this);
+    }
+
+    void Simulation::stop() {
+        isRunning_ = false;
+        if (thread_.joinable()) thread_.join();
+    }
+
+    double Simulation::getClockSeconds() {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    void Simulation::submitInput(const PlayerInput& input) {
+        std::lock_guard<std::mutex> lock(inputMutex_);
+        const PlayerInput previous = pendingInput_;
+        pendingInput_ = input;
+        pendingInput_.isJumping |= previous.isJumping;
+        pendingInput_.isBreakingBlock |= previous.isBreakingBlock;
+        pendingInput_.isPlacingBlock |= previous.isPlacingBlock;
+        pendingInput_.isTogglingFloating |= previous.isTogglingFloating;
+    }
+
+    void Simulation::update(const double now) {
+        PROFILE_ZONE("Simulation::update");
+        const auto updateStart = std::chrono::steady_clock::now();
+        const int numTicks = clock_.advance(now);
+        if (numTicks > 0) {
+            PlayerInput input;
+            {
+                std::lock_guard<std::mutex> lock(inputMutex_);
+                input = pendingInput_;
+                pendingInput_.isJumping = pendingInput_.isBreakingBlock = false;
+                pendingInput_.isPlacingBlock = pendingInput_.isTogglingFloating = false;
+            }
+            for (int i = 0; i < numTicks; ++i) {
+                if (replay_) {
+                    // Past the end the state stays as recorded
+                    PlayerInput replayed;
+                    if (isReplayFinished_ || !replay_->next(replayed)) {
+                        isReplayFinished_ = true;
+                        break;
+                    }
+                    tick(replayed);
+                    if (recorder_) recorder_->record(replayed);
+                    continue;
+                }
+                tick(input);
+                if (recorder_) recorder_->record(input);
+                input.isJumping = input.isBreakingBlock = input.isPlacingBlock = input.isTogglingFloating = false;
+            }
+        }
+        if (chunkClient_) chunkClient_->update(world_, player_.location);
+        world_.updateChunks(World::insideBlockCoordinates(player_.location), viewDistance_,
+                            snapshots_.getWriteBuffer().chunksInView);
+        publishSnapshot(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - updateStart).count());
+    }
+
+    void Simulation::run() {
+        Profiler::setThreadName("Simulation");
+        while (isRunning_) {
+            update(getClockSeconds());
+            // Nothing to do before the next tick is due
+            std::this_thread::sleep_for(std::chrono::duration<double>(clock_.getTimeToNextTick()));
+        }
+    }
+
+    void Simulation::tick(const PlayerInput& input) {
+        PROFILE_ZONE("Simulation::tick");
+        // Sun rotation (Q/E) advances per tick, not per frame
+        if (input.sunRotation)
+            lightPosRotZ_ += (float)input.sunRotation * sunDegreesPerSecond * (float)clock_.getTickSeconds();
+        lightPosRotZ_ = remainder(lightPosRotZ_, 360);
+
+        // Gravity and collision against blank chunks would drop the player through the terrain still on its way:
+        // only look around until every chunk this tick can reach has come from the server. Once the connection
+        // is lost nothing more will come, so the player is let go on whatever has arrived.
+        isWaitingForChunks_ = false;
+        if (chunkClient_ && !chunkClient_->isConnected()) {
+            if (!isDisconnectReported_) {
+                LOG_WARNING("Simulation", "Lost the server, no longer waiting for chunks");
+                isDisconnectReported_ = true;
+            }
+        }
+        else if (chunkClient_ && !hasChunksInReach((float)clock_.getTickSeconds())) {
+            isWaitingForChunks_ = true;
+            player_.setRotation(input.yaw, input.pitch);
+            player_.previousLocation = player_.location;
+            return;
+        }
+        tickPlayer(world_, player_, input, (float)clock_.getTickSeconds());
+    }
+
+    bool Simulation::hasChunksInReach(const float tickSeconds) const {
+        // Forward and sideways at sprint speed together; chunks are whole columns, so up and down never leave one
+        const float reach = 2 * std::max(player_.speedWalk, player_.speedSprint) * tickSeconds;
+        const Aabb box = player_.getBoundingBox();
+        const glm::ivec3 minChunk = World::getCoordChunk(box.min - glm::vec3{reach, 0, reach});
+        const glm::ivec3 maxChunk = World::getCoordChunk(box.max + glm::vec3{reach, 0, reach});
+        for (int x = minChunk.x; x <= maxChunk.x; ++x)
+            for (int z = minChunk.z; z <= maxChunk.z; ++z)
+                if (!chunkClient_->hasChunk({x, 0, z})) return false;
+        return true;
+    }
+
+    void Simulation::tickPlayer(World& world, Player& player, const PlayerInput& input, const float tickSeconds) {
+        player.tick(input, tickSeconds);
+        // Player Aiming
+        const glm::vec3 posPlayerEye = player.location + glm::vec3{0, player.eyeHeight, 0};
+        const CoordinatesAndFace aimBlockInfo = world.lineTraceToFace(posPlayerEye, player.directionLooking, 10.0f);
+        player.isAimingAtSomeBlock = aimBlockInfo.isHit;
+        player.aimingAtBlockCoord = glm::vec3{
+            static_cast<float>(aimBlockInfo.x),
+            static_cast<float>(aimBlockInfo.y),
+            static_cast<float>(aimBlockInfo.z)
+        };
+        player.aimingAtBlockFace = aimBlockInfo.f;
+        // Destroy & place block
+        if (!player.isAimingAtSomeBlock) return;
+        const int aX = aimBlockInfo.x;
+        const int aY = aimBlockInfo.y;
+        const int aZ = aimBlockInfo.z;
+        if (input.isBreakingBlock) {
+            world.setBlockId(glm::ivec3(aX, aY, aZ), 0);
+        }
+        if (input.isPlacingBlock) {
+            int pX = aX, pY = aY, pZ = aZ;
+            switch (aimBlockInfo.f) {
+                case xPos: pX += 1; break;
+                case xNeg: pX -= 1; break;
+                case yPos: pY += 1; break;
+                case yNeg: pY -= 1; break;
+                case zPos: pZ += 1; break;
+                case zNeg: pZ -= 1; break;
+            }
+            world.setBlockId(glm::ivec3(pX, pY, pZ), 2);
+        }
+    }
+
+    void Simulation::publishSnapshot(const double updateMs) {
+        FrameSnapshot& snapshot = snapshots_.getWriteBuffer();
+        snapshot.tick = clock_.getTickCount();
+        snapshot.tickTime = clock_.getLastTickTime();
+        snapshot.tickSeconds = clock_.getTickSeconds();
+        snapshot.droppedTicks = clock_.getDroppedTicks();
+        snapshot.updateMs = updateMs;
+        snapshot.playerPreviousLocation = player_.previousLocation;
+        snapshot.playerLocation = player_.location;
+        snapshot.playerEyeHeight = player_.eyeHeight;
+        snapshot.playerYaw = player_.yaw;
+        snapshot.playerPitch = player_.pitch;
+        snapshot.playerDirectionLooking = player_.directionLooking;
+        snapshot.isAimingAtSomeBlock = player_.isAimingAtSomeBlock;
+        snapshot.aimingAtBlockCoord = glm::ivec3{player_.aimingAtBlockCoord};
+        snapshot.aimingAtBlockFace = player_.aimingAtBlockFace;
+        snapshot.lightPosRotZ = lightPosRotZ_;
+        snapshot.viewCenter = World::insideBlockCoordinates(player_.location);
+        snapshot.viewDistance = viewDistance_;
+        snapshot.isWaitingForChunks = isWaitingForChunks_;
+        snapshot.isServerLost = isDisconnectReported_;
+        snapshots_.publish();
+    }
+}
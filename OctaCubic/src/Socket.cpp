@@ -0,0 +1,172 @@
+﻿#include "Socket.h"
+
+#include <cstdio>
+#include <utility>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#pragma comment(lib, "Ws2_32.lib")
+#else
+#include <arpa/inet.h>
+#include <cerrno>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+#include "Log.h"
+
+namespace OctaCubic
+{
+    constexpr uintptr_t Socket::invalidHandle;
+
+    namespace
+    {
+#ifdef _WIN32
+        using Handle = SOCKET;
+        bool wouldBlock() { return WSAGetLastError() == WSAEWOULDBLOCK; }
+        void closeHandle(const Handle handle) { closesocket(handle); }
+#else
+        using Handle = int;
+        bool wouldBlock() { return errno == EAGAIN || errno == EWOULDBLOCK; }
+        void closeHandle(const Handle handle) { ::close(handle); }
+#endif
+    }
+
+    Socket::~Socket() {
+        close();
+    }
+
+    Socket::Socket(Socket&& other) noexcept: handle_(other.handle_) {
+        other.handle_ = invalidHandle;
+    }
+
+    Socket& Socket::operator=(Socket&& other) noexcept {
+        if (this != &other) {
+            close();
+            std::swap(handle_, other.handle_);
+        }
+        return *this;
+    }
+
+    bool Socket::startup() {
+#ifdef _WIN32
+        WSADATA data;
+        if (WSAStartup(MAKEWORD(2, 2), &data) != 0) {
+            LOG_ERROR("Socket", "WSAStartup failed");
+            return false;
+        }
+#endif
+        return true;
+    }
+
+    bool Socket::listen(const char* address, const uint16_t port) {
+        close();
+        const Handle handle = ::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+        if (handle == static_cast<Handle>(invalidHandle)) {
+            LOG_ERROR("Socket", "Could not create a socket");
+            return false;
+        }
+        handle_ = static_cast<uintptr_t>(handle);
+        const int reuse = 1;
+        setsockopt(handle, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&reuse), sizeof(reuse));
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        if (inet_pton(AF_INET, address, &addr.sin_addr) != 1 ||
+            ::bind(handle, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) != 0 ||
+            ::listen(handle, SOMAXCONN) != 0 || !configure()) {
+            LOG_ERROR("Socket", "Could not listen on %s:%d", address, (int)port);
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    Socket Socket::accept() {
+        if (!isValid()) return Socket();
+        const Handle handle = ::accept(static_cast<Handle>(handle_), nullptr, nullptr);
+        if (handle == static_cast<Handle>(invalidHandle)) return Socket();
+        Socket socket(static_cast<uintptr_t>(handle));
+        if (!socket.configure()) socket.close();
+        return socket;
+    }
+
+    bool Socket::connect(const char* host, const uint16_t port) {
+        close();
+        addrinfo hints{};
+        hints.ai_family = AF_INET;
+        hints.ai_socktype = SOCK_STREAM;
+        hints.ai_protocol = IPPROTO_TCP;
+        char service[8];
+        snprintf(service, sizeof(service), "%d", (int)port);
+        addrinfo* result = nullptr;
+        if (getaddrinfo(host, service, &hints, &result) != 0 || !result) {
+            LOG_ERROR("Socket", "Could not resolve %s", host);
+            return false;
+        }
+        const Handle handle = ::socket(result->ai_family, result->ai_socktype, result->ai_protocol);
+        const bool isConnected = handle != static_cast<Handle>(invalidHandle) &&
+            ::connect(handle, result->ai_addr, static_cast<int>(result->ai_addrlen)) == 0;
+        freeaddrinfo(result);
+        if (handle != static_cast<Handle>(invalidHandle)) handle_ = static_cast<uintptr_t>(handle);
+        if (!isConnected || !configure()) {
+            LOG_ERROR("Socket", "Could not connect to %s:%d", host, (int)port);
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    long Socket::send(const void* data, const size_t size) {
+        if (!isValid()) return -1;
+#ifdef _WIN32
+        const long sent = ::send(static_cast<Handle>(handle_), static_cast<const char*>(data), static_cast<int>(size), 0);
+#elif defined(MSG_NOSIGNAL)
+        const long sent = ::send(static_cast<Handle>(handle_), data, size, MSG_NOSIGNAL); // A closed peer must not raise SIGPIPE
+#else
+        const long sent = ::send(static_cast<Handle>(handle_), data, size, 0);
+#endif
+        if (sent >= 0) return sent;
+        return wouldBlock() ? 0 : -1;
+    }
+
+    long Socket::receive(void* data, const size_t size) {
+        if (!isValid()) return -1;
+        const long received = ::recv(static_cast<Handle>(handle_), static_cast<char*>(data), static_cast<int>(size), 0);
+        if (received > 0) return received;
+        if (received == 0) return -1; // Closed by the peer
+        return wouldBlock() ? 0 : -1;
+    }
+
+    uint16_t Socket::getLocalPort() const {
+        sockaddr_in addr{};
+        socklen_t length = sizeof(addr);
+        if (!isValid() || getsockname(static_cast<Handle>(handle_), reinterpret_cast<sockaddr*>(&addr), &length) != 0)
+            return 0;
+        return ntohs(addr.sin_port);
+    }
+
+    void Socket::close() {
+        if (!isValid()) return;
+        closeHandle(static_cast<Handle>(handle_));
+        handle_ = invalidHandle;
+    }
+
+    bool Socket::configure() {
+        const Handle handle = static_cast<Handle>(handle_);
+        const int noDelay = 1;
+        setsockopt(handle, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&noDelay), sizeof(noDelay));
+#ifdef _WIN32
+        u_long nonBlocking = 1;
+        return ioctlsocket(handle, FIONBIO, &nonBlocking) == 0;
+#else
+        const int flags = fcntl(handle, F_GETFL, 0);
+        return flags >= 0 && fcntl(handle, F_SETFL, flags | O_NONBLOCK) == 0;
+#endif
+    }
+}
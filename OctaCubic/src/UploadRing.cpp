@@ -0,0 +1,167 @@
+﻿#include "UploadRing.h"
+
+#include <chrono>
+#include <glad/glad.h>
+
+#include "Log.h"
+#include "MemoryStats.h"
+
+using namespace OctaCubic;
+
+namespace
+{
+    constexpr size_t alignment = 16;
+
+    size_t alignUp(const size_t value) {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+}
+
+UploadRing::UploadRing(const size_t capacity): capacity_(alignUp(capacity)) {}
+
+void UploadRing::initGPU() {
+    if (mapped_) return;
+    constexpr GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    glGenBuffers(1, &buffer_);
+    glBindBuffer(GL_COPY_READ_BUFFER, buffer_);
+    glBufferStorage(GL_COPY_READ_BUFFER, (GLsizeiptr)capacity_, nullptr, flags);
+    MemoryStats::add(MemoryStats::gpuUploadRings, (int64_t)capacity_);
+    uint8_t* mapped = static_cast<uint8_t*>(glMapBufferRange(GL_COPY_READ_BUFFER, 0, (GLsizeiptr)capacity_, flags));
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        mapped_ = mapped;
+    }
+    if (!mapped_) LOG_ERROR("UploadRing", "Failed to map upload ring");
+}
+
+UploadRing::Allocation UploadRing::tryAllocate(const size_t size) {
+    if (size == 0) return Allocation{};
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!mapped_) return Allocation{};
+    return allocateLocked(size);
+}
+
+UploadRing::Allocation UploadRing::allocate(const size_t size) {
+    if (!mapped_ || size == 0 || alignUp(size) > capacity_) return Allocation{};
+    Allocation allocation = tryAllocate(size);
+    if (allocation.isValid()) return allocation;
+
+    const auto stallStart = std::chrono::steady_clock::now();
+    frameStalls_++;
+    totalStalls_++;
+    while (!allocation.isValid()) {
+        if (fences_.empty()) {
+            // Nothing in flight to wait for: the ring is held by staged uploads that are not copied yet
+            break;
+        }
+        pollFences(true);
+        allocation = tryAllocate(size);
+    }
+    frameStallMs_ += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - stallStart).count();
+    return allocation;
+}
+
+void UploadRing::copyTo(const Allocation& allocation, const glm::uint dstBuffer, const size_t dstOffset) {
+    if (!allocation.isValid()) return;
+    glBindBuffer(GL_COPY_READ_BUFFER, buffer_);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, dstBuffer);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, (GLintptr)allocation.offset, (GLintptr)dstOffset,
+                        (GLsizeiptr)allocation.size);
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    frameUploadBytes_ += allocation.size;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (Record* record = findRecordLocked(allocation.id)) record->state = copied;
+}
+
+void UploadRing::cancel(const Allocation& allocation) {
+    if (!allocation.isValid()) return;
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (Record* record = findRecordLocked(allocation.id)) record->state = cancelled;
+}
+
+void UploadRing::endFrame() {
+    if (!mapped_) return;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        bool hasUnfenced = false;
+        for (Record& record : records_)
+            if (record.state != staged && record.fenceSerial == 0) {
+                record.fenceSerial = nextFenceSerial_;
+                hasUnfenced = true;
+            }
+        if (hasUnfenced) {
+            fences_.push_back(Fence{nextFenceSerial_++, glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0)});
+        }
+    }
+    pollFences(false);
+
+    lastFrameUploadBytes_ = frameUploadBytes_.exchange(0);
+    lastFrameStalls_ = frameStalls_;
+    lastFrameStallMs_ = frameStallMs_;
+    frameStalls_ = 0;
+    frameStallMs_ = 0;
+}
+
+/* Private members */
+
+UploadRing::Allocation UploadRing::allocateLocked(const size_t size) {
+    const size_t alignedSize = alignUp(size);
+    size_t offset;
+    if (records_.empty()) {
+        head_ = 0;
+        if (alignedSize > capacity_) return Allocation{};
+        offset = 0;
+    }
+    else {
+        const size_t tail = records_.front().offset;
+        if (head_ >= tail) {
+            // Free space is [head, capacity) followed by [0, tail)
+            if (head_ + alignedSize <= capacity_) offset = head_;
+            else if (alignedSize < tail) offset = 0;
+            else return Allocation{};
+        }
+        else {
+            // Free space is [head, tail); keep head != tail so a full ring is not mistaken for an empty one
+            if (head_ + alignedSize < tail) offset = head_;
+            else return Allocation{};
+        }
+    }
+    head_ = offset + alignedSize;
+    const uint64_t id = nextId_++;
+    records_.push_back(Record{id, offset, alignedSize, staged, 0});
+    return Allocation{id, offset, size, mapped_ + offset};
+}
+
+UploadRing::Record* UploadRing::findRecordLocked(const uint64_t id) {
+    if (records_.empty() || id < records_.front().id) return nullptr;
+    const size_t index = static_cast<size_t>(id - records_.front().id);
+    return index < records_.size() ? &records_[index] : nullptr;
+}
+
+void UploadRing::pollFences(const bool wait) {
+    bool waited = false;
+    while (!fences_.empty()) {
+        const Fence& fence = fences_.front();
+        // Block on the oldest fence at most once per call, then only pick up already signaled ones
+        const GLuint64 timeout = wait && !waited ? 1000000000ull : 0;
+        const GLenum result = glClientWaitSync(fence.sync, GL_SYNC_FLUSH_COMMANDS_BIT, timeout);
+        waited = true;
+        if (result != GL_ALREADY_SIGNALED && result != GL_CONDITION_SATISFIED) break;
+        completedFenceSerial_ = fence.serial;
+        glDeleteSync(fence.sync);
+        fences_.pop_front();
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    retireLocked();
+}
+
+void UploadRing::retireLocked() {
+    while (!records_.empty()) {
+        const Record& record = records_.front();
+        if (record.state == staged || record.fenceSerial == 0 || record.fenceSerial > completedFenceSerial_) break;
+        records_.pop_front();
+    }
+}
@@ -0,0 +1,105 @@
+﻿#include "VoxelCollider.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace OctaCubic
+{
+    constexpr float VoxelCollider::epsilon;
+
+    SweepResult VoxelCollider::move(World& world, const Aabb& box, const glm::vec3& delta, const float stepHeight) {
+        gather(world, box, delta, stepHeight);
+        SweepResult result;
+        Aabb moved = box;
+        result.delta = clipMove(moved, delta, result.isBlocked);
+        result.isOnGround = result.isBlocked[1] && delta.y < 0;
+
+        const bool isBlockedSideways = result.isBlocked[0] || result.isBlocked[2];
+        if (stepHeight <= 0 || !result.isOnGround || !isBlockedSideways)
+            return result;
+
+        // Step up: rise, move sideways, then settle back down, from the start position
+        Aabb stepped = box;
+        bool stepBlocked[3] = {false, false, false};
+        const glm::vec3 rise = clipMove(stepped, glm::vec3{0, stepHeight, 0}, stepBlocked);
+        const glm::vec3 sideways = clipMove(stepped, glm::vec3{delta.x, 0, delta.z}, stepBlocked);
+        const glm::vec3 settle = clipMove(stepped, glm::vec3{0, delta.y - rise.y, 0}, stepBlocked);
+        const float steppedDist = sideways.x * sideways.x + sideways.z * sideways.z;
+        const float flatDist = result.delta.x * result.delta.x + result.delta.z * result.delta.z;
+        if (steppedDist <= flatDist)
+            return result;
+        result.delta = rise + sideways + settle;
+        result.isBlocked[0] = delta.x != sideways.x;
+        result.isBlocked[2] = delta.z != sideways.z;
+        result.hasSteppedUp = true;
+        return result;
+    }
+
+    void VoxelCollider::gather(World& world, const Aabb& box, const glm::vec3& delta, const float stepHeight) {
+        glm::vec3 sweptMin = glm::min(box.min, box.min + delta);
+        glm::vec3 sweptMax = glm::max(box.max, box.max + delta);
+        sweptMax.y += std::max(stepHeight, 0.0f);
+        for (int axis = 0; axis < 3; ++axis) {
+            gridMin_[axis] = (int)std::floor(sweptMin[axis] - epsilon);
+            gridSize_[axis] = (int)std::floor(sweptMax[axis] + epsilon) - gridMin_[axis] + 1;
+        }
+        solid_.resize((size_t)gridSize_.x * gridSize_.y * gridSize_.z);
+
+        World::BlockReader reader(world);
+        size_t i = 0;
+        // X outermost so consecutive reads stay in the same chunk column
+        for (int x = 0; x < gridSize_.x; ++x)
+            for (int z = 0; z < gridSize_.z; ++z)
+                for (int y = 0; y < gridSize_.y; ++y)
+                    solid_[i++] = World::isBlockSolid(reader.getBlockId(gridMin_ + glm::ivec3{x, y, z}));
+    }
+
+    bool VoxelCollider::isSolid(const int x, const int y, const int z) const {
+        const int gx = x - gridMin_.x, gy = y - gridMin_.y, gz = z - gridMin_.z;
+        if (gx < 0 || gy < 0 || gz < 0 || gx >= gridSize_.x || gy >= gridSize_.y || gz >= gridSize_.z)
+            return false;
+        return solid_[((size_t)gx * gridSize_.z + gz) * gridSize_.y + gy] != 0;
+    }
+
+    float VoxelCollider::clipAxis(const Aabb& box, const int axis, const float distance) const {
+        if (distance == 0) return 0;
+        const int axisU = (axis + 1) % 3, axisV = (axis + 2) % 3;
+        // Blocks overlapping the box on the other two axes; touching faces do not count, so the box slides
+        const int minU = (int)std::floor(box.min[axisU] + epsilon), maxU = (int)std::ceil(box.max[axisU] - epsilon);
+        const int minV = (int)std::floor(box.min[axisV] + epsilon), maxV = (int)std::ceil(box.max[axisV] - epsilon);
+
+        // Walk the layers of blocks the leading face passes, nearest first
+        const bool isPositive = distance > 0;
+        const float face = isPositive ? box.max[axis] : box.min[axis];
+        const int first = isPositive ? (int)std::ceil(face - epsilon) : (int)std::floor(face + epsilon) - 1;
+        const int last = isPositive ? (int)std::ceil(face + distance) - 1 : (int)std::floor(face + distance);
+        const int step = isPositive ? 1 : -1;
+        for (int layer = first; isPositive ? layer <= last : layer >= last; layer += step) {
+            for (int u = minU; u < maxU; ++u) {
+                for (int v = minV; v < maxV; ++v) {
+                    glm::ivec3 block;
+                    block[axis] = layer;
+                    block[axisU] = u;
+                    block[axisV] = v;
+                    if (isSolid(block.x, block.y, block.z))
+                        return isPositive ? std::min(distance, (float)layer - face)
+                                          : std::max(distance, (float)(layer + 1) - face);
+                }
+            }
+        }
+        return distance;
+    }
+
+    glm::vec3 VoxelCollider::clipMove(Aabb& box, const glm::vec3& delta, bool isBlocked[3]) const {
+        static const int order[3] = {1, 0, 2};
+        glm::vec3 moved{0};
+        for (const int axis : order) {
+            const float distance = clipAxis(box, axis, delta[axis]);
+            isBlocked[axis] = distance != delta[axis];
+            box.min[axis] += distance;
+            box.max[axis] += distance;
+            moved[axis] = distance;
+        }
+        return moved;
+    }
+}
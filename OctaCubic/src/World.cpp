@@ -1,7 +1,15 @@
 ﻿#include "World.h"
 
+#include <cassert>
 #include <ctime>
+#include <limits>
+#include <tuple>
+#include <utility>
 #include <vector>
+#include <glm/glm.hpp>
+
+#include "MemoryStats.h"
+#include "Profiler.h"
 
 extern size_t worldVertCount;
 
@@ -9,6 +17,10 @@ using namespace OctaCubic;
 
 World::World() = default;
 
+World::~World() {
+    if (chunkMapBytes_ > 0) MemoryStats::sub(MemoryStats::chunkMap, (int64_t)chunkMapBytes_);
+}
+
 void World::randomizeSeed() {
     srand(static_cast<int>(time(nullptr)));
 }
@@ -48,13 +60,19 @@ int World::setBlockId(const glm::ivec3& coordWorld, const uint8_t blockId) {
         return -1; // Chunk not found
     }
     const glm::ivec3 coordLocal = getCoordLocalToChunk(coordWorld);
-    return ptr_chunk->setBlockId(coordLocal, blockId);
+    const int result = ptr_chunk->setBlockId(coordLocal, blockId);
+    if (editLog_ && result >= 0) editLog_->push_back(BlockEdit{coordWorld, blockId});
+    return result;
 }
 
 bool World::isBlockOpaque(const int blockId) {
     return blockId != 0 && blockId != 10;
 }
 
+bool World::isBlockSolid(const int blockId) {
+    return blockId > 0 && blockId != 10;
+}
+
 bool World::isBlockOpaqueAtCoord(const glm::ivec3& coordWorld) {
     return isBlockOpaque(getBlockId(coordWorld));
 }
@@ -67,107 +85,35 @@ glm::ivec3 World::insideBlockCoordinates(const glm::vec3 pos) {
 }
 
 CoordinatesAndFace World::lineTraceToFace(const glm::vec3 start, const glm::vec3 dir, const float len) {
-    const glm::vec3 end = start + dir * len;
-    glm::vec3 hitPlainX;
-    glm::vec3 hitPlainY;
-    glm::vec3 hitPlainZ;
-    CoordinatesAndFace hitBlockInX;
-    CoordinatesAndFace hitBlockInY;
-    CoordinatesAndFace hitBlockInZ;
-    {
-        // Compute hit block in X-axis face
-        const int deltaX = end.x > start.x ? 1 : -1;
-        const int startX = (int)ceil(start.x);
-        const int endX = (int)floor(end.x);
-        for (int x = startX; deltaX > 0 ? x <= endX : x >= endX; x += deltaX) {
-            const float t = ((float)x - start.x) / dir.x;
-            if (t < 0) continue;
-            const float y = start.y + t * dir.y;
-            const float z = start.z + t * dir.z;
-            const glm::vec3 currentPos{x, y, z};
-            glm::ivec3 currentBlock = insideBlockCoordinates(currentPos);
-            if (dir.x < 0) currentBlock.x -= 1;
-            if (getBlockId(currentBlock) > 0) {
-                hitPlainX = currentPos;
-                hitBlockInX = CoordinatesAndFace(currentBlock.x, currentBlock.y, currentBlock.z,
-                                                 dir.x < 0 ? xPos : xNeg, true);
-                break;
-            }
-        }
-    }
-    {
-        // Compute hit block in Y-axis face
-        const int deltaY = end.y > start.y ? 1 : -1;
-        const int startY = (int)ceil(start.y);
-        const int endY = (int)floor(end.y);
-        for (int y = startY; deltaY > 0 ? y <= endY : y >= endY; y += deltaY) {
-            const float t = ((float)y - start.y) / dir.y;
-            if (t < 0) continue;
-            const float x = start.x + t * dir.x;
-            const float z = start.z + t * dir.z;
-            const glm::vec3 currentPos{x, y, z};
-            glm::ivec3 currentBlock = insideBlockCoordinates(currentPos);
-            if (dir.y < 0) currentBlock.y -= 1;
-            if (getBlockId(currentBlock) > 0) {
-                hitPlainY = currentPos;
-                hitBlockInY = CoordinatesAndFace(currentBlock.x, currentBlock.y, currentBlock.z,
-                                                 dir.y < 0 ? yPos : yNeg, true);
-                break;
-            }
-        }
-    }
-    {
-        // Compute hit block in Z-axis face
-        const int deltaZ = end.z > start.z ? 1 : -1;
-        const int startZ = (int)ceil(start.z);
-        const int endZ = (int)floor(end.z);
-        for (int z = startZ; deltaZ > 0 ? z <= endZ : z >= endZ; z += deltaZ) {
-            const float t = ((float)z - start.z) / dir.z;
-            if (t < 0) continue;
-            const float x = start.x + t * dir.x;
-            const float y = start.y + t * dir.y;
-            const glm::vec3 currentPos{x, y, z};
-            glm::ivec3 currentBlock = insideBlockCoordinates(currentPos);
-            if (dir.z < 0) currentBlock.z -= 1;
-            if (getBlockId(currentBlock) > 0) {
-                hitPlainZ = currentPos;
-                hitBlockInZ = CoordinatesAndFace(currentBlock.x, currentBlock.y, currentBlock.z,
-                                                 dir.z < 0 ? zPos : zNeg, true);
-                break;
-            }
-        }
-    }
-    // Compare hit blocks and return the closest one
-    if (hitBlockInX.isHit && hitBlockInY.isHit && hitBlockInZ.isHit) {
-        const float distX = glm::length(hitPlainX - start);
-        const float distY = glm::length(hitPlainY - start);
-        const float distZ = glm::length(hitPlainZ - start);
-        if (distX < distY && distX < distZ) return hitBlockInX;
-        if (distY < distX && distY < distZ) return hitBlockInY;
-        return hitBlockInZ;
-    }
-    if (hitBlockInX.isHit && hitBlockInY.isHit) {
-        const float distX = glm::length(hitPlainX - start);
-        const float distY = glm::length(hitPlainY - start);
-        if (distX < distY) return hitBlockInX;
-        return hitBlockInY;
-    }
-    if (hitBlockInX.isHit && hitBlockInZ.isHit) {
-        const float distX = glm::length(hitPlainX - start);
-        const float distZ = glm::length(hitPlainZ - start);
-        if (distX < distZ) return hitBlockInX;
-        return hitBlockInZ;
-    }
-    if (hitBlockInY.isHit && hitBlockInZ.isHit) {
-        const float distY = glm::length(hitPlainY - start);
-        const float distZ = glm::length(hitPlainZ - start);
-        if (distY < distZ) return hitBlockInY;
-        return hitBlockInZ;
+    BlockReader reader(*this);
+    return traceRay(reader, start, dir, len);
+}
+
+void World::traceRays(const RayQuery* rays, const size_t numRays, CoordinatesAndFace* results) {
+    BlockReader reader(*this);
+    for (size_t i = 0; i < numRays; ++i)
+        results[i] = traceRay(reader, rays[i].start, rays[i].dir, rays[i].len);
+}
+
+void World::traceRays(const std::vector<RayQuery>& rays, std::vector<CoordinatesAndFace>& results) {
+    results.resize(rays.size());
+    traceRays(rays.data(), rays.size(), results.data());
+}
+
+World::BlockReader::BlockReader(World& world): world_(world) {}
+
+int World::BlockReader::getBlockId(const glm::ivec3& coordWorld) {
+    if (world_.isOutOfBound(coordWorld))
+        return -1; // Out of bound
+    const chunk_coord cc = getCoordChunk(coordWorld);
+    if (!hasChunk_ || cc != chunkCoord_) {
+        chunk_ = world_.getChunk(cc);
+        chunkCoord_ = cc;
+        hasChunk_ = true;
     }
-    if (hitBlockInX.isHit) return hitBlockInX;
-    if (hitBlockInY.isHit) return hitBlockInY;
-    if (hitBlockInZ.isHit) return hitBlockInZ;
-    return hitBlockInX;
+    if (!chunk_)
+        return -1; // Chunk not found
+    return chunk_->getBlockId(getCoordLocalToChunk(coordWorld));
 }
 
 glm::ivec3 World::getCoordLocalToChunk(const glm::ivec3 coordWorld) {
@@ -194,70 +140,366 @@ glm::ivec3 World::getCoordChunk(const glm::vec3 coordWorld) {
     return getCoordChunk(insideBlockCoordinates(coordWorld));
 }
 
-void World::smartRenderingPreprocess(const glm::ivec3 center, const int viewDistance) {
+void World::bindJobSystem(JobSystem* jobSystem) {
+    jobSystem_ = jobSystem;
+}
+
+JobSystem* World::getJobSystem() const {
+    return jobSystem_;
+}
+
+void World::parallelFor(const size_t count, const std::function<void(size_t begin, size_t end)>& body) {
+    if (jobSystem_) jobSystem_->parallelFor(count, 1, body);
+    else body(0, count);
+}
+
+void World::generateChunks(const glm::ivec3 centerChunk, const int distance) {
+    PROFILE_ZONE("World::generateChunks");
+    // The map is only changed here, before any job runs; the jobs fill chunks that no one else reads yet
+    chunksToBuild_.clear();
+    for (int x = centerChunk.x - distance; x <= centerChunk.x + distance; ++x) {
+        for (int z = centerChunk.z - distance; z <= centerChunk.z + distance; ++z) {
+            const chunk_coord chunkCoord{x, 0, z};
+            if (getChunk(chunkCoord) == nullptr) {
+                Chunk& newChunk = chunkMap_.emplace(std::piecewise_construct, std::forward_as_tuple(chunkCoord),
+                                                    std::forward_as_tuple(x, z)).first->second;
+                newChunk.bindWorld(this);
+                chunksToBuild_.push_back(&newChunk);
+            }
+        }
+    }
+    if (!chunksToBuild_.empty()) updateChunkMapMemory();
+    if (!isTerrainGenerated_) return;
+    const int seed = seed_;
+    parallelFor(chunksToBuild_.size(), [this, seed](const size_t begin, const size_t end) {
+        for (size_t i = begin; i < end; ++i) chunksToBuild_[i]->genTerrain(seed);
+    });
+    numChunksGenerated_ += chunksToBuild_.size();
+}
+
+bool World::loadChunk(const chunk_coord c, const uint8_t* data, const size_t size) {
+    Chunk* ptr_chunk = getChunk(c);
+    if (!ptr_chunk) {
+        ptr_chunk = &chunkMap_.emplace(std::piecewise_construct, std::forward_as_tuple(c),
+                                       std::forward_as_tuple(c.x, c.z)).first->second;
+        ptr_chunk->bindWorld(this);
+        updateChunkMapMemory();
+    }
+    if (!ptr_chunk->deserializeBlocks(data, size)) return false;
+    // Faces on the borders of the neighbours depend on these blocks
+    for (const chunk_coord& n : {chunk_coord{c.x - 1, 0, c.z}, chunk_coord{c.x + 1, 0, c.z},
+                                 chunk_coord{c.x, 0, c.z - 1}, chunk_coord{c.x, 0, c.z + 1}}) {
+        Chunk* ptr_neighbour = getChunk(n);
+        if (ptr_neighbour) ptr_neighbour->isDirty = true;
+    }
+    return true;
+}
+
+bool World::applyChunkDelta(const chunk_coord c, const uint8_t* data, const size_t size) {
+    Chunk* ptr_chunk = getChunk(c);
+    if (!ptr_chunk) return false;
+    uint8_t changedBorders = 0;
+    const bool isValid = ptr_chunk->applyDelta(data, size, changedBorders);
+    const std::pair<Chunk::Border, chunk_coord> neighbours[] = {
+        {Chunk::borderXNeg, {c.x - 1, 0, c.z}}, {Chunk::borderXPos, {c.x + 1, 0, c.z}},
+        {Chunk::borderZNeg, {c.x, 0, c.z - 1}}, {Chunk::borderZPos, {c.x, 0, c.z + 1}}
+    };
+    for (const auto& neighbour : neighbours) {
+        if (!(changedBorders & neighbour.first)) continue;
+        Chunk* ptr_neighbour = getChunk(neighbour.second);
+        if (ptr_neighbour) ptr_neighbour->isDirty = true;
+    }
+    return isValid;
+}
+
+bool World::serializeChunkDelta(const chunk_coord c, const std::vector<uint16_t>& indices, std::vector<uint8_t>& out) {
+    const Chunk* ptr_chunk = getChunk(c);
+    if (!ptr_chunk) return false;
+    ptr_chunk->serializeDelta(indices, out);
+    return true;
+}
+
+bool World::serializeChunk(const chunk_coord c, std::vector<uint8_t>& out) {
+    const Chunk* ptr_chunk = getChunk(c);
+    if (!ptr_chunk) return false;
+    ptr_chunk->serializeBlocks(out);
+    return true;
+}
+
+void World::updateChunkMapMemory() {
+    // Per node: the key, the chunk minus its blocks (counted by the chunk) and the next pointer; plus the buckets
+    constexpr size_t nodeBytes = sizeof(std::pair<const chunk_coord, Chunk>) - Chunk::blockBytes + sizeof(void*);
+    const size_t bytes = chunkMap_.size() * nodeBytes + chunkMap_.bucket_count() * sizeof(void*);
+    if (chunkMapBytes_ == 0) MemoryStats::add(MemoryStats::chunkMap, (int64_t)bytes);
+    else MemoryStats::resize(MemoryStats::chunkMap, (int64_t)chunkMapBytes_, (int64_t)bytes);
+    chunkMapBytes_ = bytes;
+}
+
+void World::updateChunks(const glm::ivec3 center, const int viewDistance, std::vector<Chunk*>& chunksInView) {
+    PROFILE_ZONE("World::updateChunks");
+    const glm::ivec3 centerChunk = getCoordChunk(center);
+    //// Generate chunks in view if it never generated
+    generateChunks(centerChunk, viewDistance);
+    //// After all chunks in view generated, build their meshes; meshing only reads the neighbours' blocks
+    chunksInView.clear();
+    chunksToBuild_.clear();
+    for (int x = centerChunk.x - viewDistance; x <= centerChunk.x + viewDistance; ++x) {
+        for (int z = centerChunk.z - viewDistance; z <= centerChunk.z + viewDistance; ++z) {
+            Chunk* ptr_chunk = getChunk({x, 0, z});
+            if (ptr_chunk->isDirty) chunksToBuild_.push_back(ptr_chunk);
+            chunksInView.push_back(ptr_chunk);
+        }
+    }
+    const bool isHandedToGL = jobSystem_ && isMeshesToGLJobs_;
+    parallelFor(chunksToBuild_.size(), [this, isHandedToGL](const size_t begin, const size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            Chunk* ptr_chunk = chunksToBuild_[i];
+            ptr_chunk->buildMesh();
+            if (isHandedToGL) jobSystem_->submitGL([this, ptr_chunk] { sendMeshed(ptr_chunk); });
+        }
+    });
+    numChunksMeshed_ += chunksToBuild_.size();
+}
+
+void World::setRenderQueue(const std::vector<Chunk*>& chunksInView, const glm::ivec3 center, const int viewDistance) {
+    PROFILE_ZONE("World::setRenderQueue");
     const glm::ivec3 centerChunk = getCoordChunk(center);
     const int minX = centerChunk.x - viewDistance;
     const int maxX = centerChunk.x + viewDistance;
     const int minZ = centerChunk.z - viewDistance;
     const int maxZ = centerChunk.z + viewDistance;
     // Free GPU memory of chunks out of view
-    std::vector<Chunk*> chunksToFree;
-    for (auto c : Chunk::chunkInGPUSet) {
+    for (auto it = chunksInGPU_.begin(); it != chunksInGPU_.end();) {
+        const chunk_coord& c = (*it)->getChunkCoord();
         if (c.x < minX || c.x > maxX || c.z < minZ || c.z > maxZ) {
-            chunksToFree.push_back(getChunk(c));
-        }
-    }
-    for (Chunk* chunk : chunksToFree) {
-        if (chunk != nullptr) {
-            chunk->freeGPU();
+            (*it)->freeGPU();
+            it = chunksInGPU_.erase(it);
         }
+        else ++it;
     }
     // Render chunks in view
     renderWaitingQueue_.clear();
+    renderQueueMin_ = glm::ivec3{minX, 0, minZ};
+    renderQueueDim_ = 2 * viewDistance + 1;
     worldVertCount = 0;
-    //// Generate chunks in view if it never generated
-    for (int x = minX; x <= maxX; ++x) {
-        for (int z = minZ; z <= maxZ; ++z) {
-            const chunk_coord chunkCoord{x, 0, z};
-            Chunk* ptr_chunk = getChunk(chunkCoord);
-            if (ptr_chunk == nullptr) {
-                Chunk newChunk(x, z);
-                newChunk.bindWorld(this);
-                newChunk.genTerrain(seed_);
-                chunkMap_.emplace(chunkCoord, std::move(newChunk));
-                ptr_chunk = &chunkMap_[chunkCoord];
-            }
+    for (Chunk* ptr_chunk : chunksInView) {
+        if (ptr_chunk->needsUpload()) {
+            ptr_chunk->sendToGPU();
+            chunksInGPU_.insert(ptr_chunk);
         }
+        renderWaitingQueue_.push_back(ptr_chunk);
+        worldVertCount += ptr_chunk->getNumVertices();
     }
-    //// After all chunks in view generated, build mesh and send to GPU
-    for (int x = minX; x <= maxX; ++x) {
-        for (int z = minZ; z <= maxZ; ++z) {
-            Chunk* ptr_chunk = getChunk({x, 0, z});
-            if (ptr_chunk->isDirty) ptr_chunk->buildMesh();
-            if (!ptr_chunk->isInGPU()) ptr_chunk->sendToGPU();
-            renderWaitingQueue_.push_back(ptr_chunk);
-            worldVertCount += ptr_chunk->getNumVertices();
-        }
+    // Until culled, every chunk in the queue is drawn by every pass
+    cameraVisibleQueue_.clear();
+    for (Chunk* ptr_chunk : renderWaitingQueue_)
+        cameraVisibleQueue_.push_back(RenderQueueItem{ptr_chunk, Chunk::allSections});
+    cameraCullingStats_ = CullingStats{};
+    for (int i = 0; i < ShadowCascades::maxCascades; ++i) {
+        lightVisibleQueues_[i] = cameraVisibleQueue_;
+        lightCullingStats_[i] = CullingStats{};
     }
 }
 
+void World::sendMeshed(Chunk* ptr_chunk) {
+    const glm::ivec3 grid = ptr_chunk->getChunkCoord() - renderQueueMin_;
+    if (grid.x < 0 || grid.x >= renderQueueDim_ || grid.z < 0 || grid.z >= renderQueueDim_) {
+        // Meshed for a view the render thread skipped. Its staged upload would hold up the upload ring, which
+        // retires in order, until the chunk is back in view.
+        ptr_chunk->dropStagedMesh();
+        return;
+    }
+    if (!ptr_chunk->needsUpload()) return; // Already sent by setRenderQueue
+    ptr_chunk->sendToGPU();
+    chunksInGPU_.insert(ptr_chunk);
+}
+
+void World::smartRenderingPreprocess(const glm::ivec3 center, const int viewDistance) {
+    PROFILE_ZONE("World::smartRenderingPreprocess");
+    updateChunks(center, viewDistance, chunksInView_);
+    setRenderQueue(chunksInView_, center, viewDistance);
+}
+
 void World::smartRenderingPreprocess(const glm::vec3 center, const int viewDistance) {
     smartRenderingPreprocess(insideBlockCoordinates(center), viewDistance);
 }
 
+size_t World::getNumChunksInGPU() const {
+    return chunksInGPU_.size();
+}
+
+void World::cullForCamera(const glm::mat4& camViewProjection, const glm::vec3& camPosition) {
+    const Frustum frustum(camViewProjection);
+    const glm::ivec3 camBlock = insideBlockCoordinates(camPosition);
+    const glm::ivec3 camGrid = getCoordChunk(camBlock) - renderQueueMin_;
+    if (isOutOfBound(camBlock) ||
+        camGrid.x < 0 || camGrid.x >= renderQueueDim_ || camGrid.z < 0 || camGrid.z >= renderQueueDim_) {
+        // Camera is not inside a loaded section (e.g. observer view from above): frustum culling only
+        cullRenderQueue(frustum, cameraVisibleQueue_, cameraCullingStats_);
+        return;
+    }
+
+    // BFS through the section grid starting at the camera. A section is entered through one face and may only
+    // be left through faces connected to it, and never back towards a direction already traveled.
+    struct SectionNode {
+        glm::ivec3 grid; // x, z: index in the render queue grid; y: section index
+        face enteredFrom;
+        uint8_t directions; // Faces already traveled through, as bits
+    };
+    const int dim = renderQueueDim_;
+    const auto gridIndex = [dim](const glm::ivec3& g) { return g.x * dim + g.z; };
+    std::vector<section_mask> reached(renderWaitingQueue_.size(), 0);
+    std::vector<SectionNode> queue;
+    queue.reserve(renderWaitingQueue_.size() * Chunk::numSections);
+
+    const auto enqueue = [&](const glm::ivec3& from, const face exitFace, const uint8_t directions) {
+        const glm::ivec3 next = from + SectionVisibility::faceDirection(exitFace);
+        if (next.x < 0 || next.x >= dim || next.z < 0 || next.z >= dim ||
+            next.y < 0 || next.y >= Chunk::numSections)
+            return;
+        section_mask& reachedMask = reached[gridIndex(next)];
+        if (reachedMask >> next.y & 1) return;
+        if (!isSectionInFrustum(frustum, renderWaitingQueue_[gridIndex(next)], next.y)) return;
+        reachedMask |= 1 << next.y;
+        queue.push_back(SectionNode{
+            next, SectionVisibility::opposite(exitFace), static_cast<uint8_t>(directions | 1 << exitFace)
+        });
+    };
+
+    // The camera's own section is always visible and can be left through any face
+    const glm::ivec3 start{camGrid.x, camBlock.y / Chunk::sectionHeight, camGrid.z};
+    reached[gridIndex(start)] |= 1 << start.y;
+    for (int f = 0; f < 6; ++f)
+        enqueue(start, static_cast<face>(f), 0);
+    for (size_t head = 0; head < queue.size(); ++head) {
+        const SectionNode node = queue[head];
+        const SectionVisibility& visibility =
+            renderWaitingQueue_[gridIndex(node.grid)]->getSectionVisibility(node.grid.y);
+        for (int f = 0; f < 6; ++f) {
+            const face exitFace = static_cast<face>(f);
+            if (node.directions >> SectionVisibility::opposite(exitFace) & 1) continue;
+            if (!visibility.isConnected(node.enteredFrom, exitFace)) continue;
+            enqueue(node.grid, exitFace, node.directions);
+        }
+    }
+
+    cameraVisibleQueue_.clear();
+    cameraCullingStats_ = CullingStats{};
+    for (size_t i = 0; i < renderWaitingQueue_.size(); ++i) {
+        Chunk* ptr_chunk = renderWaitingQueue_[i];
+        section_mask visible = 0;
+        for (int section = 0; section < Chunk::numSections; ++section) {
+            if (ptr_chunk->isSectionEmpty(section)) continue;
+            if (reached[i] >> section & 1) {
+                visible |= 1 << section;
+                cameraCullingStats_.drawn++;
+            }
+            else if (isSectionInFrustum(frustum, ptr_chunk, section))
+                cameraCullingStats_.occluded++;
+            else
+                cameraCullingStats_.culled++;
+        }
+        if (visible) cameraVisibleQueue_.push_back(RenderQueueItem{ptr_chunk, visible});
+    }
+#ifndef NDEBUG
+    checkOcclusion(camViewProjection, camPosition, reached);
+#endif
+}
+
+void World::checkOcclusion(const glm::mat4& camViewProjection, const glm::vec3& camPosition,
+                           const std::vector<section_mask>& reached) {
+    // A grid of rays over the screen: the first block each ray sees must be in a section the BFS reached
+    constexpr int raysPerSide = 8;
+    const glm::mat4 inverseViewProjection = glm::inverse(camViewProjection);
+    const float len = (float)(renderQueueDim_ / 2 * Chunk::width);
+    for (int i = 0; i < raysPerSide; ++i) {
+        for (int j = 0; j < raysPerSide; ++j) {
+            const glm::vec4 ndc{(i + 0.5f) / raysPerSide * 2 - 1, (j + 0.5f) / raysPerSide * 2 - 1, 0, 1};
+            const glm::vec4 onScreen = inverseViewProjection * ndc;
+            const glm::vec3 dir = glm::normalize(glm::vec3(onScreen) / onScreen.w - camPosition);
+            const CoordinatesAndFace hit = lineTraceToFace(camPosition, dir, len);
+            if (!hit.isHit) continue;
+            // On negative axes the trace steps one plane past its end and may skip blocks there
+            if (glm::length(glm::vec3{hit.x, hit.y, hit.z} + 0.5f - camPosition) > len - 1) continue;
+            const glm::ivec3 grid = getCoordChunk(glm::ivec3{hit.x, hit.y, hit.z}) - renderQueueMin_;
+            if (grid.x < 0 || grid.x >= renderQueueDim_ || grid.z < 0 || grid.z >= renderQueueDim_)
+                continue; // Beyond the view distance
+            assert((reached[grid.x * renderQueueDim_ + grid.z] >> hit.y / Chunk::sectionHeight & 1) &&
+                "Occlusion culling hid a visible section");
+        }
+    }
+}
+
+void World::cullForLight(const glm::mat4& lightSpaceMatrix, const int cascade) {
+    cullRenderQueue(Frustum(lightSpaceMatrix), lightVisibleQueues_[cascade], lightCullingStats_[cascade]);
+}
+
 void World::renderInQueueOpaque() {
-    for (const auto ptr_chunk : renderWaitingQueue_) {
-        ptr_chunk->renderOpaque();
+    drawCommands_.clear();
+    for (const auto& item : cameraVisibleQueue_) {
+        item.chunk->appendDrawOpaque(drawCommands_, item.sections);
     }
+    Chunk::getGPUArena().drawIndirect(drawCommands_);
 }
 
 void World::renderInQueueWater() {
-    for (const auto ptr_chunk : renderWaitingQueue_) {
-        ptr_chunk->renderWater();
+    drawCommands_.clear();
+    for (const auto& item : cameraVisibleQueue_) {
+        item.chunk->appendDrawWater(drawCommands_, item.sections);
     }
+    Chunk::getGPUArena().drawIndirect(drawCommands_);
 }
 
-bool World::isChunkCreated(const chunk_coord c) {
+void World::renderInQueueShadow(const int cascade, const glm::mat4* regionMatrix) {
+    drawCommands_.clear();
+    if (regionMatrix) {
+        const Frustum region(*regionMatrix);
+        for (const auto& item : lightVisibleQueues_[cascade]) {
+            section_mask sections = 0;
+            for (int s = 0; s < Chunk::numSections; ++s)
+                if (item.sections & (1 << s) && isSectionInFrustum(region, item.chunk, s)) sections |= 1 << s;
+            item.chunk->appendDrawDepth(drawCommands_, sections);
+        }
+    }
+    else {
+        for (const auto& item : lightVisibleQueues_[cascade]) {
+            item.chunk->appendDrawDepth(drawCommands_, item.sections);
+        }
+    }
+    Chunk::getDepthArena().drawIndirect(drawCommands_);
+}
+
+void World::getShadowCasters(const int cascade, std::vector<ShadowCaster>& casters) const {
+    casters.clear();
+    for (const auto& item : lightVisibleQueues_[cascade]) {
+        const chunk_coord& c = item.chunk->getChunkCoord();
+        ShadowCaster caster;
+        caster.id = static_cast<uint64_t>(static_cast<uint32_t>(c.x)) << 32 | static_cast<uint32_t>(c.z);
+        caster.version = item.chunk->getMeshVersion() << 16 | item.sections;
+        caster.boundsMin = item.chunk->getBoundsMin();
+        caster.boundsMax = item.chunk->getBoundsMax();
+        casters.push_back(caster);
+    }
+}
+
+const CullingStats& World::getCameraCullingStats() const {
+    return cameraCullingStats_;
+}
+
+const CullingStats& World::getLightCullingStats(const int cascade) const {
+    return lightCullingStats_[cascade];
+}
+
+glm::vec3 World::getRenderQueueBoundsMin() const {
+    return glm::vec3(renderQueueMin_.x * Chunk::width, 0, renderQueueMin_.z * Chunk::width);
+}
+
+glm::vec3 World::getRenderQueueBoundsMax() const {
+    return glm::vec3((renderQueueMin_.x + renderQueueDim_) * Chunk::width, Chunk::height,
+                     (renderQueueMin_.z + renderQueueDim_) * Chunk::width);
+}
+
+bool World::isChunkCreated(const chunk_coord c) const {
     return chunkMap_.find(c) != chunkMap_.end();
 }
 
@@ -268,3 +510,77 @@ Chunk* World::getChunk(const chunk_coord c) {
     }
     return nullptr;
 }
+
+void World::cullRenderQueue(const Frustum& frustum, std::vector<RenderQueueItem>& visibleQueue,
+                            CullingStats& stats) const {
+    visibleQueue.clear();
+    stats = CullingStats{};
+    for (Chunk* ptr_chunk : renderWaitingQueue_) {
+        if (ptr_chunk->getNumVertices() == 0) continue;
+        if (!frustum.isBoxVisible(ptr_chunk->getBoundsMin(), ptr_chunk->getBoundsMax())) {
+            for (int section = 0; section < Chunk::numSections; ++section)
+                if (!ptr_chunk->isSectionEmpty(section)) stats.culled++;
+            continue;
+        }
+        section_mask visible = 0;
+        for (int section = 0; section < Chunk::numSections; ++section) {
+            if (ptr_chunk->isSectionEmpty(section)) continue;
+            if (isSectionInFrustum(frustum, ptr_chunk, section)) {
+                visible |= 1 << section;
+                stats.drawn++;
+            }
+            else
+                stats.culled++;
+        }
+        if (visible) visibleQueue.push_back(RenderQueueItem{ptr_chunk, visible});
+    }
+}
+
+CoordinatesAndFace World::traceRay(BlockReader& reader, const glm::vec3 start, const glm::vec3 dir, const float len) {
+    // Amanatides-Woo traversal: step through the block boundary planes the ray crosses in order of distance and
+    // stop at the first block that is not air. Candidate planes, the crossing point and the hit block are computed
+    // exactly like the per-axis sweeps this replaced, so hits are identical.
+    static constexpr float never = std::numeric_limits<float>::infinity();
+    const glm::vec3 end = start + dir * len;
+    int plane[3], lastPlane[3], step[3];
+    float tNext[3];
+    const auto planeDistance = [&](const int axis) {
+        const bool isInRange = step[axis] > 0 ? plane[axis] <= lastPlane[axis] : plane[axis] >= lastPlane[axis];
+        return dir[axis] != 0 && isInRange ? ((float)plane[axis] - start[axis]) / dir[axis] : never;
+    };
+    for (int axis = 0; axis < 3; ++axis) {
+        step[axis] = dir[axis] > 0 ? 1 : -1;
+        plane[axis] = (int)(dir[axis] > 0 ? ceil(start[axis]) : floor(start[axis]));
+        lastPlane[axis] = (int)floor(end[axis]);
+        tNext[axis] = planeDistance(axis);
+    }
+    static const face entryFaces[3][2] = {{xNeg, xPos}, {yNeg, yPos}, {zNeg, zPos}}; // [axis][moving negative]
+
+    while (true) {
+        // Closest plane next; on ties the later axis wins, as in the old distance comparison
+        int axis = 2;
+        if (tNext[1] < tNext[axis]) axis = 1;
+        if (tNext[0] < tNext[axis]) axis = 0;
+        const float t = tNext[axis];
+        if (t == never) break;
+
+        glm::ivec3 block;
+        for (int other = 0; other < 3; ++other)
+            block[other] = (int)floor(start[other] + t * dir[other]);
+        block[axis] = dir[axis] < 0 ? plane[axis] - 1 : plane[axis];
+        if (reader.getBlockId(block) > 0)
+            return CoordinatesAndFace(block.x, block.y, block.z, entryFaces[axis][dir[axis] < 0], true);
+
+        plane[axis] += step[axis];
+        tNext[axis] = planeDistance(axis);
+    }
+    return CoordinatesAndFace();
+}
+
+bool World::isSectionInFrustum(const Frustum& frustum, const Chunk* ptr_chunk, const int section) {
+    glm::vec3 boxMin = ptr_chunk->getBoundsMin();
+    glm::vec3 boxMax = ptr_chunk->getBoundsMax();
+    boxMin.y = static_cast<float>(section * Chunk::sectionHeight);
+    boxMax.y = static_cast<float>((section + 1) * Chunk::sectionHeight);
+    return frustum.isBoxVisible(boxMin, boxMax);
+}
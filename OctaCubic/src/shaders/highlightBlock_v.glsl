@@ -6,8 +6,18 @@ layout (location = 3) in float aBlockId;
 layout (location = 4) in vec3 aBlockCoord;
 
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+layout (std140) uniform FrameData { // Matches OctaCubic::FrameUniforms
+    mat4 view;
+    mat4 projection;
+    mat4 normalMatrix; // transpose(inverse(view)), for model = identity
+    mat4 lightSpaceMatrices[4];
+    vec4 cascadeSplits; // Far edge of each shadow cascade in view space
+    vec4 lightPosView; // Light position in view space
+    vec4 lightColor;
+    float ambient;
+    float time;
+    int numCascades;
+};
 
 void main() {
     gl_Position = projection * view * model * vec4(aPosition, 1.0);
@@ -5,15 +5,23 @@ in vec4 fColor;
 out vec4 FragColor;
 
 uniform mat4 model;
-uniform mat4 view;
-uniform vec3 lightPos;
-uniform vec3 lightColor;
-uniform float ambient;
+layout (std140) uniform FrameData { // Matches OctaCubic::FrameUniforms
+    mat4 view;
+    mat4 projection;
+    mat4 normalMatrix; // transpose(inverse(view)), for model = identity
+    mat4 lightSpaceMatrices[4];
+    vec4 cascadeSplits; // Far edge of each shadow cascade in view space
+    vec4 lightPosView; // Light position in view space
+    vec4 lightColor;
+    float ambient;
+    float time;
+    int numCascades;
+};
 
 void main() {
     vec3 normal_n = normalize(fNormal);
-    vec3 lightDir = normalize((view * vec4(lightPos, 1.0)).xyz - fFragPos);
+    vec3 lightDir = normalize(lightPosView.xyz - fFragPos);
     float diff = max(dot(normal_n, lightDir), 0.0);
-    vec3 diffuse = diff * lightColor;
+    vec3 diffuse = diff * lightColor.rgb;
     FragColor = vec4(normal_n, 1.0);
 }
\ No newline at end of file
@@ -6,13 +6,23 @@ out vec3 fNormal;
 out vec4 fColor;
 
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+layout (std140) uniform FrameData { // Matches OctaCubic::FrameUniforms
+    mat4 view;
+    mat4 projection;
+    mat4 normalMatrix; // transpose(inverse(view)), for model = identity
+    mat4 lightSpaceMatrices[4];
+    vec4 cascadeSplits; // Far edge of each shadow cascade in view space
+    vec4 lightPosView; // Light position in view space
+    vec4 lightColor;
+    float ambient;
+    float time;
+    int numCascades;
+};
 uniform vec4 diffuseColor;
 
 void main() {
     fFragPos = (view * model * vec4(aPosition, 1.0)).xyz;
-    fNormal = mat3(transpose(inverse(view * model))) * aNormal;
+    fNormal = mat3(normalMatrix) * aNormal; // Chunk meshes are drawn with model = identity
     fColor = diffuseColor;
     gl_Position = projection * view * model * vec4(aPosition, 1.0);
 }
\ No newline at end of file
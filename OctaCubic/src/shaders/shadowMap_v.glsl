@@ -1,8 +1,5 @@
 #version 330 core
-layout (location = 0) in vec3 aPosition;
-layout (location = 1) in vec3 aNormal;
-layout (location = 2) in vec2 aTexCoord;
-layout (location = 3) in float aBlockId;
+layout (location = 0) in vec3 aPosition; // Position-only depth stream
 
 uniform mat4 lightSpaceMatrix;
 uniform mat4 model;
@@ -9,17 +9,25 @@ out vec4 fColor;
 out vec3 fNormal_model;
 out vec3 fPos_model;
 out vec2 fTexCoord;
-out vec4 fFragPosLightSpace;
 flat out int fBlockId;
 flat out int fTexId;
 
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+layout (std140) uniform FrameData { // Matches OctaCubic::FrameUniforms
+    mat4 view;
+    mat4 projection;
+    mat4 normalMatrix; // transpose(inverse(view)), for model = identity
+    mat4 lightSpaceMatrices[4];
+    vec4 cascadeSplits; // Far edge of each shadow cascade in view space
+    vec4 lightPosView; // Light position in view space
+    vec4 lightColor;
+    float ambient;
+    float time;
+    int numCascades;
+};
 uniform vec4 diffuseColor;
 uniform int blockRes = 16;
 uniform int textureRes = 256;
-uniform mat4 lightSpaceMatrix;
 
 vec2 calcUV(int id, int blockRes, int textureRes, vec2 TexCoord) {
     vec2 result = TexCoord;
@@ -49,13 +57,12 @@ int blockIdToTexId(float blockId, vec3 normal_model, vec3 pos_model) {
 
 void main() {
     fFragPos = (view * model * vec4(aPosition, 1.0)).xyz;
-    fNormal = mat3(transpose(inverse(view * model))) * aNormal;
+    fNormal = mat3(normalMatrix) * aNormal; // Chunk meshes are drawn with model = identity
     fNormal_model = aNormal;
     fPos_model = (model * vec4(aPosition, 1.0)).xyz;
     fColor = diffuseColor;
     fBlockId = int(aBlockId);
     fTexId = blockIdToTexId(aBlockId, aNormal, aPosition);
     fTexCoord = calcUV(fTexId, blockRes, textureRes, aTexCoord);
-    fFragPosLightSpace = lightSpaceMatrix * model * vec4(aPosition, 1.0); // for shadow mapping
     gl_Position = projection * view * model * vec4(aPosition, 1.0);
 }
\ No newline at end of file
@@ -6,20 +6,26 @@ in vec3 fNormal;
 in vec4 fColor;
 in vec3 fNormal_model;
 in vec3 fPos_model;
-in vec4 fFragPosLightSpace;
 flat in int fBlockId;
 
 uniform mat4 model;
-uniform mat4 view;
-uniform vec3 lightPos;
-uniform vec3 lightColor;
-uniform float ambient;
+layout (std140) uniform FrameData { // Matches OctaCubic::FrameUniforms
+    mat4 view;
+    mat4 projection;
+    mat4 normalMatrix; // transpose(inverse(view)), for model = identity
+    mat4 lightSpaceMatrices[4];
+    vec4 cascadeSplits; // Far edge of each shadow cascade in view space
+    vec4 lightPosView; // Light position in view space
+    vec4 lightColor;
+    float ambient;
+    float time;
+    int numCascades;
+};
 uniform float specularStrength = 0;
 float PhongExp = 1024;
-uniform sampler2D shadowMap;
+uniform sampler2DArray shadowMap;
 
 uniform float waveStrength = 0;
-uniform float time = 0;
 vec3 lightDir;
 
 mat4 rotationMatrix(vec3 axis, float angle) {
@@ -35,14 +41,25 @@ mat4 rotationMatrix(vec3 axis, float angle) {
                 0.0,                                0.0,                                0.0,                                1.0);
 }
 
-float calcShadow(vec4 fragPosLightSpace) {
+float calcShadow(vec3 fragPosWorld, float viewDepth) {
     // Reference: https://learnopengl.com/Advanced-Lighting/Shadows/Shadow-Mapping
+    // pick the first cascade whose slice of the view frustum contains the fragment
+    int cascade = -1;
+    for (int i = 0; i < numCascades; ++i) {
+        if (viewDepth <= cascadeSplits[i]) {
+            cascade = i;
+            break;
+        }
+    }
+    if (cascade < 0)
+        return 0.0;
+    vec4 fragPosLightSpace = lightSpaceMatrices[cascade] * vec4(fragPosWorld, 1.0);
     // perform perspective divide
     vec3 projCoords = fragPosLightSpace.xyz / fragPosLightSpace.w;
     // transform to [0,1] range
     projCoords = projCoords * 0.5 + 0.5;
     // get closest depth value from light's perspective (using [0,1] range fragPosLight as coords)
-    float closestDepth = texture(shadowMap, projCoords.xy).r; 
+    float closestDepth = texture(shadowMap, vec3(projCoords.xy, cascade)).r; 
     // get depth of current fragment from light's perspective
     float currentDepth = projCoords.z;
     float bias = max(0.001 * (1.0 - dot(fNormal, lightDir)), 0.0001);
@@ -50,10 +67,10 @@ float calcShadow(vec4 fragPosLightSpace) {
     // float shadow = currentDepth - bias > closestDepth ? 1.0 : 0.0; 
     // PCF
     float shadow = 0.0;
-    vec2 texelSize = 1.0 / textureSize(shadowMap, 0);
+    vec2 texelSize = 1.0 / textureSize(shadowMap, 0).xy;
     for(int x = -1; x <= 1; ++x) {
         for(int y = -1; y <= 1; ++y) {
-            float pcfDepth = texture(shadowMap, projCoords.xy + vec2(x, y) * texelSize).r; 
+            float pcfDepth = texture(shadowMap, vec3(projCoords.xy + vec2(x, y) * texelSize, cascade)).r; 
             shadow += currentDepth - bias > pcfDepth ? 1.0 : 0.0;        
         }    
     }
@@ -83,18 +100,18 @@ void main() {
     }
     
     // Diffuse lighting
-    lightDir = normalize((view * vec4(lightPos, 1.0)).xyz - fFragPos);
+    lightDir = normalize(lightPosView.xyz - fFragPos);
     float diff = max(dot(normal_n, lightDir), 0.0);
-    vec3 diffuse = diff * lightColor;
+    vec3 diffuse = diff * lightColor.rgb;
     
     // Specular lighting: Blinn-Phong model
     vec3 viewDir = -normalize(fFragPos);
     vec3 halfVector = normalize(normalize(lightDir) + viewDir);
     float spec = pow(max(dot(normal_n, halfVector), 0.0), PhongExp);
-    vec3 specular = specularStrength * spec * lightColor;
+    vec3 specular = specularStrength * spec * lightColor.rgb;
 
     // Shadow
-    float shadow = calcShadow(fFragPosLightSpace);
+    float shadow = calcShadow(fPos_model, -fFragPos.z);
     
     vec3 FragColorRGB = (ambient + (1.0 - shadow) * diffuse) * fColor.rgb + (1.0 - shadow) * specular;
     FragColor = vec4(FragColorRGB, fColor.a);
@@ -8,16 +8,24 @@ out vec3 fNormal;
 out vec4 fColor;
 out vec3 fNormal_model;
 out vec3 fPos_model;
-out vec4 fFragPosLightSpace;
 flat out int fBlockId;
 
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+layout (std140) uniform FrameData { // Matches OctaCubic::FrameUniforms
+    mat4 view;
+    mat4 projection;
+    mat4 normalMatrix; // transpose(inverse(view)), for model = identity
+    mat4 lightSpaceMatrices[4];
+    vec4 cascadeSplits; // Far edge of each shadow cascade in view space
+    vec4 lightPosView; // Light position in view space
+    vec4 lightColor;
+    float ambient;
+    float time;
+    int numCascades;
+};
 uniform vec4 diffuseColor;
 uniform int blockRes = 16;
 uniform int textureRes = 256;
-uniform mat4 lightSpaceMatrix;
 
 vec2 calcUV(int id, int blockRes, int textureRes, vec2 TexCoord) {
     vec2 result = TexCoord;
@@ -30,11 +38,10 @@ vec2 calcUV(int id, int blockRes, int textureRes, vec2 TexCoord) {
 
 void main() {
     fFragPos = (view * model * vec4(aPosition, 1.0)).xyz;
-    fNormal = mat3(transpose(inverse(view * model))) * aNormal;
+    fNormal = mat3(normalMatrix) * aNormal; // Chunk meshes are drawn with model = identity
     fNormal_model = aNormal;
     fPos_model = (model * vec4(aPosition, 1.0)).xyz;
     fColor = diffuseColor;
     fBlockId = int(aBlockId);
-    fFragPosLightSpace = lightSpaceMatrix * model * vec4(aPosition, 1.0); // for shadow mapping
     gl_Position = projection * view * model * vec4(aPosition, 1.0);
 }
\ No newline at end of file
@@ -0,0 +1,52 @@
+﻿#pragma once
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace OctaCubic
+{
+    // Terrain seed of every benchmark: the first draw of std::mt19937 seeded with 20231024, which unlike rand() is
+    // the same on every platform
+    inline int getBenchWorldSeed() {
+        std::mt19937 rng(20231024);
+        return static_cast<int>(rng() >> 1);
+    }
+
+    // Wall clock stopwatch for benchmark loops
+    class BenchTimer {
+    public:
+        BenchTimer(): start_(std::chrono::steady_clock::now()) {}
+        double getSeconds() const {
+            return std::chrono::duration<double>(std::chrono::steady_clock::now() - start_).count();
+        }
+
+    private:
+        std::chrono::steady_clock::time_point start_;
+    };
+
+    // Machine-readable results for tracking regressions per commit; written as JSON
+    class BenchReport {
+    public:
+        void add(const std::string& name, const std::string& unit, const double value);
+        // The commit is taken from OCTACUBIC_BENCH_COMMIT when set
+        bool writeJson(const std::string& path) const;
+
+    private:
+        struct Result {
+            std::string name;
+            std::string unit;
+            double value;
+        };
+        std::vector<Result> results_;
+    };
+
+    void runRaycastBench();
+    // Chunk generation and meshing throughput on the job system, from one thread up to every hardware thread
+    void runJobScalingBench();
+    // Single-threaded throughput of the core kernels over fixed seeds
+    void runKernelBench(BenchReport& report);
+    // A ChunkServer streaming to a ChunkClient over loopback TCP: chunks per second and bytes per chunk, then
+    // the bytes per changed block of the deltas that keep the client current
+    void runNetBench(BenchReport& report);
+}
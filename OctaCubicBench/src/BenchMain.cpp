@@ -0,0 +1,36 @@
+﻿#include <cstdio>
+#include <cstring>
+
+#include "Bench.h"
+#include "Log.h"
+
+// World.cpp accumulates the vertex count of the rendered chunks here; the game defines it in OctaCubic.h
+size_t worldVertCount = 0;
+
+// OctaCubicBench [--kernels] [--json path]
+//   --kernels    only the kernel suite, the one tracked per commit
+//   --json path  also write the kernel results as JSON
+int main(int argc, char** argv) {
+    bool isKernelsOnly = false;
+    const char* jsonPath = nullptr;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--kernels") == 0) isKernelsOnly = true;
+        else if (strcmp(argv[i], "--json") == 0 && i + 1 < argc) jsonPath = argv[++i];
+        else {
+            fprintf(stderr, "Usage: %s [--kernels] [--json path]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    // Chunk progress would bury the results
+    OctaCubic::Log::setLevel(OctaCubic::Log::warning);
+    OctaCubic::BenchReport report;
+    OctaCubic::runKernelBench(report);
+    if (!isKernelsOnly) {
+        OctaCubic::runRaycastBench();
+        OctaCubic::runJobScalingBench();
+        OctaCubic::runNetBench(report);
+    }
+    if (jsonPath && !report.writeJson(jsonPath)) return 1;
+    return 0;
+}
@@ -0,0 +1,56 @@
+﻿#include <cstdio>
+#include <cstdlib>
+
+#include "Bench.h"
+
+namespace OctaCubic
+{
+    namespace
+    {
+        // As a JSON string body: quotes, backslashes and control characters escaped
+        std::string escapeJson(const char* text) {
+            std::string escaped;
+            for (const char* c = text; *c; ++c) {
+                if (*c == '"' || *c == '\\') {
+                    escaped += '\\';
+                    escaped += *c;
+                }
+                else if (static_cast<unsigned char>(*c) < 0x20) {
+                    char code[8];
+                    snprintf(code, sizeof(code), "\\u%04x", static_cast<unsigned char>(*c));
+                    escaped += code;
+                }
+                else escaped += *c;
+            }
+            return escaped;
+        }
+    }
+
+    void BenchReport::add(const std::string& name, const std::string& unit, const double value) {
+        results_.push_back(Result{name, unit, value});
+    }
+
+    bool BenchReport::writeJson(const std::string& path) const {
+        FILE* file = fopen(path.c_str(), "w");
+        if (!file) {
+            fprintf(stderr, "Failed to open %s\n", path.c_str());
+            return false;
+        }
+        const char* commit = getenv("OCTACUBIC_BENCH_COMMIT");
+#ifdef NDEBUG
+        const char* build = "release";
+#else
+        const char* build = "debug";
+#endif
+        // Only the commit comes from outside; names and units are identifiers chosen by the benchmarks
+        fprintf(file, "{\n  \"commit\": \"%s\",\n  \"build\": \"%s\",\n  \"results\": [\n",
+                escapeJson(commit ? commit : "").c_str(), build);
+        for (size_t i = 0; i < results_.size(); ++i) {
+            fprintf(file, "    {\"name\": \"%s\", \"unit\": \"%s\", \"value\": %.6g}%s\n", results_[i].name.c_str(),
+                    results_[i].unit.c_str(), results_[i].value, i + 1 < results_.size() ? "," : "");
+        }
+        fprintf(file, "  ]\n}\n");
+        fclose(file);
+        return true;
+    }
+}
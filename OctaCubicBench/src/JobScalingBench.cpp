@@ -0,0 +1,61 @@
+﻿#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "Bench.h"
+#include "JobSystem.h"
+#include "World.h"
+
+namespace OctaCubic
+{
+    namespace
+    {
+        constexpr int worldRadius = 12; // In chunks
+
+        std::vector<int> getThreadCounts() {
+            const int maxThreads = std::max(static_cast<int>(std::thread::hardware_concurrency()), 1);
+            std::vector<int> counts;
+            for (int n = 1; n < maxThreads; n *= 2)
+                counts.push_back(n);
+            counts.push_back(maxThreads);
+            return counts;
+        }
+    }
+
+    void runJobScalingBench() {
+        const int numChunks = (2 * worldRadius + 1) * (2 * worldRadius + 1);
+        printf("Job scaling: %d chunks, generation then meshing, by threads (workers + the submitting thread)\n",
+               numChunks);
+        double genBaseline = 0, meshBaseline = 0;
+        for (const int numThreads : getThreadCounts()) {
+            World world;
+            world.setSeed(getBenchWorldSeed());
+            JobSystem jobSystem(numThreads - 1);
+            world.bindJobSystem(&jobSystem);
+
+            BenchTimer genTimer;
+            world.generateChunks(glm::ivec3{0, 0, 0}, worldRadius);
+            const double genSeconds = genTimer.getSeconds();
+
+            // Everything is generated by now, so this only meshes
+            std::vector<Chunk*> chunksInView;
+            BenchTimer meshTimer;
+            world.updateChunks(glm::ivec3{0, 0, 0}, worldRadius, chunksInView);
+            const double meshSeconds = meshTimer.getSeconds();
+
+            if (numThreads == 1) {
+                genBaseline = genSeconds;
+                meshBaseline = meshSeconds;
+            }
+            printf("  %2d threads  gen %8.1f chunks/s (%.2fx)  mesh %8.1f chunks/s (%.2fx)  %llu steals\n",
+                   numThreads,
+                   numChunks / genSeconds, genBaseline / genSeconds,
+                   numChunks / meshSeconds, meshBaseline / meshSeconds,
+                   static_cast<unsigned long long>(jobSystem.getNumSteals()));
+            world.bindJobSystem(nullptr);
+        }
+    }
+}
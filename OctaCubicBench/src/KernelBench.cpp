@@ -0,0 +1,274 @@
+﻿#include <algorithm>
+#include <cstdio>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <random>
+#include <utility>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "ArenaAllocator.h"
+#include "Bench.h"
+#include "Player.h"
+#include "World.h"
+
+namespace OctaCubic
+{
+    namespace
+    {
+        constexpr int repeats = 3; // The best run is reported
+        constexpr int terrainRadius = 8; // In chunks
+        constexpr int meshRadius = 6; // Meshed chunks; one more ring is generated for their neighbours
+        constexpr int lookupRadius = 4; // The coherent scan covers (2 * lookupRadius)^2 chunks
+        constexpr size_t numLookups = (size_t)(2 * lookupRadius * Chunk::width) * (2 * lookupRadius * Chunk::width) *
+            Chunk::height;
+        constexpr size_t numRays = 1 << 18;
+        constexpr float rayLength = 64.0f;
+        constexpr size_t numPlayerSteps = 1 << 20;
+        constexpr size_t numArenaOps = 1 << 18;
+        constexpr size_t maxLiveMeshes = 300; // About the chunks within a view distance of 8
+
+        template <typename F>
+        double measureBest(F&& run) {
+            double best = 0;
+            for (int i = 0; i < repeats; ++i) {
+                BenchTimer timer;
+                run();
+                const double seconds = timer.getSeconds();
+                if (i == 0 || seconds < best) best = seconds;
+            }
+            return best;
+        }
+
+        void report(BenchReport& benchReport, const char* name, const char* unit, const double value,
+                    const long long checksum) {
+            printf("  %-20s %12.1f %-12s (checksum %lld)\n", name, value, unit, checksum);
+            benchReport.add(name, unit, value);
+        }
+
+        void benchGenTerrain(BenchReport& benchReport, const int seed) {
+            std::vector<std::unique_ptr<Chunk>> chunks;
+            for (int x = -terrainRadius; x < terrainRadius; ++x)
+                for (int z = -terrainRadius; z < terrainRadius; ++z)
+                    chunks.emplace_back(new Chunk(x, z));
+            const double seconds = measureBest([&]() {
+                for (const std::unique_ptr<Chunk>& chunk : chunks) chunk->genTerrain(seed);
+            });
+            long long checksum = 0;
+            for (const std::unique_ptr<Chunk>& chunk : chunks) checksum += chunk->getBlockId({5, 30, 7});
+            report(benchReport, "genTerrain", "chunks/s", (double)chunks.size() / seconds, checksum);
+        }
+
+        // Through World::updateChunks, which meshes every dirty chunk in view; without a GL context the
+        // upload ring is unmapped, so buildMesh() skips staging and this is genMeshData alone
+        void benchGenMeshData(BenchReport& benchReport, World& world) {
+            std::vector<Chunk*> chunksInView;
+            world.updateChunks(glm::ivec3{0, 0, 0}, meshRadius, chunksInView);
+            const double seconds = measureBest([&]() {
+                for (Chunk* chunk : chunksInView) chunk->isDirty = true;
+                world.updateChunks(glm::ivec3{0, 0, 0}, meshRadius, chunksInView);
+            });
+            long long numVertices = 0;
+            for (const Chunk* chunk : chunksInView) numVertices += (long long)chunk->getNumBuiltVertices();
+            report(benchReport, "genMeshData", "chunks/s", (double)chunksInView.size() / seconds, numVertices);
+            report(benchReport, "genMeshData.vertices", "vertices/s", (double)numVertices / seconds, numVertices);
+        }
+
+        void benchGetBlockId(BenchReport& benchReport, World& world) {
+            const int extent = lookupRadius * Chunk::width;
+            std::mt19937 rng(11);
+            std::uniform_int_distribution<int> horizontal(-extent, extent - 1);
+            std::uniform_int_distribution<int> vertical(0, Chunk::height - 1);
+            std::vector<glm::ivec3> coords(numLookups);
+            for (glm::ivec3& c : coords) c = glm::ivec3{horizontal(rng), vertical(rng), horizontal(rng)};
+
+            long long randomSum = 0;
+            const double randomSeconds = measureBest([&]() {
+                randomSum = 0;
+                for (const glm::ivec3& c : coords) randomSum += world.getBlockId(c);
+            });
+            report(benchReport, "getBlockId.random", "lookups/s", (double)numLookups / randomSeconds, randomSum);
+
+            // In storage order: Z fastest within a chunk column
+            long long coherentSum = 0;
+            const double coherentSeconds = measureBest([&]() {
+                coherentSum = 0;
+                for (int x = -extent; x < extent; ++x)
+                    for (int y = 0; y < Chunk::height; ++y)
+                        for (int z = -extent; z < extent; ++z)
+                            coherentSum += world.getBlockId(glm::ivec3{x, y, z});
+            });
+            report(benchReport, "getBlockId.coherent", "lookups/s", (double)numLookups / coherentSeconds,
+                   coherentSum);
+        }
+
+        void benchLineTraceToFace(BenchReport& benchReport, World& world) {
+            const float extent = (float)(meshRadius * Chunk::width);
+            std::mt19937 rng(7);
+            std::uniform_real_distribution<float> horizontal(-extent, extent);
+            std::uniform_real_distribution<float> height(50.0f, 110.0f);
+            std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+            std::vector<RayQuery> rays(numRays);
+            for (RayQuery& ray : rays) {
+                glm::vec3 dir{unit(rng), unit(rng), unit(rng)};
+                while (glm::length(dir) < 0.01f) dir = glm::vec3{unit(rng), unit(rng), unit(rng)};
+                ray.start = glm::vec3{horizontal(rng), height(rng), horizontal(rng)};
+                ray.dir = glm::normalize(dir);
+                ray.len = rayLength;
+            }
+
+            long long hits = 0;
+            const double seconds = measureBest([&]() {
+                hits = 0;
+                for (const RayQuery& ray : rays)
+                    if (world.lineTraceToFace(ray.start, ray.dir, ray.len).isHit) ++hits;
+            });
+            report(benchReport, "lineTraceToFace", "rays/s", (double)numRays / seconds, hits);
+        }
+
+        // The chunk encoding streamed to clients
+        void benchChunkSerialization(BenchReport& benchReport, World& world) {
+            std::vector<std::vector<uint8_t>> serialized;
+            for (int x = -meshRadius; x <= meshRadius; ++x)
+                for (int z = -meshRadius; z <= meshRadius; ++z) {
+                    serialized.emplace_back();
+                    world.serializeChunk(chunk_coord{x, 0, z}, serialized.back());
+                }
+            const double serializeSeconds = measureBest([&]() {
+                int i = 0;
+                for (int x = -meshRadius; x <= meshRadius; ++x)
+                    for (int z = -meshRadius; z <= meshRadius; ++z) {
+                        serialized[i].clear();
+                        world.serializeChunk(chunk_coord{x, 0, z}, serialized[i++]);
+                    }
+            });
+            long long numBytes = 0;
+            for (const std::vector<uint8_t>& data : serialized) numBytes += (long long)data.size();
+            report(benchReport, "serializeBlocks", "chunks/s", (double)serialized.size() / serializeSeconds, numBytes);
+            report(benchReport, "serializeBlocks.size", "bytes/chunk", (double)numBytes / serialized.size(), numBytes);
+
+            Chunk chunk(0, 0);
+            long long checksum = 0;
+            const double deserializeSeconds = measureBest([&]() {
+                checksum = 0;
+                for (const std::vector<uint8_t>& data : serialized) {
+                    chunk.deserializeBlocks(data.data(), data.size());
+                    checksum += chunk.getBlockId({5, 30, 7});
+                }
+            });
+            report(benchReport, "deserializeBlocks", "chunks/s", (double)serialized.size() / deserializeSeconds,
+                   checksum);
+        }
+
+        // Meshes of random size enter and leave the chunk arena, which doubles when full like ChunkBufferArena.
+        // live receives the meshes left at the end. With checkRanges, returns how many meshes were placed over a
+        // live one, the checksum otherwise.
+        long long churnArena(ArenaAllocator& arena, const std::vector<size_t>& sizes,
+                             const std::vector<uint32_t>& evictions, const bool checkRanges,
+                             std::vector<std::pair<size_t, size_t>>& live) {
+            std::map<size_t, size_t> ranges; // offset -> size, when checking
+            long long result = 0;
+            live.clear();
+            for (size_t i = 0; i < sizes.size(); ++i) {
+                if (live.size() >= maxLiveMeshes) {
+                    const size_t victim = evictions[i] % live.size();
+                    arena.free(live[victim].first);
+                    if (checkRanges) ranges.erase(live[victim].first);
+                    live[victim] = live.back();
+                    live.pop_back();
+                }
+                size_t offset = arena.allocate(sizes[i]);
+                if (offset == ArenaAllocator::invalidOffset) {
+                    size_t newCapacity = arena.getCapacity() > 0 ? arena.getCapacity() : 1;
+                    while (newCapacity < arena.getCapacity() + sizes[i]) newCapacity *= 2;
+                    arena.grow(newCapacity);
+                    offset = arena.allocate(sizes[i]);
+                }
+                live.emplace_back(offset, sizes[i]);
+                if (!checkRanges) {
+                    result += (long long)offset;
+                    continue;
+                }
+                // Sorted by offset, so only the neighbours can overlap
+                const auto next = ranges.lower_bound(offset);
+                if (next != ranges.end() && offset + sizes[i] > next->first) ++result;
+                else if (next != ranges.begin() && std::prev(next)->first + std::prev(next)->second > offset) ++result;
+                ranges.emplace(offset, sizes[i]);
+            }
+            return result;
+        }
+
+        void benchArenaAllocator(BenchReport& benchReport) {
+            std::mt19937 rng(5);
+            std::uniform_int_distribution<size_t> meshSize(1000, 40000); // In vertices
+            std::vector<size_t> sizes(numArenaOps);
+            std::vector<uint32_t> evictions(numArenaOps);
+            for (size_t i = 0; i < numArenaOps; ++i) {
+                sizes[i] = meshSize(rng);
+                evictions[i] = (uint32_t)rng();
+            }
+
+            long long checksum = 0;
+            std::vector<std::pair<size_t, size_t>> live; // offset, size
+            const double seconds = measureBest([&]() {
+                ArenaAllocator arena;
+                checksum = churnArena(arena, sizes, evictions, false, live);
+            });
+            report(benchReport, "arenaAllocate", "meshes/s", (double)numArenaOps / seconds, checksum);
+
+            // Correctness, outside the timing: no mesh over another, and everything merges back into one block
+            ArenaAllocator arena;
+            const long long overlaps = churnArena(arena, sizes, evictions, true, live);
+            for (const std::pair<size_t, size_t>& mesh : live) arena.free(mesh.first);
+            const bool isMerged = arena.getUsed() == 0 && arena.getLargestFreeBlock() == arena.getCapacity();
+            printf("  %-20s %lld overlaps in %zu vertices, %s after freeing all\n", "arenaAllocate", overlaps,
+                   arena.getCapacity(), isMerged ? "merged" : "NOT merged");
+        }
+
+        // A walk over the terrain: sliding along walls, stepping up ledges and falling
+        void benchApplyNewLocation(BenchReport& benchReport, World& world) {
+            constexpr float tickSeconds = 1.0f / 60;
+            const float extent = (float)((meshRadius - 1) * Chunk::width);
+            Player player;
+            player.world_ptr = &world;
+            player.tickSecond = tickSeconds;
+
+            long long checksum = 0;
+            const double seconds = measureBest([&]() {
+                std::mt19937 rng(3);
+                std::uniform_real_distribution<float> angle(0.0f, 6.2831853f);
+                player.location = glm::vec3{0.5f, 120.0f, 0.5f};
+                glm::vec3 step{0, 0, 0};
+                for (size_t i = 0; i < numPlayerSteps; ++i) {
+                    if (i % 60 == 0) {
+                        const float a = angle(rng);
+                        step = glm::vec3{std::cos(a), 0, std::sin(a)} * (player.speedWalk * tickSeconds);
+                        step.y = -0.2f;
+                    }
+                    player.applyNewLocation(step);
+                    if (std::abs(player.location.x) > extent || std::abs(player.location.z) > extent)
+                        player.location = glm::vec3{0.5f, 120.0f, 0.5f};
+                }
+                checksum = (long long)(player.location.x * 1000) + (long long)(player.location.z * 1000);
+            });
+            report(benchReport, "applyNewLocation", "steps/s", (double)numPlayerSteps / seconds, checksum);
+        }
+    }
+
+    void runKernelBench(BenchReport& report) {
+        const int seed = getBenchWorldSeed();
+        World world;
+        world.setSeed(seed);
+        printf("Kernels: seed %d, best of %d runs, one thread\n", seed, repeats);
+        benchGenTerrain(report, seed);
+
+        world.generateChunks(glm::ivec3{0, 0, 0}, meshRadius + 1);
+        benchGenMeshData(report, world);
+        benchGetBlockId(report, world);
+        benchLineTraceToFace(report, world);
+        benchChunkSerialization(report, world);
+        benchArenaAllocator(report);
+        benchApplyNewLocation(report, world);
+    }
+}
@@ -0,0 +1,102 @@
+﻿#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <random>
+#include <thread>
+#include <glm/glm.hpp>
+
+#include "Bench.h"
+#include "ChunkClient.h"
+#include "ChunkServer.h"
+#include "World.h"
+
+namespace OctaCubic
+{
+    namespace
+    {
+        constexpr int streamRadius = 12; // In chunks; the client asks for (2 * streamRadius + 1)^2
+        constexpr int numEditRounds = 20;
+        constexpr int numEditsPerRound = 500; // Scattered over the client's view
+        constexpr double timeoutSeconds = 30; // For each wait on the client
+    }
+
+    void runNetBench(BenchReport& report) {
+        if (!Socket::startup()) return;
+        // Generated up front: this measures streaming, not terrain generation
+        World serverWorld;
+        serverWorld.setSeed(getBenchWorldSeed());
+        serverWorld.generateChunks(glm::ivec3{0, 0, 0}, streamRadius);
+        ChunkServer server(serverWorld, streamRadius);
+        if (!server.listen("127.0.0.1", 0)) return;
+
+        std::atomic<bool> isRunning{true};
+        std::thread serverThread([&]() {
+            while (isRunning) {
+                server.update();
+                std::this_thread::yield();
+            }
+        });
+
+        World clientWorld;
+        clientWorld.setTerrainGenerated(false);
+        ChunkClient client;
+        const uint64_t numChunks = (uint64_t)(2 * streamRadius + 1) * (2 * streamRadius + 1);
+        BenchTimer timer;
+        if (client.connect("127.0.0.1", server.getPort(), streamRadius)) {
+            while (client.getNumChunksReceived() < numChunks && timer.getSeconds() < timeoutSeconds &&
+                   client.update(clientWorld, glm::vec3{0.5f, 100, 0.5f}))
+                std::this_thread::yield();
+        }
+        const double seconds = timer.getSeconds();
+        isRunning = false;
+        serverThread.join();
+        if (client.getNumChunksReceived() < numChunks) {
+            printf("Chunk streaming: disconnected or timed out after %llu of %llu chunks\n",
+                   (unsigned long long)client.getNumChunksReceived(), (unsigned long long)numChunks);
+            return;
+        }
+
+        // Scattered edits, as many players building at once: each update sends one delta per changed chunk
+        const ChunkServer::Stats streamStats = server.getStats();
+        std::mt19937 rng(5);
+        std::uniform_int_distribution<int> horizontal(-streamRadius * Chunk::width, (streamRadius + 1) * Chunk::width - 1);
+        std::uniform_int_distribution<int> vertical(20, 80);
+        std::uniform_int_distribution<int> blockId(0, 4);
+        for (int round = 0; round < numEditRounds; ++round) {
+            for (int i = 0; i < numEditsPerRound; ++i)
+                serverWorld.setBlockId(glm::ivec3{horizontal(rng), vertical(rng), horizontal(rng)}, (uint8_t)blockId(rng));
+            server.update();
+        }
+        const ChunkServer::Stats stats = server.getStats();
+        const BenchTimer deltaTimer;
+        while (client.getNumDeltasReceived() < stats.numDeltasSent && deltaTimer.getSeconds() < timeoutSeconds &&
+               client.update(clientWorld, glm::vec3{0.5f, 100, 0.5f}))
+            server.update();
+
+        // Both worlds must hold the same blocks; chunks and deltas that did not apply or never came count too
+        const uint64_t numMissing = stats.numDeltasSent - std::min(client.getNumDeltasReceived(), stats.numDeltasSent);
+        long long mismatches = (long long)(client.getNumRejected() + numMissing);
+        for (int x = -streamRadius * Chunk::width; x < (streamRadius + 1) * Chunk::width; x += 3)
+            for (int z = -streamRadius * Chunk::width; z < (streamRadius + 1) * Chunk::width; z += 3)
+                for (int y = 0; y < Chunk::height; y += 5)
+                    if (serverWorld.getBlockId({x, y, z}) != clientWorld.getBlockId({x, y, z})) ++mismatches;
+
+        const double bytesPerChunk = (double)streamStats.numBytesSent / (double)numChunks;
+        const uint64_t numDeltas = stats.numDeltasSent - streamStats.numDeltasSent;
+        const uint64_t numChanged = stats.numBlocksChanged - streamStats.numBlocksChanged;
+        const double deltaBytesPerBlock = (double)(stats.numDeltaBytes - streamStats.numDeltaBytes) / (double)numChanged;
+        printf("Chunk streaming over loopback TCP: %llu chunks in %.1f ms, then %llu deltas for %llu changed blocks, "
+               "%lld mismatches (%llu rejected, %llu deltas missing)\n", (unsigned long long)numChunks, seconds * 1000, (unsigned long long)numDeltas,
+               (unsigned long long)numChanged, mismatches, (unsigned long long)client.getNumRejected(),
+               (unsigned long long)numMissing);
+        printf("  %-20s %12.1f chunks/s\n", "stream", (double)numChunks / seconds);
+        printf("  %-20s %12.1f bytes/chunk (%.1f of it blocks, %.0fx smaller than raw)\n", "stream.size",
+               bytesPerChunk, (double)streamStats.numChunkBytes / (double)streamStats.numChunksSent,
+               (double)Chunk::blockBytes / bytesPerChunk);
+        printf("  %-20s %12.2f bytes/block (whole chunks would take %.0f)\n", "delta.size", deltaBytesPerBlock,
+               (double)numDeltas * bytesPerChunk / (double)numChanged);
+        report.add("stream", "chunks/s", (double)numChunks / seconds);
+        report.add("stream.size", "bytes/chunk", bytesPerChunk);
+        report.add("delta.size", "bytes/block", deltaBytesPerBlock);
+    }
+}
@@ -0,0 +1,210 @@
+﻿#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "Bench.h"
+#include "World.h"
+
+namespace OctaCubic
+{
+    namespace
+    {
+        constexpr int worldRadius = 8; // In chunks
+        constexpr size_t numRays = 1 << 20;
+
+        // lineTraceToFace as it was before the DDA traversal, verbatim: the baseline to beat and the reference
+        // for the new results
+        CoordinatesAndFace referenceLineTrace(World& world, const glm::vec3 start, const glm::vec3 dir, const float len) {
+            const glm::vec3 end = start + dir * len;
+            glm::vec3 hitPlainX;
+            glm::vec3 hitPlainY;
+            glm::vec3 hitPlainZ;
+            CoordinatesAndFace hitBlockInX;
+            CoordinatesAndFace hitBlockInY;
+            CoordinatesAndFace hitBlockInZ;
+            {
+                // Compute hit block in X-axis face
+                const int deltaX = end.x > start.x ? 1 : -1;
+                const int startX = (int)ceil(start.x);
+                const int endX = (int)floor(end.x);
+                for (int x = startX; deltaX > 0 ? x <= endX : x >= endX; x += deltaX) {
+                    const float t = ((float)x - start.x) / dir.x;
+                    if (t < 0) continue;
+                    const float y = start.y + t * dir.y;
+                    const float z = start.z + t * dir.z;
+                    const glm::vec3 currentPos{x, y, z};
+                    glm::ivec3 currentBlock = World::insideBlockCoordinates(currentPos);
+                    if (dir.x < 0) currentBlock.x -= 1;
+                    if (world.getBlockId(currentBlock) > 0) {
+                        hitPlainX = currentPos;
+                        hitBlockInX = CoordinatesAndFace(currentBlock.x, currentBlock.y, currentBlock.z,
+                                                         dir.x < 0 ? xPos : xNeg, true);
+                        break;
+                    }
+                }
+            }
+            {
+                // Compute hit block in Y-axis face
+                const int deltaY = end.y > start.y ? 1 : -1;
+                const int startY = (int)ceil(start.y);
+                const int endY = (int)floor(end.y);
+                for (int y = startY; deltaY > 0 ? y <= endY : y >= endY; y += deltaY) {
+                    const float t = ((float)y - start.y) / dir.y;
+                    if (t < 0) continue;
+                    const float x = start.x + t * dir.x;
+                    const float z = start.z + t * dir.z;
+                    const glm::vec3 currentPos{x, y, z};
+                    glm::ivec3 currentBlock = World::insideBlockCoordinates(currentPos);
+                    if (dir.y < 0) currentBlock.y -= 1;
+                    if (world.getBlockId(currentBlock) > 0) {
+                        hitPlainY = currentPos;
+                        hitBlockInY = CoordinatesAndFace(currentBlock.x, currentBlock.y, currentBlock.z,
+                                                         dir.y < 0 ? yPos : yNeg, true);
+                        break;
+                    }
+                }
+            }
+            {
+                // Compute hit block in Z-axis face
+                const int deltaZ = end.z > start.z ? 1 : -1;
+                const int startZ = (int)ceil(start.z);
+                const int endZ = (int)floor(end.z);
+                for (int z = startZ; deltaZ > 0 ? z <= endZ : z >= endZ; z += deltaZ) {
+                    const float t = ((float)z - start.z) / dir.z;
+                    if (t < 0) continue;
+                    const float x = start.x + t * dir.x;
+                    const float y = start.y + t * dir.y;
+                    const glm::vec3 currentPos{x, y, z};
+                    glm::ivec3 currentBlock = World::insideBlockCoordinates(currentPos);
+                    if (dir.z < 0) currentBlock.z -= 1;
+                    if (world.getBlockId(currentBlock) > 0) {
+                        hitPlainZ = currentPos;
+                        hitBlockInZ = CoordinatesAndFace(currentBlock.x, currentBlock.y, currentBlock.z,
+                                                         dir.z < 0 ? zPos : zNeg, true);
+                        break;
+                    }
+                }
+            }
+            // Compare hit blocks and return the closest one
+            if (hitBlockInX.isHit && hitBlockInY.isHit && hitBlockInZ.isHit) {
+                const float distX = glm::length(hitPlainX - start);
+                const float distY = glm::length(hitPlainY - start);
+                const float distZ = glm::length(hitPlainZ - start);
+                if (distX < distY && distX < distZ) return hitBlockInX;
+                if (distY < distX && distY < distZ) return hitBlockInY;
+                return hitBlockInZ;
+            }
+            if (hitBlockInX.isHit && hitBlockInY.isHit) {
+                const float distX = glm::length(hitPlainX - start);
+                const float distY = glm::length(hitPlainY - start);
+                if (distX < distY) return hitBlockInX;
+                return hitBlockInY;
+            }
+            if (hitBlockInX.isHit && hitBlockInZ.isHit) {
+                const float distX = glm::length(hitPlainX - start);
+                const float distZ = glm::length(hitPlainZ - start);
+                if (distX < distZ) return hitBlockInX;
+                return hitBlockInZ;
+            }
+            if (hitBlockInY.isHit && hitBlockInZ.isHit) {
+                const float distY = glm::length(hitPlainY - start);
+                const float distZ = glm::length(hitPlainZ - start);
+                if (distY < distZ) return hitBlockInY;
+                return hitBlockInZ;
+            }
+            if (hitBlockInX.isHit) return hitBlockInX;
+            if (hitBlockInY.isHit) return hitBlockInY;
+            if (hitBlockInZ.isHit) return hitBlockInZ;
+            return hitBlockInX;
+        }
+
+        bool isSameHit(const CoordinatesAndFace& a, const CoordinatesAndFace& b) {
+            if (a.isHit != b.isHit) return false;
+            return !a.isHit || (a.x == b.x && a.y == b.y && a.z == b.z && a.f == b.f);
+        }
+
+        // Distance along the ray to the face that was hit
+        float getHitDistance(const CoordinatesAndFace& hit, const glm::vec3 start, const glm::vec3 dir) {
+            const int axis = hit.f == xPos || hit.f == xNeg ? 0 : (hit.f == yPos || hit.f == yNeg ? 1 : 2);
+            const int block = axis == 0 ? hit.x : (axis == 1 ? hit.y : hit.z);
+            const bool isPositive = hit.f == xPos || hit.f == yPos || hit.f == zPos;
+            return ((float)(isPositive ? block + 1 : block) - start[axis]) / dir[axis];
+        }
+
+        // Both hit at the same distance, an edge or corner the two pick different sides of
+        bool isTieBreak(const CoordinatesAndFace& a, const CoordinatesAndFace& b, const RayQuery& ray) {
+            return a.isHit && b.isHit &&
+                std::abs(getHitDistance(a, ray.start, ray.dir) - getHitDistance(b, ray.start, ray.dir)) <= 1e-4f;
+        }
+
+        // Rays from random points above the terrain, like the player's eye or mobs looking around
+        std::vector<RayQuery> makeRays(const float len) {
+            std::mt19937 rng(7);
+            const float extent = (float)(worldRadius * Chunk::width);
+            std::uniform_real_distribution<float> horizontal(-extent, extent);
+            std::uniform_real_distribution<float> height(50.0f, 110.0f);
+            std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+            std::vector<RayQuery> rays(numRays);
+            for (RayQuery& ray : rays) {
+                glm::vec3 dir{unit(rng), unit(rng), unit(rng)};
+                while (glm::length(dir) < 0.01f) dir = glm::vec3{unit(rng), unit(rng), unit(rng)};
+                ray.start = glm::vec3{horizontal(rng), height(rng), horizontal(rng)};
+                ray.dir = glm::normalize(dir);
+                ray.len = len;
+            }
+            return rays;
+        }
+
+        void printResult(const char* name, const double seconds, const size_t hits) {
+            printf("  %-10s %8.2f Mrays/s  (%zu hits)\n", name, (double)numRays / seconds / 1e6, hits);
+        }
+    }
+
+    void runRaycastBench() {
+        World world;
+        world.setSeed(getBenchWorldSeed());
+        BenchTimer genTimer;
+        world.generateChunks(glm::ivec3{0, 0, 0}, worldRadius);
+        printf("Raycast: generated %d x %d chunks in %.2f s\n", 2 * worldRadius + 1, 2 * worldRadius + 1,
+               genTimer.getSeconds());
+
+        const float lengths[] = {10.0f, 64.0f};
+        for (const float len : lengths) {
+            const std::vector<RayQuery> rays = makeRays(len);
+            std::vector<CoordinatesAndFace> reference(numRays), single(numRays), batched;
+            printf("Raycast: %zu rays of length %.0f\n", numRays, len);
+
+            BenchTimer referenceTimer;
+            for (size_t i = 0; i < numRays; ++i)
+                reference[i] = referenceLineTrace(world, rays[i].start, rays[i].dir, rays[i].len);
+            const double referenceSeconds = referenceTimer.getSeconds();
+
+            BenchTimer singleTimer;
+            for (size_t i = 0; i < numRays; ++i)
+                single[i] = world.lineTraceToFace(rays[i].start, rays[i].dir, rays[i].len);
+            const double singleSeconds = singleTimer.getSeconds();
+
+            BenchTimer batchedTimer;
+            world.traceRays(rays, batched);
+            const double batchedSeconds = batchedTimer.getSeconds();
+
+            size_t hits = 0, mismatches = 0, tieBreaks = 0;
+            for (size_t i = 0; i < numRays; ++i) {
+                if (reference[i].isHit) ++hits;
+                if (!isSameHit(single[i], batched[i])) ++mismatches;
+                else if (!isSameHit(reference[i], single[i])) {
+                    if (isTieBreak(reference[i], single[i], rays[i])) ++tieBreaks;
+                    else ++mismatches;
+                }
+            }
+            printResult("sweeps", referenceSeconds, hits);
+            printResult("dda", singleSeconds, hits);
+            printResult("dda batch", batchedSeconds, hits);
+            printf("  %zu mismatches, %zu tie-break differences, %.1fx speedup\n", mismatches, tieBreaks,
+                   referenceSeconds / batchedSeconds);
+        }
+    }
+}
@@ -0,0 +1,260 @@
+﻿#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/resource.h>
+#endif
+
+#include "BotDriver.h"
+#include "ChunkServer.h"
+#include "JobSystem.h"
+#include "Log.h"
+#include "MemoryStats.h"
+#include "ServerWorld.h"
+#include "Simulation.h"
+
+// World.cpp accumulates the vertex count of the rendered chunks here; the game defines it in OctaCubic.h
+size_t worldVertCount = 0;
+
+namespace
+{
+    constexpr double statsInterval = 5; // Seconds
+
+    // Until clients connect, each player walks straight out from spawn in its own direction
+    OctaCubic::PlayerInput walkingInput(const size_t player, const size_t numPlayers) {
+        OctaCubic::PlayerInput input;
+        input.moveForward = 1;
+        input.yaw = 360.0f * (float)player / (float)numPlayers;
+        return input;
+    }
+
+    // Processor time of the whole process so far, all threads included
+    double getProcessCpuSeconds() {
+#ifdef _WIN32
+        FILETIME creation, exit, kernel, user;
+        if (!GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user)) return 0;
+        const auto toSeconds = [](const FILETIME& time) {
+            return (double)(((uint64_t)time.dwHighDateTime << 32) | time.dwLowDateTime) * 1e-7; // 100 ns units
+        };
+        return toSeconds(kernel) + toSeconds(user);
+#else
+        rusage usage{};
+        if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+        return (double)(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec)
+            + (double)(usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) * 1e-6;
+#endif
+    }
+
+    // Comma separated, e.g. "1,10,100"; false on anything but positive counts
+    bool parseCounts(const char* text, std::vector<int>& counts) {
+        counts.clear();
+        for (;;) {
+            char* end = nullptr;
+            const long count = strtol(text, &end, 10);
+            if (end == text || count < 1) return false;
+            counts.push_back((int)count);
+            if (*end == '\0') return true;
+            if (*end != ',') return false;
+            text = end + 1;
+        }
+    }
+
+    double getPercentile(const std::vector<double>& sorted, const double fraction) {
+        return sorted[(size_t)(fraction * (double)(sorted.size() - 1) + 0.5)];
+    }
+
+    // One fresh world per bot count, ticked back to back on a simulated clock: every run of the same arguments
+    // takes the same ticks, and tick times show the cost of the work rather than the wait for the next tick.
+    // Prints one row per count; the hash tells runs that went differently apart.
+    void runLoadTest(const std::vector<int>& botCounts, const double seconds, const double tickRate,
+                     const int viewDistance, const int seed, const float areaRadius, const bool isMeshingEnabled,
+                     OctaCubic::JobSystem& jobSystem) {
+        const uint64_t numTicks = std::max<uint64_t>(1, (uint64_t)std::llround(seconds * tickRate));
+        const double budgetMs = 1000 / tickRate;
+        const unsigned numThreads = std::max(1u, std::thread::hardware_concurrency());
+        LOG_INFO("Load", "%llu ticks per run at %.0f ticks/s, seed %d, area %.0f blocks, view distance %d, %s, "
+                 "%u hardware threads", (unsigned long long)numTicks, tickRate, seed, areaRadius, viewDistance,
+                 isMeshingEnabled ? "meshing" : "no meshing", numThreads);
+        // Per-chunk debug lines would be timed along with the ticks
+        OctaCubic::Log::setLevel(OctaCubic::Log::info);
+        printf("%6s %9s %9s %9s %9s %7s %6s %9s %8s %9s %8s\n", "bots", "p50 ms", "p90 ms", "p99 ms", "max ms",
+               "late", "CPU", "ticks/s", "chunks", "edits", "hash");
+        std::vector<double> tickMs;
+        for (const int numBots : botCounts) {
+            OctaCubic::ServerWorld world(seed, tickRate, viewDistance, &jobSystem);
+            world.setMeshingEnabled(isMeshingEnabled);
+            OctaCubic::BotDriver bots(world, (uint32_t)seed, areaRadius);
+            bots.addBots((size_t)numBots);
+            const double tickSeconds = world.getClock().getTickSeconds();
+            world.update(0); // Starts the clock
+
+            tickMs.clear();
+            tickMs.reserve(numTicks);
+            uint64_t numLate = 0;
+            const double cpuStart = getProcessCpuSeconds();
+            const double wallStart = OctaCubic::Simulation::getClockSeconds();
+            for (uint64_t t = 1; t <= numTicks; ++t) {
+                bots.submitInputs();
+                // Half a tick in, so rounding never moves a tick to the next update
+                world.update(((double)t + 0.5) * tickSeconds);
+                tickMs.push_back(world.getLastUpdateMs());
+                if (tickMs.back() > budgetMs) ++numLate;
+            }
+            const double wallSeconds = OctaCubic::Simulation::getClockSeconds() - wallStart;
+            const double cpuSeconds = getProcessCpuSeconds() - cpuStart;
+
+            std::sort(tickMs.begin(), tickMs.end());
+            const OctaCubic::BotDriver::Stats& stats = bots.getStats();
+            printf("%6d %9.3f %9.3f %9.3f %9.3f %6.1f%% %5.0f%% %9.0f %8llu %9llu %08x\n", numBots,
+                   getPercentile(tickMs, 0.5), getPercentile(tickMs, 0.9), getPercentile(tickMs, 0.99), tickMs.back(),
+                   100.0 * (double)numLate / (double)numTicks, 100 * cpuSeconds / wallSeconds / numThreads,
+                   (double)numTicks / wallSeconds, (unsigned long long)world.getWorld().getNumChunksGenerated(),
+                   (unsigned long long)(stats.numBreaks + stats.numPlacements), bots.getLocationHash());
+            fflush(stdout);
+        }
+    }
+}
+
+// OctaCubicServer [--worlds N] [--players N] [--seconds S] [--view-distance D] [--tick-rate R] [--seed S]
+//                 [--port P [--address A]]
+// OctaCubicServer --bots N[,N...] [--seconds S] [--view-distance D] [--tick-rate R] [--seed S] [--area A] [--meshing]
+//   --worlds N        worlds hosted by the process, updated in parallel (1)
+//   --players N       players in each world (1)
+//   --seconds S       run time, 0 runs until killed (0)
+//   --view-distance D chunks generated around every player (8)
+//   --tick-rate R     ticks per second (60)
+//   --seed S          seed of the first world, the others count up from it (random)
+//   --port P          serve the first world to games started with --connect; 0 picks a free port
+//   --address A       address to listen on (127.0.0.1)
+//   --bots N[,N...]   load test instead: a run of S seconds (30) per count of bots, each in a new world
+//   --area A          half the width of the square the bots roam, in blocks (512)
+//   --meshing         mesh around every bot too, as clients would
+int main(int argc, char** argv) {
+    int numWorlds = 1, numPlayers = 1, viewDistance = 8;
+    double seconds = 0, tickRate = 60;
+    bool hasSeed = false;
+    int seed = 0;
+    int port = -1;
+    const char* address = "127.0.0.1";
+    std::vector<int> botCounts;
+    float areaRadius = 512;
+    bool isMeshingEnabled = false;
+    for (int i = 1; i < argc; ++i) {
+        const bool hasValue = i + 1 < argc;
+        if (strcmp(argv[i], "--worlds") == 0 && hasValue) numWorlds = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--players") == 0 && hasValue) numPlayers = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--seconds") == 0 && hasValue) seconds = atof(argv[++i]);
+        else if (strcmp(argv[i], "--view-distance") == 0 && hasValue) viewDistance = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--tick-rate") == 0 && hasValue) tickRate = atof(argv[++i]);
+        else if (strcmp(argv[i], "--port") == 0 && hasValue) port = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--address") == 0 && hasValue) address = argv[++i];
+        else if (strcmp(argv[i], "--area") == 0 && hasValue) areaRadius = (float)atof(argv[++i]);
+        else if (strcmp(argv[i], "--meshing") == 0) isMeshingEnabled = true;
+        else if (strcmp(argv[i], "--bots") == 0 && hasValue && parseCounts(argv[i + 1], botCounts)) ++i;
+        else if (strcmp(argv[i], "--seed") == 0 && hasValue) {
+            seed = atoi(argv[++i]);
+            hasSeed = true;
+        }
+        else {
+            fprintf(stderr, "Usage: %s [--worlds N] [--players N] [--seconds S] [--view-distance D] "
+                    "[--tick-rate R] [--seed S] [--port P [--address A]]\n"
+                    "       %s --bots N[,N...] [--seconds S] [--view-distance D] [--tick-rate R] [--seed S] "
+                    "[--area A] [--meshing]\n", argv[0], argv[0]);
+            return 2;
+        }
+    }
+    if (numWorlds < 1 || numPlayers < 0 || viewDistance < 1 || tickRate <= 0 || port > 65535 || areaRadius <= 0) {
+        LOG_ERROR("Server", "Invalid arguments");
+        return 2;
+    }
+    if (!hasSeed) {
+        OctaCubic::World::randomizeSeed();
+        seed = rand();
+    }
+
+    OctaCubic::JobSystem jobSystem;
+    if (!botCounts.empty()) {
+        runLoadTest(botCounts, seconds > 0 ? seconds : 30, tickRate, viewDistance, seed, areaRadius, isMeshingEnabled,
+                    jobSystem);
+        return 0;
+    }
+    std::vector<std::unique_ptr<OctaCubic::ServerWorld>> worlds;
+    for (int w = 0; w < numWorlds; ++w) {
+        worlds.emplace_back(new OctaCubic::ServerWorld(seed + w, tickRate, viewDistance, &jobSystem));
+        for (int p = 0; p < numPlayers; ++p) worlds.back()->addPlayer({0.5f, 256, 0.5f});
+    }
+    // Clients may ask for less than the players here see, never more
+    std::unique_ptr<OctaCubic::ChunkServer> chunkServer;
+    if (port >= 0) {
+        chunkServer.reset(new OctaCubic::ChunkServer(worlds[0]->getWorld(), viewDistance));
+        if (!OctaCubic::Socket::startup() || !chunkServer->listen(address, static_cast<uint16_t>(port))) return 1;
+    }
+    LOG_INFO("Server", "%d worlds, %d players each, seed %d, %.0f ticks/s, view distance %d, %d workers",
+             numWorlds, numPlayers, seed, tickRate, viewDistance, jobSystem.getNumWorkers());
+
+    const double start = OctaCubic::Simulation::getClockSeconds();
+    double nextStats = start + statsInterval;
+    uint64_t ticksAtStats = 0;
+    double maxUpdateMs = 0;
+    for (;;) {
+        const double now = OctaCubic::Simulation::getClockSeconds();
+        if (seconds > 0 && now - start >= seconds) break;
+
+        // Worlds share nothing, one job each
+        jobSystem.parallelFor(worlds.size(), 1, [&](const size_t begin, const size_t end) {
+            for (size_t w = begin; w < end; ++w) {
+                OctaCubic::ServerWorld& world = *worlds[w];
+                for (size_t p = 0; p < (size_t)numPlayers; ++p)
+                    world.submitInput((OctaCubic::ServerWorld::PlayerId)p, walkingInput(p, numPlayers));
+                world.update(now);
+                if (w == 0 && chunkServer) chunkServer->update();
+            }
+        });
+
+        double timeToNextTick = 1 / tickRate;
+        for (const auto& world : worlds) {
+            timeToNextTick = std::min(timeToNextTick, world->getClock().getTimeToNextTick());
+            maxUpdateMs = std::max(maxUpdateMs, world->getLastUpdateMs());
+        }
+
+        if (now >= nextStats) {
+            uint64_t ticks = 0, dropped = 0, chunks = 0;
+            for (const auto& world : worlds) {
+                ticks += world->getClock().getTickCount();
+                dropped += world->getClock().getDroppedTicks();
+                chunks += world->getWorld().getNumChunksGenerated();
+            }
+            LOG_INFO("Server", "%.0f s: %.1f ticks/s per world, %llu dropped, max update %.2f ms, %llu chunks, %.1f MB",
+                     now - start, (double)(ticks - ticksAtStats) / statsInterval / numWorlds,
+                     (unsigned long long)dropped, maxUpdateMs, (unsigned long long)chunks,
+                     (double)OctaCubic::MemoryStats::getTotalBytes(false) / (1024 * 1024));
+            if (chunkServer) {
+                const OctaCubic::ChunkServer::Stats net = chunkServer->getStats();
+                LOG_INFO("Server", "%d clients, %llu chunks sent (%.0f bytes each), %.1f MB out, %.1f KB in, %llu edits",
+                         (int)chunkServer->getNumClients(), (unsigned long long)net.numChunksSent,
+                         net.numChunksSent ? (double)net.numChunkBytes / net.numChunksSent : 0.0,
+                         (double)net.numBytesSent / (1024 * 1024), (double)net.numBytesReceived / 1024,
+                         (unsigned long long)net.numEdits);
+                LOG_INFO("Server", "%llu deltas sent for %llu changed blocks (%.1f bytes per block)",
+                         (unsigned long long)net.numDeltasSent, (unsigned long long)net.numBlocksChanged,
+                         net.numBlocksChanged ? (double)net.numDeltaBytes / net.numBlocksChanged : 0.0);
+            }
+            ticksAtStats = ticks;
+            maxUpdateMs = 0;
+            nextStats += statsInterval;
+        }
+        if (timeToNextTick > 0) std::this_thread::sleep_for(std::chrono::duration<double>(timeToNextTick));
+    }
+    LOG_INFO("Server", "Stopped after %.1f s", OctaCubic::Simulation::getClockSeconds() - start);
+    return 0;
+}